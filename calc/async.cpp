@@ -0,0 +1,346 @@
+#include <algorithm>
+#include "async.h"
+#include "scanner.h"
+#include "parser.h"
+#include "optimizer.h"
+#include "compiler.h"
+#include "peephole.h"
+#include "batch.h"
+
+/**
+ * @brief Requests for the same expression with the same bound variables waiting for evaluation
+ */
+struct group_t {
+  std::vector<async_calculator_t::request_t*> reqs;  ///< requests in order of arrival
+  std::chrono::steady_clock::time_point oldest;     ///< arrival of the first request
+};
+
+/**
+ * @brief Pipeline and cache of one scheduler thread, it shares nothing with other threads but the registry
+ */
+class scheduler_t {
+private:
+  std::shared_ptr<loader_t> const& l;            ///< loader of plugins
+  size_t capacity;                               ///< cached programs
+  std::map<std::string, program_t> programs;     ///< compiled programs by string with expression
+  uint64_t version = UINT64_MAX;                 ///< version of the registry which the programs were compiled with
+  scanner_t s;                                   ///< scanner
+  parser_t p;                                    ///< parser
+  optimizer_t o;                                 ///< optimizer
+  compiler_t k;                                  ///< compiler
+  peephole_t f;                                  ///< fusion of superinstructions
+  std::unique_ptr<var_storage_t> vars;           ///< variables of cached programs
+  batch_calculator_t b;                          ///< evaluator of micro-batches
+  std::vector<std::vector<double>> columns;      ///< values of variables by slot
+  std::vector<double const*> slots;              ///< columns by slot
+  std::vector<size_t> bound;                     ///< slot of every bound variable in order of names, SIZE_MAX if absent
+  std::vector<double> results;                   ///< results of rows
+  std::vector<uint64_t> validity;                ///< bitmap of rows with result
+
+  /**
+   * Find compiled program, compile expression if it is not cached
+   * @warning throws calc_exception_t if string is incorrect or the plugins are incompatible
+   * @param[in] expression - string with expression
+   * @return program
+   */
+  program_t& program(std::string const& expression) {
+    epoch_t::guard_t guard = l->pin();
+    registry_t const& r = l->registry();
+
+    if (r.version != version || programs.size() >= capacity) {
+      // programs keep their variables alive, so the old storage may go with them
+      version = r.version;
+      programs.clear();
+      vars.reset(new var_storage_t());
+      o.setOperations(r.loadedOps);
+    }
+
+    auto pi = programs.find(expression);
+
+    if (pi != programs.end())
+      return pi->second;
+    if (!r.compatible)
+      throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+
+    program_t prog = k.compile(o.optimize(p.parse(s.scan(expression, r.loadedOps, r.cv, *vars))));
+
+    f.fuse(prog);
+    return programs.emplace(expression, std::move(prog)).first->second;
+  }
+
+  /**
+   * Calculate program for requests without throwing
+   * @param[in] prog - program
+   * @param[in] reqs - requests with the same bound variables
+   * @return error which prevents the whole calculation, results of requests are set otherwise
+   */
+  calc_result_t calculate(program_t& prog, std::vector<async_calculator_t::request_t*> const& reqs) noexcept {
+    calc_result_t res;
+    size_t rows = reqs.size();
+
+    bound.clear();
+    slots.assign(prog.vars.size(), nullptr);
+    columns.resize(prog.vars.size());
+    for (auto& binding : reqs.front()->bindings) {
+      auto vi = vars->find(binding.first);
+
+      bound.push_back(SIZE_MAX);
+      if (vi == vars->end())
+        continue;
+      for (size_t slot = 0; slot < prog.vars.size(); ++slot)
+        if (prog.vars[slot] == vi->second) {
+          bound.back() = slot;
+          columns[slot].resize(rows);
+          slots[slot] = columns[slot].data();
+        }
+    }
+
+    // values of rows are never set into variables, so an unbound variable fails the whole batch
+    for (size_t slot = 0; slot < prog.vars.size(); ++slot)
+      if (!slots[slot]) {
+        res.error = calc_error_t::UNINITIALIZED_VARIABLE;
+        res.position = prog.position(slot);
+        return res;
+      }
+
+    for (size_t r = 0; r < rows; ++r) {
+      size_t n = 0;
+
+      // every request has the same names, so their values come in the same order
+      for (auto& binding : reqs[r]->bindings) {
+        if (bound[n] != SIZE_MAX)
+          columns[bound[n]][r] = binding.second;
+        ++n;
+      }
+    }
+
+    res = b.calculate(prog, slots, rows, results, validity);
+    if (!res)
+      return res;
+
+    // rows without result get the errors found by the batch pass, they are never calculated again
+    for (size_t r = 0; r < rows; ++r) {
+      if (validity[r / 64] & (uint64_t(1) << (r % 64)))
+        reqs[r]->result.value = results[r];
+      else {
+        reqs[r]->result.error = calc_error_t::DOMAIN;
+        reqs[r]->result.position = b.errors()[r];
+      }
+    }
+    return res;
+  }
+
+public:
+  /**
+   * Constructor
+   * @param[in] loader - loader of plugins
+   * @param[in] programs - number of cached programs
+   */
+  scheduler_t(std::shared_ptr<loader_t> const& loader, size_t programs)
+    : l(loader), capacity(programs), vars(new var_storage_t()) {}
+
+  /**
+   * Evaluate requests by one batch pass, their completions are called
+   * @param[in] expression - string with expression
+   * @param[in] reqs - requests with the same bound variables
+   */
+  void evaluate(std::string const& expression, std::vector<async_calculator_t::request_t*> const& reqs) {
+    calc_result_t res;
+
+    try {
+      res = calculate(program(expression), reqs);
+    }
+    catch (calc_exception_t& e) {
+      res.error = e.code;
+      res.position = e.position;
+    }
+    catch (std::exception&) {
+      res.error = calc_error_t::INTERNAL;
+    }
+
+    for (auto req : reqs) {
+      if (!res)
+        req->result = res;
+      req->done(req);
+    }
+  }
+};
+
+/**
+ * @brief Calculator of the scheduler thread which runs the code, completions which submit requests run on it
+ */
+static thread_local struct {
+  async_calculator_t const* owner = nullptr;                        ///< calculator of the thread, nullptr for other threads
+  std::vector<async_calculator_t::request_t*>* overflow = nullptr;  ///< requests which did not fit the queue
+} local;
+
+/**
+ * Constructor, starts scheduler threads with default thresholds
+ * @param[in] loader - loader of plugins which programs are compiled with
+ */
+async_calculator_t::async_calculator_t(std::shared_ptr<loader_t> loader)
+  : async_calculator_t(std::move(loader), options_t()) {}
+
+/**
+ * Constructor, starts scheduler threads
+ * @param[in] loader - loader of plugins which programs are compiled with
+ * @param[in] options - thresholds
+ */
+async_calculator_t::async_calculator_t(std::shared_ptr<loader_t> loader, options_t const& options)
+  : l(std::move(loader)), opts(options), queue(options.capacity) {
+  for (size_t i = 0; i < std::max<size_t>(opts.workers, 1); ++i)
+    workers.emplace_back(&async_calculator_t::work, this);
+}
+
+/**
+ * Body of scheduler thread
+ */
+void async_calculator_t::work() {
+  scheduler_t sched(l, opts.programs);
+  std::map<std::string, group_t> groups;
+  std::vector<request_t*> overflow;
+  request_t* req = nullptr;
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  // returns true if some group is due, so that draining the queue doesn't delay it
+  auto add = [this, &groups, &deadline](request_t* r, std::chrono::steady_clock::time_point now) {
+    std::string key = r->expression;
+
+    // requests are batched together only if they bind the same variables
+    for (auto& binding : r->bindings) {
+      key += '\0';
+      key += binding.first;
+    }
+
+    group_t& g = groups[key];
+
+    if (g.reqs.empty()) {
+      g.oldest = r->arrival;
+      deadline = std::min(deadline, g.oldest + opts.budget);
+    }
+    g.reqs.push_back(r);
+    return g.reqs.size() >= opts.maxBatch || now >= deadline;
+  };
+
+  local.owner = this;
+  local.overflow = &overflow;
+  while (true) {
+    auto now = std::chrono::steady_clock::now();
+    bool due = false;
+
+    for (auto r : overflow)
+      due = add(r, now) || due;
+    overflow.clear();
+    for (; !due && (req || queue.pop(req)); req = nullptr)
+      due = add(req, now);
+
+    now = std::chrono::steady_clock::now();
+    deadline = std::chrono::steady_clock::time_point::max();
+    bool finish = stop.load(std::memory_order_acquire);
+
+    for (auto gi = groups.begin(); gi != groups.end();) {
+      group_t& g = gi->second;
+
+      if (finish || g.reqs.size() >= opts.maxBatch || now - g.oldest >= opts.budget) {
+        sched.evaluate(g.reqs.front()->expression, g.reqs);
+        requests.fetch_add(g.reqs.size(), std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        gi = groups.erase(gi);
+      }
+      else {
+        deadline = std::min(deadline, g.oldest + opts.budget);
+        ++gi;
+      }
+    }
+    if (!overflow.empty())
+      continue;
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    // a request pushed after this check finds the thread idle and wakes it up
+    idle.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!queue.pop(req)) {
+      if (groups.empty()) {
+        if (stop.load(std::memory_order_acquire)) {
+          idle.fetch_sub(1);
+          return;
+        }
+        wake.wait(guard);
+      }
+      else
+        wake.wait_until(guard, deadline);
+    }
+    idle.fetch_sub(1);
+  }
+}
+
+/**
+ * Submit request, safe to call from any thread
+ * @param[in] req - request with completion, owned by the caller
+ */
+void async_calculator_t::submit(request_t* req) {
+  req->arrival = std::chrono::steady_clock::now();
+  while (!queue.push(req)) {
+    // the scheduler thread can't wait for itself to empty the queue
+    if (local.owner == this) {
+      local.overflow->push_back(req);
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle.load() != 0) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    wake.notify_one();
+  }
+}
+
+/**
+ * @brief Request which owns its callback, it deletes itself after completion
+ */
+struct callback_request_t : async_calculator_t::request_t {
+  std::function<void(calc_result_t const&)> callback;  ///< function called with result
+
+  /**
+   * Call the callback and delete the request
+   * @param[in] r - completed request
+   */
+  static void finish(async_calculator_t::request_t* r) {
+    std::unique_ptr<callback_request_t> req(static_cast<callback_request_t*>(r));
+
+    req->callback(req->result);
+  }
+};
+
+/**
+ * Submit request with callback, safe to call from any thread
+ * @param[in] expression - string with expression
+ * @param[in] bindings - values of variables by name
+ * @param[in] callback - function called with result on scheduler thread
+ */
+void async_calculator_t::submit(std::string expression, std::map<std::string, double> bindings,
+                                std::function<void(calc_result_t const&)> callback) {
+  std::unique_ptr<callback_request_t> req(new callback_request_t);
+
+  req->expression = std::move(expression);
+  req->bindings = std::move(bindings);
+  req->callback = std::move(callback);
+  req->done = &callback_request_t::finish;
+  submit(req.release());
+}
+
+/**
+ * Destructor, completes the queued requests and stops scheduler threads
+ */
+async_calculator_t::~async_calculator_t() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    stop.store(true, std::memory_order_release);
+    wake.notify_all();
+  }
+  for (auto& worker : workers)
+    worker.join();
+}
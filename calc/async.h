@@ -0,0 +1,193 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
+#include "loader.h"
+#include "queue.h"
+#include "error.h"
+
+/**
+ * @brief Class which evaluates requests from many threads or coroutines, requests for the same expression
+ * with the same bound variables are gathered into micro-batches and evaluated by one batch pass
+ * @warning variables of the expression take the values bound by the request only, a variable which is not bound
+ * is uninitialized. Completions run on the scheduler thread, stateful functions take the requests of every
+ * scheduler thread as consecutive samples.
+ */
+class async_calculator_t {
+public:
+  /**
+   * @brief Thresholds of micro-batching
+   */
+  struct options_t {
+    std::chrono::microseconds budget{200};  ///< longest time a request waits for others to join its batch
+    size_t maxBatch = 256;                  ///< requests in batch, a full batch is evaluated at once
+    size_t capacity = 4096;                 ///< requests queued at once, submission yields while the queue is full
+    size_t workers = 1;                     ///< scheduler threads, each one compiles and caches programs itself
+    size_t programs = 1024;                 ///< compiled programs cached by every scheduler thread
+  };
+
+  /**
+   * @brief Counters of evaluation
+   */
+  struct stats_t {
+    uint64_t requests = 0;  ///< requests completed
+    uint64_t batches = 0;   ///< micro-batches evaluated
+  };
+
+  /**
+   * @brief Request of evaluation, it must stay alive until its completion is called
+   */
+  struct request_t {
+    std::string expression;                         ///< string with expression
+    std::map<std::string, double> bindings;         ///< values of variables by name
+    calc_result_t result;                           ///< result or error, set before completion
+    void (*done)(request_t* req) = nullptr;         ///< completion, the request may be destroyed by it
+    void* context = nullptr;                        ///< data of completion
+    std::chrono::steady_clock::time_point arrival;  ///< moment of submission
+  };
+
+private:
+  std::shared_ptr<loader_t> l;                   ///< loader of plugins which programs are compiled with
+  options_t opts;                                ///< thresholds
+  mpmc_queue_t<request_t*> queue;                ///< submitted requests
+  std::vector<std::thread> workers;              ///< scheduler threads
+
+  std::mutex lock;                               ///< protects sleeping of scheduler threads
+  std::condition_variable wake;                  ///< signals new requests and stop
+  std::atomic<size_t> idle{0};                   ///< scheduler threads which sleep or are going to
+  std::atomic<bool> stop{false};                 ///< scheduler threads have to finish the queued requests and exit
+  std::atomic<uint64_t> requests{0};             ///< requests completed
+  std::atomic<uint64_t> batches{0};              ///< micro-batches evaluated
+
+  /**
+   * Body of scheduler thread
+   */
+  void work();
+
+public:
+  /**
+   * Constructor, starts scheduler threads with default thresholds
+   * @param[in] loader - loader of plugins which programs are compiled with
+   */
+  explicit async_calculator_t(std::shared_ptr<loader_t> loader);
+
+  /**
+   * Constructor, starts scheduler threads
+   * @param[in] loader - loader of plugins which programs are compiled with
+   * @param[in] options - thresholds
+   */
+  async_calculator_t(std::shared_ptr<loader_t> loader, options_t const& options);
+
+  async_calculator_t(async_calculator_t const&) = delete;
+  async_calculator_t& operator=(async_calculator_t const&) = delete;
+
+  /**
+   * Submit request, safe to call from any thread
+   * @param[in] req - request with completion, owned by the caller
+   */
+  void submit(request_t* req);
+
+  /**
+   * Submit request with callback, safe to call from any thread
+   * @param[in] expression - string with expression
+   * @param[in] bindings - values of variables by name
+   * @param[in] callback - function called with result on scheduler thread
+   */
+  void submit(std::string expression, std::map<std::string, double> bindings,
+              std::function<void(calc_result_t const&)> callback);
+
+  /**
+   * Returns counters
+   * @return counters
+   */
+  stats_t stats() const noexcept {
+    stats_t res;
+
+    res.requests = requests.load(std::memory_order_relaxed);
+    res.batches = batches.load(std::memory_order_relaxed);
+    return res;
+  }
+
+#ifdef __cpp_impl_coroutine
+  /**
+   * @brief Awaitable evaluation, the request lives in the frame of the awaiting coroutine
+   */
+  class awaiter_t {
+  private:
+    async_calculator_t* owner;  ///< scheduler
+    request_t req;              ///< request
+
+    /**
+     * Resume the awaiting coroutine
+     * @param[in] r - completed request
+     */
+    static void resume(request_t* r) {
+      std::coroutine_handle<>::from_address(r->context).resume();
+    }
+
+  public:
+    /**
+     * Constructor
+     * @param[in] o - scheduler
+     * @param[in] expression - string with expression
+     * @param[in] bindings - values of variables by name
+     */
+    awaiter_t(async_calculator_t* o, std::string expression, std::map<std::string, double> bindings)
+      : owner(o) {
+      req.expression = std::move(expression);
+      req.bindings = std::move(bindings);
+      req.done = &resume;
+    }
+
+    /**
+     * Check if result is ready without suspension
+     * @return false, the request is always queued
+     */
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    /**
+     * Queue the request, the coroutine resumes on scheduler thread
+     * @param[in] handle - awaiting coroutine
+     */
+    void await_suspend(std::coroutine_handle<> handle) {
+      req.context = handle.address();
+      owner->submit(&req); // the coroutine may already run on scheduler thread when submit returns
+    }
+
+    /**
+     * Returns result
+     * @return result of calculation or error with its position
+     */
+    calc_result_t await_resume() const noexcept {
+      return req.result;
+    }
+  };
+
+  /**
+   * Evaluate expression in coroutine: co_await evaluateAsync(expression, bindings)
+   * @param[in] expression - string with expression
+   * @param[in] bindings - values of variables by name
+   * @return awaitable result of calculation or error with its position
+   */
+  awaiter_t evaluateAsync(std::string expression, std::map<std::string, double> bindings) {
+    return awaiter_t(this, std::move(expression), std::move(bindings));
+  }
+#endif
+
+  /**
+   * Destructor, completes the queued requests and stops scheduler threads
+   */
+  ~async_calculator_t();
+};
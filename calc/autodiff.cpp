@@ -0,0 +1,220 @@
+#include <cmath>
+#include <algorithm>
+#include "autodiff.h"
+
+/**
+ * Perform operation of CALL or UPDATE instruction
+ * @param[in] prog - compiled program with states of stateful operations
+ * @param[in] in - instruction
+ * @param[in] args - operands
+ * @return result of operation
+ */
+static double evaluate(program_t const& prog, instr_t const& in, double const* args) {
+  if (in.code != instr_t::opcode_t::UPDATE)
+    return in.operation->evaluate(args);
+
+  state_t& st = *prog.states[in.slot];
+
+  return st.result = static_cast<stateful_t*>(in.operation)->update(st, args);
+}
+
+/**
+ * Calculate value and gradient of compiled program
+ * @warning throws calc_exception_t if the program has uninitialized variables, domain error
+ * or an operation without derivative rule depends on differentiated variables
+ * @param[in] prog - compiled program
+ * @param[in] wrt - variables to differentiate by, variables absent in program get zero derivative
+ * @param[out] gradient - derivatives by variables in the order of wrt
+ * @return result of calculation
+ */
+double autodiff_t::calculate(program_t& prog, std::vector<variable_t const*> const& wrt, std::vector<double>& gradient) {
+  size_t maxArity = 0;
+
+  prog.bind();
+  for (instr_t const& in : prog.code)
+    maxArity = std::max(maxArity, in.arity);
+
+  width = wrt.size();
+  values.resize(prog.maxDepth);
+  tangents.resize(prog.maxDepth * width);
+  active.resize(prog.maxDepth);
+  partials.resize(maxArity);
+
+  size_t depth = 0;
+  for (size_t j = 0; j < prog.code.size(); ++j) {
+    instr_t const& in = prog.code[j];
+    double* t = tangents.data() + depth * width;
+
+    switch (in.code) {
+      case instr_t::opcode_t::PUSH_NUMBER:
+        values[depth] = in.value;
+        active[depth++] = false;
+        break;
+      case instr_t::opcode_t::PUSH_VARIABLE:
+      {
+        variable_t const* var = prog.vars[in.slot].get();
+
+        values[depth] = var->getValue();
+        active[depth] = false;
+        for (size_t k = 0; k < width; ++k) {
+          t[k] = wrt[k] == var ? 1 : 0;
+          active[depth] = active[depth] || wrt[k] == var;
+        }
+        ++depth;
+        break;
+      }
+      // the conditional is piecewise, its derivative is the derivative of the taken branch
+      case instr_t::opcode_t::JUMP_IF_FALSE:
+        if (std::isnan(values[depth - 1]))
+          j += in.slot2 - 1;
+        else if (values[--depth] == 0)
+          j += in.slot - 1;
+        break;
+      case instr_t::opcode_t::JUMP:
+        j += in.slot - 1;
+        break;
+      default:
+      {
+        bool any = false;
+
+        depth -= in.arity;
+        t = tangents.data() + depth * width;
+        if (in.checked && !in.operation->inDomain(values.data() + depth))
+          throw calc_exception_t(calc_error_t::DOMAIN, in.pos, "Domain error");
+        for (size_t i = 0; i < in.arity; ++i)
+          any = any || active[depth + i];
+
+        // constant subexpressions need neither the rule nor tangent arithmetic
+        if (any) {
+          if (!in.operation->derivative(values.data() + depth, partials.data()))
+            throw calc_exception_t(calc_error_t::NO_DERIVATIVE, in.pos, "No derivative rule");
+
+          // the result overwrites the tangent of the first operand, so it is scaled in place first
+          for (size_t k = 0; k < width; ++k)
+            t[k] = active[depth] ? partials[0] * t[k] : 0;
+          for (size_t i = 1; i < in.arity; ++i) {
+            double const* ti = t + i * width;
+
+            if (active[depth + i])
+              for (size_t k = 0; k < width; ++k)
+                t[k] += partials[i] * ti[k];
+          }
+        }
+
+        values[depth] = evaluate(prog, in, values.data() + depth);
+        active[depth++] = any;
+        break;
+      }
+    }
+  }
+
+  double res = values[0];
+
+  gradient.assign(width, 0);
+  if (active[0])
+    std::copy(tangents.begin(), tangents.begin() + width, gradient.begin());
+  return res;
+}
+
+/**
+ * Calculate value and gradient of compiled program by all its variables
+ * @warning throws calc_exception_t if the program has uninitialized variables, domain error
+ * or an operation without derivative rule depends on variables
+ * @param[in] prog - compiled program
+ * @param[out] gradient - derivatives by variables of program by slot
+ * @return result of calculation
+ */
+double reverse_autodiff_t::calculate(program_t& prog, std::vector<double>& gradient) {
+  size_t n = prog.code.size();
+
+  prog.bind();
+  values.resize(n);
+  adjoints.assign(n, 0);
+  active.assign(n, false);
+  offsets.resize(n + 1);
+  operands.clear();
+  partials.clear();
+  stack.clear();
+
+  // forward sweep records operands and local derivatives of every operation
+  for (size_t i = 0; i < n; ++i) {
+    instr_t const& in = prog.code[i];
+
+    offsets[i] = operands.size();
+    switch (in.code) {
+      case instr_t::opcode_t::PUSH_NUMBER:
+        values[i] = in.value;
+        active[i] = false;
+        break;
+      case instr_t::opcode_t::PUSH_VARIABLE:
+        values[i] = prog.vars[in.slot]->getValue();
+        active[i] = true;
+        break;
+      case instr_t::opcode_t::JUMP_IF_FALSE:
+      case instr_t::opcode_t::JUMP:
+      {
+        // jumps and skipped instructions record nothing, the condition gets no adjoint
+        size_t to = i + 1;
+
+        if (in.code == instr_t::opcode_t::JUMP)
+          to = i + in.slot;
+        else if (std::isnan(values[stack.back()]))
+          to = i + in.slot2;
+        else if (values[stack.back()] == 0)
+          to = i + in.slot;
+        if (in.code == instr_t::opcode_t::JUMP_IF_FALSE && to != i + in.slot2)
+          stack.pop_back();
+        std::fill(offsets.begin() + i + 1, offsets.begin() + to, operands.size());
+        i = to - 1;
+        continue;
+      }
+      default:
+      {
+        size_t first = stack.size() - in.arity;
+        bool any = false;
+
+        args.resize(in.arity);
+        for (size_t k = 0; k < in.arity; ++k) {
+          args[k] = values[stack[first + k]];
+          any = any || active[stack[first + k]];
+        }
+        if (in.checked && !in.operation->inDomain(args.data()))
+          throw calc_exception_t(calc_error_t::DOMAIN, in.pos, "Domain error");
+
+        if (any) {
+          size_t off = partials.size();
+
+          partials.resize(off + in.arity);
+          if (!in.operation->derivative(args.data(), partials.data() + off))
+            throw calc_exception_t(calc_error_t::NO_DERIVATIVE, in.pos, "No derivative rule");
+          operands.insert(operands.end(), stack.begin() + first, stack.end());
+        }
+
+        values[i] = evaluate(prog, in, args.data());
+        active[i] = any;
+        stack.resize(first);
+        break;
+      }
+    }
+    stack.push_back(i);
+  }
+  offsets[n] = operands.size();
+
+  double res = values[stack.back()];
+
+  // backward sweep accumulates adjoints from the result down to variables
+  gradient.assign(prog.vars.size(), 0);
+  adjoints[stack.back()] = 1;
+  for (size_t i = n; i-- > 0;) {
+    instr_t const& in = prog.code[i];
+
+    if (!active[i] || adjoints[i] == 0)
+      continue;
+    if (in.code == instr_t::opcode_t::PUSH_VARIABLE)
+      gradient[in.slot] += adjoints[i];
+    for (size_t k = offsets[i]; k < offsets[i + 1]; ++k)
+      adjoints[operands[k]] += adjoints[i] * partials[k];
+  }
+
+  return res;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "program.h"
+
+/**
+ * @brief Class which calculates value and gradient of compiled program in one pass (forward-mode differentiation)
+ */
+class autodiff_t {
+private:
+  std::vector<double> values;    ///< preallocated operand stack
+  std::vector<double> tangents;  ///< tangent vector of every stack entry, width values each
+  std::vector<char> active;      ///< true if the stack entry depends on differentiated variables
+  std::vector<double> partials;  ///< derivatives of current operation by operands
+  size_t width = 0;              ///< number of differentiated variables
+
+public:
+  /**
+   * Default constructor
+   */
+  autodiff_t() = default;
+
+  /**
+   * Calculate value and gradient of compiled program
+   * @warning throws calc_exception_t if the program has uninitialized variables, domain error
+   * or an operation without derivative rule depends on differentiated variables
+   * @param[in] prog - compiled program
+   * @param[in] wrt - variables to differentiate by, variables absent in program get zero derivative
+   * @param[out] gradient - derivatives by variables in the order of wrt
+   * @return result of calculation
+   */
+  double calculate(program_t& prog, std::vector<variable_t const*> const& wrt, std::vector<double>& gradient);
+
+  /**
+   * Destructor
+   */
+  ~autodiff_t() = default;
+};
+
+/**
+ * @brief Class which calculates gradient by all variables of compiled program with a backward sweep over a tape
+ * @warning buffers of the tape are kept between calls, so repeated calculations do not allocate memory
+ */
+class reverse_autodiff_t {
+private:
+  std::vector<double> values;     ///< value of every instruction
+  std::vector<double> adjoints;   ///< derivative of the result by value of every instruction
+  std::vector<char> active;       ///< true if the value of instruction depends on variables
+  std::vector<size_t> stack;      ///< instructions whose values are on the operand stack
+  std::vector<size_t> offsets;    ///< start of the operands of every instruction on the tape
+  std::vector<size_t> operands;   ///< tape of operand instructions
+  std::vector<double> partials;   ///< tape of derivatives by operands
+  std::vector<double> args;       ///< operands of current operation
+
+public:
+  /**
+   * Default constructor
+   */
+  reverse_autodiff_t() = default;
+
+  /**
+   * Calculate value and gradient of compiled program by all its variables
+   * @warning throws calc_exception_t if the program has uninitialized variables, domain error
+   * or an operation without derivative rule depends on variables
+   * @param[in] prog - compiled program
+   * @param[out] gradient - derivatives by variables of program by slot
+   * @return result of calculation
+   */
+  double calculate(program_t& prog, std::vector<double>& gradient);
+
+  /**
+   * Destructor
+   */
+  ~reverse_autodiff_t() = default;
+};
@@ -0,0 +1,380 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "batch.h"
+#include "trace.h"
+
+/**
+ * Calculate one row of pure program after the block has failed
+ * @param[in] prog - compiled program
+ * @param[in] columns - values of variables by slot
+ * @param[in] r - row index
+ * @return result of calculation or domain error
+ */
+calc_result_t batch_calculator_t::calculateRow(program_t const& prog, std::vector<double const*> const& columns,
+                                               size_t r) noexcept {
+  calc_result_t res;
+  double* sp = row.data();
+  size_t i = 0;
+
+  try {
+    for (i = 0; i < prog.code.size(); ++i) {
+      instr_t const& in = prog.code[i];
+
+      switch (in.code) {
+        case instr_t::opcode_t::PUSH_NUMBER:
+          *sp++ = in.value;
+          break;
+        case instr_t::opcode_t::PUSH_VARIABLE:
+          *sp++ = columns[in.slot] ? columns[in.slot][r] : prog.vars[in.slot]->getValue();
+          break;
+        case instr_t::opcode_t::JUMP_IF_FALSE:
+          if (sp[-1] != sp[-1])
+            i += in.slot2 - 1;
+          else if (*--sp == 0)
+            i += in.slot - 1;
+          break;
+        case instr_t::opcode_t::JUMP:
+          i += in.slot - 1;
+          break;
+        case instr_t::opcode_t::UPDATE:
+        {
+          state_t& st = *prog.states[in.slot];
+
+          sp -= in.arity;
+          if (in.checked && !in.operation->inDomain(sp)) {
+            res.error = calc_error_t::DOMAIN;
+            res.position = in.pos;
+            return res;
+          }
+          *sp = st.result = static_cast<stateful_t*>(in.operation)->update(st, sp);
+          ++sp;
+          break;
+        }
+        default:
+          sp -= in.arity;
+          if (in.checked && !in.operation->inDomain(sp)) {
+            res.error = calc_error_t::DOMAIN;
+            res.position = in.pos;
+            return res;
+          }
+          *sp = in.operation->evaluate(sp);
+          ++sp;
+          break;
+      }
+    }
+  }
+  catch (std::exception&) {
+    res.error = calc_error_t::DOMAIN;
+    res.position = prog.code[i].pos;
+    return res;
+  }
+
+  res.value = row[0];
+  return res;
+}
+
+/**
+ * Returns bits of value, so that tuples are compared and hashed exactly
+ * @param[in] value - value
+ * @return bits
+ */
+static uint64_t bits(double value) noexcept {
+  uint64_t res;
+
+  std::memcpy(&res, &value, sizeof(res));
+  return res;
+}
+
+/**
+ * Check if every row of program may be replaced with the result of another row with the same values of variables
+ * @param[in] prog - compiled program
+ * @return true if the program has no stateful operations and no operations which may be impure
+ */
+static bool deduplicable(program_t const& prog) noexcept {
+  return prog.isPure();
+}
+
+/**
+ * Find distinct tuples of variable values
+ * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+ * @param[in] rows - number of rows
+ * @return number of distinct tuples, 0 if the probed rows have too few duplicates
+ */
+size_t batch_calculator_t::gather(std::vector<double const*> const& columns, size_t rows) {
+  size_t size = 16;
+  uint32_t count = 0;
+
+  keys.clear();
+  for (size_t slot = 0; slot < columns.size(); ++slot)
+    if (columns[slot])
+      keys.push_back(slot);
+  while (size < 2 * rows)
+    size <<= 1;
+  table.assign(size, UINT32_MAX);
+  tuples.resize(rows);
+  distinct.resize(columns.size());
+  for (size_t slot : keys)
+    distinct[slot].clear();
+
+  for (size_t r = 0; r < rows; ++r) {
+    if (r == opts.probe && static_cast<double>(r - count) < opts.minDuplicates * static_cast<double>(r))
+      return 0;
+
+    uint64_t h = 0;
+
+    for (size_t slot : keys) {
+      h = (h ^ bits(columns[slot][r])) * 0x9E3779B97F4A7C15ull;
+      h ^= h >> 29;
+    }
+
+    // linear probing, the table is at most half full
+    for (size_t i = h & (size - 1);; i = (i + 1) & (size - 1)) {
+      uint32_t t = table[i];
+
+      if (t == UINT32_MAX) {
+        table[i] = tuples[r] = count++;
+        for (size_t slot : keys)
+          distinct[slot].push_back(columns[slot][r]);
+        break;
+      }
+
+      bool same = true;
+
+      for (size_t k = 0; k < keys.size() && same; ++k)
+        same = bits(distinct[keys[k]][t]) == bits(columns[keys[k]][r]);
+      if (same) {
+        tuples[r] = t;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * Calculate program for every row without throwing, stateful operations take rows as consecutive samples
+ * @warning if an operation throws from process, every row of its block fails at that operation unless
+ * the program is pure and the block is calculated anew row by row. Rows are deduplicated only if the program has no stateful operations and no operations which may be impure.
+ * @param[in] prog - compiled program
+ * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+ * @param[in] rows - number of rows
+ * @param[out] results - results of rows, NaN for rows with domain error
+ * @param[out] validity - bitmap, bit (i % 64) of element i / 64 is set if row i has a result
+ * @return number of valid rows in value or error which prevents the whole calculation
+ */
+calc_result_t batch_calculator_t::calculate(program_t& prog, std::vector<double const*> const& columns,
+                                            size_t rows, std::vector<double>& results,
+                                            std::vector<uint64_t>& validity) noexcept {
+  trace_span_t span("evaluate batch", "evaluation");
+  calc_result_t res;
+  size_t valid = 0;
+
+  if (columns.size() != prog.vars.size()) {
+    res.error = calc_error_t::BAD_INPUT;
+    return res;
+  }
+  for (size_t slot = 0; slot < columns.size(); ++slot) {
+    if (!columns[slot] && !prog.vars[slot]->isInit()) {
+      res.error = calc_error_t::UNINITIALIZED_VARIABLE;
+      res.position = prog.position(slot);
+      return res;
+    }
+  }
+
+  bool dedup = opts.dedup && rows > 1 && rows < UINT32_MAX && deduplicable(prog);
+  size_t count = 0;
+
+  if (dedup && skip > 0) {
+    --skip;
+    dedup = false;
+  }
+  if (dedup) {
+    count = gather(columns, rows);
+    // the switch stays off for a while after a batch has had too few duplicates to pay for hashing,
+    // the tuples of a batch which was hashed to the end are used anyway
+    if (count == 0 || static_cast<double>(rows - count) < opts.minDuplicates * static_cast<double>(rows)) {
+      skip = penalty;
+      penalty = std::min(penalty * 2, std::max<size_t>(opts.backoff, 1));
+      dedup = count != 0;
+    }
+    else
+      penalty = 1;
+  }
+
+  ++st.batches;
+  st.rows += rows;
+  if (dedup) {
+    slots.assign(columns.size(), nullptr);
+    for (size_t slot : keys)
+      slots[slot] = distinct[slot].data();
+    evaluate(prog, slots, count, partial, partialFaults);
+    results.resize(rows);
+    faults.resize(rows);
+    for (size_t r = 0; r < rows; ++r) {
+      results[r] = partial[tuples[r]];
+      faults[r] = partialFaults[tuples[r]];
+    }
+    ++st.deduplicated;
+    st.evaluated += count;
+  }
+  else {
+    evaluate(prog, columns, rows, results, faults);
+    st.evaluated += rows;
+  }
+
+  validity.assign((rows + 63) / 64, 0);
+  // rows without result are marked in the bitmap instead of aborting the batch, NaN is a result as any other
+  for (size_t r = 0; r < rows; ++r) {
+    if (faults[r] == program_t::noFault) {
+      validity[r / 64] |= uint64_t(1) << (r % 64);
+      ++valid;
+    }
+  }
+
+  res.value = static_cast<double>(valid);
+  return res;
+}
+
+/**
+ * Perform stateful operation on a block of operands, rows of branches which are not taken
+ * and rows with domain error are skipped
+ * @param[in] in - UPDATE instruction
+ * @param[in] st - state of the call site
+ * @param[in] i - index of instruction
+ * @param[in] top - first operand array, others follow with blockSize stride
+ * @param[out] top - results of the rows which take the branches
+ * @param[in] n - number of rows
+ * @param[in] fault - positions of domain errors of rows, nullptr if the block has none
+ */
+void batch_calculator_t::update(instr_t const& in, state_t& st, size_t i, double* top, size_t n, size_t const* fault) {
+  stateful_t* op = static_cast<stateful_t*>(in.operation);
+
+  if (ends.empty() && !fault) {
+    op->updateBlock(st, args.data(), top, n);
+    return;
+  }
+
+  program_t::taken(conds.data(), elses, i, blockSize, n, active, fault);
+  packed.resize((in.arity + 1) * blockSize);
+  packedArgs.resize(in.arity);
+  for (size_t k = 0; k < in.arity; ++k) {
+    packedArgs[k] = packed.data() + k * blockSize;
+    for (size_t j = 0; j < active.size(); ++j)
+      packed[k * blockSize + j] = top[k * blockSize + active[j]];
+  }
+
+  // the other rows keep their first operand, the conditionals drop it
+  double* res = packed.data() + in.arity * blockSize;
+
+  op->updateBlock(st, packedArgs.data(), res, active.size());
+  for (size_t j = 0; j < active.size(); ++j)
+    top[active[j]] = res[j];
+}
+
+/**
+ * Calculate program for every row by blocks
+ * @param[in] prog - compiled program
+ * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+ * @param[in] rows - number of rows
+ * @param[out] results - results of rows, NaN if it failed
+ * @param[out] fault - positions of domain errors by row, program_t::noFault for rows with result
+ */
+void batch_calculator_t::evaluate(program_t& prog, std::vector<double const*> const& columns, size_t rows,
+                                  std::vector<double>& results, std::vector<size_t>& fault) noexcept {
+  size_t maxArity = 0;
+  size_t branches = 0;
+  for (instr_t const& in : prog.code) {
+    maxArity = std::max(maxArity, in.arity);
+    branches += in.code == instr_t::opcode_t::JUMP_IF_FALSE ? 1 : 0;
+  }
+
+  stack.resize(prog.maxDepth * blockSize);
+  conds.resize(branches * blockSize);
+  args.resize(maxArity);
+  row.resize(prog.maxDepth);
+  results.resize(rows);
+  fault.assign(rows, program_t::noFault);
+
+  for (size_t first = 0; first < rows; first += blockSize) {
+    size_t n = std::min(blockSize, rows - first);
+    size_t* rowFault = fault.data() + first;
+    bool faulty = false;
+    size_t i = 0;
+
+    // a pure program calculates the block anew row by row if any operation throws from process
+    try {
+      size_t depth = 0;
+
+      ends.clear();
+      elses.clear();
+      for (i = 0; i <= prog.code.size(); ++i) {
+        // both branches have been evaluated, the rows choose between them
+        for (; !ends.empty() && ends.back() == i; ends.pop_back(), elses.pop_back(), --depth)
+          program_t::select(conds.data() + (ends.size() - 1) * blockSize, stack.data() + (depth - 2) * blockSize,
+                            stack.data() + (depth - 1) * blockSize, n);
+        if (i == prog.code.size())
+          break;
+
+        instr_t const& in = prog.code[i];
+        double* top = stack.data() + depth * blockSize;
+
+        switch (in.code) {
+          case instr_t::opcode_t::PUSH_NUMBER:
+            std::fill(top, top + n, in.value);
+            ++depth;
+            break;
+          case instr_t::opcode_t::PUSH_VARIABLE:
+            if (columns[in.slot])
+              std::copy(columns[in.slot] + first, columns[in.slot] + first + n, top);
+            else
+              std::fill(top, top + n, prog.vars[in.slot]->getValue());
+            ++depth;
+            break;
+          case instr_t::opcode_t::JUMP_IF_FALSE:
+            --depth;
+            std::copy(top - blockSize, top - blockSize + n, conds.data() + ends.size() * blockSize);
+            ends.push_back(i + in.slot2);
+            elses.push_back(i + in.slot);
+            break;
+          case instr_t::opcode_t::JUMP:
+            break;
+          default:
+            depth -= in.arity;
+            top = stack.data() + depth * blockSize;
+            for (size_t k = 0; k < in.arity; ++k)
+              args[k] = top + k * blockSize;
+            // only the taken rows are checked, as a single row evaluation stops at its first error
+            if (in.checked) {
+              program_t::taken(conds.data(), elses, i, blockSize, n, active, rowFault);
+              faulty = program_t::check(in, top, blockSize, active, operands, rowFault) || faulty;
+            }
+            if (in.code == instr_t::opcode_t::UPDATE)
+              update(in, *prog.states[in.slot], i, top, n, faulty ? rowFault : nullptr);
+            else
+              in.operation->evaluateBlock(args.data(), top, n);
+            ++depth;
+            break;
+        }
+      }
+      std::copy(stack.data(), stack.data() + n, results.data() + first);
+      for (size_t r = 0; faulty && r < n; ++r)
+        if (rowFault[r] != program_t::noFault)
+          results[first + r] = operation_t::domainError();
+    }
+    catch (std::exception&) {
+      // stateful and impure operations have already taken the rows, none of them is calculated again
+      if (!prog.isPure()) {
+        std::fill(results.data() + first, results.data() + first + n, operation_t::domainError());
+        std::fill(rowFault, rowFault + n, prog.code[i].pos);
+        continue;
+      }
+      for (size_t r = first; r < first + n; ++r) {
+        calc_result_t res = calculateRow(prog, columns, r);
+
+        results[r] = res ? res.value : operation_t::domainError();
+        fault[r] = res ? program_t::noFault : res.position;
+      }
+    }
+  }
+}
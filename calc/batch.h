@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include "program.h"
+
+/**
+ * @brief Class which evaluates compiled program for many rows of variable values
+ * @warning rows are processed by blocks, every instruction is applied to the whole block at once,
+ * so both branches of conditionals are evaluated and blended. Stateful operations take only the rows
+ * of taken branches as their samples.
+ */
+class batch_calculator_t {
+public:
+  /**
+   * @brief Options of row deduplication
+   */
+  struct options_t {
+    bool dedup = false;           ///< evaluate every distinct tuple of variable values once and scatter the results
+    size_t probe = 512;           ///< rows hashed before the share of duplicates is checked
+    double minDuplicates = 0.25;  ///< share of duplicates among probed rows below which hashing does not pay
+    size_t backoff = 64;          ///< most batches evaluated without hashing after a failed probe
+  };
+
+  /**
+   * @brief Statistics of deduplication
+   */
+  struct stats_t {
+    uint64_t batches = 0;       ///< calculated batches
+    uint64_t deduplicated = 0;  ///< batches evaluated by distinct tuples
+    uint64_t rows = 0;          ///< rows of calculated batches
+    uint64_t evaluated = 0;     ///< rows evaluated, distinct tuples of deduplicated batches
+
+    /**
+     * Returns the dedup ratio
+     * @return rows per evaluated row, 1 if nothing was deduplicated
+     */
+    double ratio() const noexcept {
+      return evaluated ? static_cast<double>(rows) / static_cast<double>(evaluated) : 1.0;
+    }
+  };
+
+private:
+  static constexpr size_t blockSize = 256;  ///< number of rows processed at once
+
+  std::vector<double> stack;            ///< preallocated operand stack of blocks
+  std::vector<double const*> args;      ///< operands of current operation
+  std::vector<double> row;              ///< operand stack for the rows of a failed block
+  std::vector<double> conds;            ///< conditions of the conditionals being evaluated, block per nesting level
+  std::vector<size_t> ends;             ///< end indices of the conditionals being evaluated
+  std::vector<size_t> elses;            ///< indices of the second branches of the conditionals being evaluated
+  std::vector<size_t> active;           ///< rows which take the branches of the operation being checked or updated
+  std::vector<double> packed;           ///< operands and results of the active rows
+  std::vector<double const*> packedArgs;  ///< operand arrays of packed
+  std::vector<double> operands;         ///< operands of a row being checked against the domain
+  std::vector<size_t> faults;           ///< positions of domain errors by row of the last batch
+
+  options_t opts;                       ///< options of deduplication
+  stats_t st;                           ///< statistics of deduplication
+  size_t skip = 0;                      ///< batches left to evaluate without hashing
+  size_t penalty = 1;                   ///< batches skipped after the next failed probe
+  std::vector<size_t> keys;             ///< slots whose columns make the tuple of row
+  std::vector<uint32_t> table;          ///< open addressing hash table of distinct tuples, UINT32_MAX if empty
+  std::vector<uint32_t> tuples;         ///< distinct tuple of every row
+  std::vector<std::vector<double>> distinct;  ///< values of distinct tuples by slot
+  std::vector<double const*> slots;     ///< columns of distinct tuples by slot
+  std::vector<double> partial;          ///< results of distinct tuples
+  std::vector<size_t> partialFaults;    ///< positions of domain errors of distinct tuples
+
+  /**
+   * Calculate one row of pure program after the block has failed
+   * @param[in] prog - compiled program
+   * @param[in] columns - values of variables by slot
+   * @param[in] r - row index
+   * @return result of calculation or domain error
+   */
+  calc_result_t calculateRow(program_t const& prog, std::vector<double const*> const& columns, size_t r) noexcept;
+
+  /**
+   * Perform stateful operation on a block of operands, rows of branches which are not taken
+   * and rows with domain error are skipped
+   * @param[in] in - UPDATE instruction
+   * @param[in] st - state of the call site
+   * @param[in] i - index of instruction
+   * @param[in] top - first operand array, others follow with blockSize stride
+   * @param[out] top - results of the rows which take the branches
+   * @param[in] n - number of rows
+   * @param[in] fault - positions of domain errors of rows, nullptr if the block has none
+   */
+  void update(instr_t const& in, state_t& st, size_t i, double* top, size_t n, size_t const* fault);
+
+  /**
+   * Calculate program for every row by blocks
+   * @param[in] prog - compiled program
+   * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - results of rows, NaN if it failed
+   * @param[out] fault - positions of domain errors by row, program_t::noFault for rows with result
+   */
+  void evaluate(program_t& prog, std::vector<double const*> const& columns, size_t rows,
+                std::vector<double>& results, std::vector<size_t>& fault) noexcept;
+
+  /**
+   * Find distinct tuples of variable values
+   * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @return number of distinct tuples, 0 if the probed rows have too few duplicates
+   */
+  size_t gather(std::vector<double const*> const& columns, size_t rows);
+
+public:
+  /**
+   * Default constructor
+   */
+  batch_calculator_t() = default;
+
+  /**
+   * Set options of deduplication
+   * @param[in] options - options
+   */
+  void setOptions(options_t const& options) noexcept {
+    opts = options;
+    skip = 0;
+    penalty = 1;
+  }
+
+  /**
+   * Returns statistics of deduplication
+   * @return statistics since the calculator was made
+   */
+  stats_t const& stats() const noexcept {
+    return st;
+  }
+
+  /**
+   * Returns domain errors of the last calculation, so that rows without result need not be calculated again
+   * @return position in expression by row, program_t::noFault for rows with result
+   */
+  std::vector<size_t> const& errors() const noexcept {
+    return faults;
+  }
+
+  /**
+   * Calculate program for every row without throwing, stateful operations take rows as consecutive samples
+   * @warning if an operation throws from process, every row of its block fails at that operation unless
+   * the program is pure and the block is calculated anew row by row. Rows are deduplicated only if the program has no stateful operations and no operations which may be impure.
+   * @param[in] prog - compiled program
+   * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - results of rows, NaN for rows with domain error
+   * @param[out] validity - bitmap, bit (i % 64) of element i / 64 is set if row i has a result
+   * @return number of valid rows in value or error which prevents the whole calculation
+   */
+  calc_result_t calculate(program_t& prog, std::vector<double const*> const& columns, size_t rows,
+                          std::vector<double>& results, std::vector<uint64_t>& validity) noexcept;
+
+  /**
+   * Destructor
+   */
+  ~batch_calculator_t() = default;
+};
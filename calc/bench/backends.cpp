@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "../vm.h"
+
+/**
+ * Expressions of growing size which the register machine can run
+ */
+static char const* const vmExpressions[] = {
+  "x * y + z",
+  "(x + y) * (x - y) / (z + 1)",
+  "x * x * x + 2 * x * y - y / (z + 1)",
+  "sin(x) * cos(y) + hypot(x, y, z)",
+  "(x + 1) * (y + 2) * (z + 3) - x * y * z + (x - y) * (y - z) * (z - x)"
+};
+
+/**
+ * Register machine against the stack evaluator on the same compiled program
+ */
+BENCH_CASE(registerMachine) {
+  str_calc_t calc;
+  size_t runs = scaled(1000000);
+
+  calc.setVariable("x", 1.25);
+  calc.setVariable("y", -0.5);
+  calc.setVariable("z", 3.0);
+
+  for (char const* expr : vmExpressions) {
+    std::printf(" %s, ns per evaluation\n", expr);
+
+    program_t prog = calc.compile(expr);
+    vm_program_t vp = vm_compiler_t().compile(prog);
+    vm_calculator_t vm;
+    double ref = calc.calculate(prog);
+
+    prog.bind();
+
+    double stack = measure([&] {
+      for (size_t i = 0; i < runs; ++i)
+        consume(calc.calculate(prog));
+    });
+
+    report("stack program", stack, static_cast<double>(runs));
+
+    double reg = measure([&] {
+      for (size_t i = 0; i < runs; ++i)
+        consume(vm.run(vp).value);
+    });
+
+    report("register machine", reg, static_cast<double>(runs), stack);
+    compare("register machine", { vm.run(vp).value }, { ref }, 0);
+  }
+}
+
+/**
+ * Every backend from the string, which includes the lookup of compiled program
+ */
+BENCH_CASE(stringBackends) {
+  static std::pair<char const*, str_calc_t::backend_t> const backends[] = {
+    { "tokens", str_calc_t::backend_t::BACKEND_TOKENS },
+    { "stack", str_calc_t::backend_t::BACKEND_STACK },
+    { "register", str_calc_t::backend_t::BACKEND_REGISTER },
+    { "tiered", str_calc_t::backend_t::BACKEND_TIERED }
+  };
+  size_t runs = scaled(100000);
+
+  for (char const* expr : vmExpressions) {
+    std::printf(" %s, ns per calculate\n", expr);
+
+    double base = 0;
+    double ref = 0;
+
+    for (auto& be : backends) {
+      str_calc_t calc;
+
+      calc.setVariable("x", 1.25);
+      calc.setVariable("y", -0.5);
+      calc.setVariable("z", 3.0);
+      calc.setBackend(be.second);
+
+      double took = measure([&] {
+        for (size_t i = 0; i < runs; ++i)
+          consume(calc.calculate(expr));
+      });
+
+      report(be.first, took, static_cast<double>(runs), base);
+      if (base == 0) {
+        base = took;
+        ref = calc.calculate(expr);
+      }
+      else
+        compare(be.first, { calc.calculate(expr) }, { ref }, 1e-15);
+    }
+  }
+}
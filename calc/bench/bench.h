@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include "../getResult.h"
+
+/**
+ * @brief Registry of benchmarks, every benchmark registers itself before main
+ */
+class bench_registry_t {
+public:
+  /**
+   * @brief Benchmark
+   */
+  struct case_t {
+    char const* name;  ///< name of benchmark
+    void (*body)();    ///< measurements of benchmark
+  };
+
+  std::vector<case_t> cases;  ///< registered benchmarks
+  bool quick = false;         ///< short runs which only check that the benchmarks work
+  size_t failures = 0;        ///< results which differ from the baseline
+
+  /**
+   * Returns the only registry
+   * @return registry
+   */
+  static bench_registry_t& instance() {
+    static bench_registry_t reg;
+
+    return reg;
+  }
+
+  /**
+   * Report result which differs from the baseline
+   * @param[in] what - description of difference
+   */
+  void fail(std::string const& what) {
+    ++failures;
+    std::printf("  MISMATCH %s\n", what.c_str());
+  }
+};
+
+/**
+ * @brief Registration of benchmark
+ */
+struct bench_case_t {
+  /**
+   * Constructor
+   * @param[in] name - name of benchmark
+   * @param[in] body - measurements of benchmark
+   */
+  bench_case_t(char const* name, void (*body)()) {
+    bench_registry_t::instance().cases.push_back({ name, body });
+  }
+};
+
+/**
+ * Define benchmark
+ * @param[in] name - name of benchmark
+ */
+#define BENCH_CASE(name) \
+  static void name(); \
+  static bench_case_t name##Bench(#name, name); \
+  static void name()
+
+/**
+ * Scale amount of work, quick runs take a hundredth of it
+ * @param[in] n - amount of work of full run
+ * @return amount of work of this run
+ */
+inline size_t scaled(size_t n) {
+  return bench_registry_t::instance().quick ? std::max<size_t>(n / 100, 1) : n;
+}
+
+/**
+ * Measure body by the fastest of several runs, so that warm-up and preemption don't count
+ * @param[in] body - measured work
+ * @return seconds of the fastest run
+ */
+inline double measure(std::function<void()> const& body) {
+  double best = std::numeric_limits<double>::infinity();
+  int runs = bench_registry_t::instance().quick ? 1 : 5;
+
+  for (int run = 0; run < runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+
+    body();
+
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+
+/**
+ * Print time of variant per unit of work and its speedup against the baseline
+ * @param[in] what - variant
+ * @param[in] seconds - time of variant
+ * @param[in] units - units of work, e.g. rows
+ * @param[in] baseline - time of baseline, 0 for the baseline itself
+ */
+inline void report(std::string const& what, double seconds, double units, double baseline = 0) {
+  std::printf("  %-44s %10.2f ns", what.c_str(), seconds * 1e9 / units);
+  if (baseline > 0)
+    std::printf("   x%.2f", baseline / seconds);
+  std::printf("\n");
+}
+
+/**
+ * Keep value observable, so that the compiler doesn't drop the computation
+ * @param[in] value - value
+ */
+inline void consume(double value) {
+  static volatile double sink;
+
+  sink = value;
+}
+
+/**
+ * Compare results of variant with the baseline
+ * @param[in] what - variant
+ * @param[in] res - results of variant
+ * @param[in] ref - results of baseline
+ * @param[in] tol - relative tolerance
+ */
+inline void compare(std::string const& what, std::vector<double> const& res, std::vector<double> const& ref, double tol) {
+  for (size_t i = 0; i < ref.size(); ++i) {
+    bool same = std::isnan(ref[i]) ? std::isnan(res[i]) :
+                std::fabs(res[i] - ref[i]) <= tol * std::max(1.0, std::fabs(ref[i]));
+
+    if (!same) {
+      bench_registry_t::instance().fail(what + " differs at " + std::to_string(i) + ": " + std::to_string(res[i]) +
+                                        " instead of " + std::to_string(ref[i]));
+      return;
+    }
+  }
+}
+
+/**
+ * Make uniformly distributed values, the seed is fixed so that runs are comparable
+ * @param[in] n - number of values
+ * @param[in] lo, hi - range of values
+ * @param[in] seed - seed of generator
+ * @return values
+ */
+inline std::vector<double> uniform(size_t n, double lo, double hi, unsigned seed = 1) {
+  std::mt19937_64 gen(seed);
+  std::uniform_real_distribution<double> dist(lo, hi);
+  std::vector<double> res(n);
+
+  for (double& v : res)
+    v = dist(gen);
+  return res;
+}
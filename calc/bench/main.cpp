@@ -0,0 +1,29 @@
+#include <cstring>
+#include "bench.h"
+
+int main(int argc, char* argv[]) {
+  bench_registry_t& reg = bench_registry_t::instance();
+  std::vector<std::string> only;
+
+  // benchmarks to run are named on the command line, --quick only checks that they work
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--quick") == 0)
+      reg.quick = true;
+    else
+      only.push_back(argv[i]);
+  }
+
+  for (auto& c : reg.cases) {
+    if (!only.empty() && std::find(only.begin(), only.end(), c.name) == only.end())
+      continue;
+    std::printf("%s\n", c.name);
+    try {
+      c.body();
+    }
+    catch (std::exception& e) {
+      reg.fail(std::string("unexpected exception ") + e.what());
+    }
+  }
+
+  return reg.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include "bench.h"
+
+/**
+ * Many formulas over a few common terms in one merged program against every formula apart
+ */
+BENCH_CASE(sharedSubexpressions) {
+  static char const* const terms[] = {
+    "sin(t)", "cos(t)", "x * y", "(x + y)", "hypot(x, y)", "t * t", "x / (y + 2)", "max(x, y, t)"
+  };
+  static char const* const ops[] = { " + ", " - ", " * " };
+  size_t const formulas = 300;
+  size_t rows = scaled(20000);
+  std::mt19937_64 gen(2);
+  std::vector<std::string> exprs;
+
+  // every formula combines three to five terms with a constant of its own
+  for (size_t k = 0; k < formulas; ++k) {
+    std::string expr = std::to_string(1 + gen() % 9) + " * " + terms[gen() % 8];
+
+    for (size_t n = 2 + gen() % 3; n > 0; --n)
+      expr += std::string(ops[gen() % 3]) + terms[gen() % 8];
+    exprs.push_back(expr);
+  }
+
+  std::map<std::string, std::vector<double>> columns = {
+    { "t", uniform(rows, 0.0, 3.0, 3) }, { "x", uniform(rows, -1.0, 1.0, 4) }, { "y", uniform(rows, 0.0, 1.0, 5) }
+  };
+  str_calc_t calc;
+  multi_program_t prog = calc.compile(exprs);
+
+  std::printf(" %zu formulas over %zu terms, %zu rows, ns per row\n", formulas, sizeof(terms) / sizeof(terms[0]), rows);
+  std::printf("  calls per row: %zu merged, %zu apart\n", prog.calls, prog.separateCalls);
+
+  std::vector<double> merged, one, ref(formulas * rows);
+  std::vector<uint64_t> validity;
+
+  double apart = measure([&] {
+    for (size_t k = 0; k < formulas; ++k) {
+      calc.calculateBatch(exprs[k], columns, rows, one, validity);
+      std::copy(one.begin(), one.begin() + rows, ref.begin() + k * rows);
+    }
+  });
+
+  report("every formula apart", apart, static_cast<double>(rows));
+
+  double shared = measure([&] { calc.calculateBatch(exprs, columns, rows, merged); });
+
+  report("merged program", shared, static_cast<double>(rows), apart);
+  compare("merged program", merged, ref, 1e-15);
+
+  double compile = measure([&] { consume(static_cast<double>(calc.compile(exprs).calls)); });
+
+  report("of which compilation of merged program", compile, static_cast<double>(rows));
+}
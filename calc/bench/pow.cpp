@@ -0,0 +1,67 @@
+#include "bench.h"
+
+/**
+ * Kernels of ^ against pow of the standard library, for every exponent the generic kernel,
+ * the kernel specialized for the constant exponent and the whole batch of the calculator,
+ * the kernels agree with pow within the tolerance of the plugin (~1.5e-14)
+ */
+BENCH_CASE(powKernels) {
+  str_calc_t calc;
+  size_t rows = scaled(1 << 20);
+  std::vector<double> x = uniform(rows, 0.5, 2.0);
+  std::vector<double> power(rows), res(rows), ref(rows);
+  std::vector<uint64_t> validity;
+
+  epoch_t::guard_t guard = calc.loader()->pin();
+  auto const& inf = calc.loader()->registry().loadedOps.inf;
+  auto it = inf.find("^");
+
+  if (it == inf.end()) {
+    bench_registry_t::instance().fail("^ is not loaded from plugins");
+    return;
+  }
+
+  infix_t& pow = *it->second;
+
+  for (double e : { 3.0, -2.0, 17.0, 0.5, 2.7 }) {
+    std::printf(" x ^ %g, ns per row\n", e);
+    std::fill(power.begin(), power.end(), e);
+
+    double const* args[] = { x.data(), power.data() };
+    double base = measure([&] {
+      for (size_t i = 0; i < rows; ++i)
+        ref[i] = std::pow(x[i], e);
+      consume(ref[rows - 1]);
+    });
+
+    report("std::pow", base, static_cast<double>(rows));
+
+    double generic = measure([&] { pow.evaluateBlock(args, res.data(), rows); });
+
+    report("generic kernel", generic, static_cast<double>(rows), base);
+    compare("generic kernel", res, ref, 1.5e-14);
+
+    std::shared_ptr<operation_t> fixed = pow.specialize(e);
+
+    if (fixed) {
+      double special = measure([&] { fixed->evaluateBlock(args, res.data(), rows); });
+
+      report("specialized kernel", special, static_cast<double>(rows), base);
+      compare("specialized kernel", res, ref, 1.5e-14);
+    }
+
+    std::map<std::string, std::vector<double>> columns = { { "x", x }, { "y", power } };
+    std::ostringstream constant;
+
+    constant << "x ^ " << e;
+    double variable = measure([&] { calc.calculateBatch("x ^ y", columns, rows, res, validity); });
+
+    report("batch of x ^ y", variable, static_cast<double>(rows), base);
+    compare("batch of x ^ y", res, ref, 1.5e-14);
+
+    double folded = measure([&] { calc.calculateBatch(constant.str(), columns, rows, res, validity); });
+
+    report("batch of " + constant.str(), folded, static_cast<double>(rows), base);
+    compare("batch of " + constant.str(), res, ref, 1.5e-14);
+  }
+}
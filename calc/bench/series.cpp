@@ -0,0 +1,101 @@
+#include "bench.h"
+
+/**
+ * Naive window function, which visits every sample of the window for every row
+ * @param[in] x - samples
+ * @param[in] w - window
+ * @param[in] f - reduction of the window
+ * @return result of every row
+ */
+template <typename F>
+static std::vector<double> naiveWindow(std::vector<double> const& x, size_t w, F f) {
+  std::vector<double> res(x.size());
+
+  for (size_t t = 0; t < x.size(); ++t) {
+    size_t from = t + 1 > w ? t + 1 - w : 0;
+
+    res[t] = f(x.data() + from, t + 1 - from);
+  }
+  return res;
+}
+
+/**
+ * Moving functions of the series plugin in a batch, where the rows are the ticks, against the naive loops
+ */
+BENCH_CASE(movingWindows) {
+  size_t const window = 500;
+  size_t rows = scaled(200000);
+  std::vector<double> x = uniform(rows, -1.0, 1.0);
+  std::vector<double> res, ref;
+  std::vector<uint64_t> validity;
+
+  // random walk, so that the extremums don't stay at the bounds of the range
+  for (size_t t = 1; t < rows; ++t)
+    x[t] += x[t - 1];
+
+  std::map<std::string, std::vector<double>> columns = { { "x", x } };
+  str_calc_t calc;
+
+  struct window_t {
+    char const* name;
+    double (*reduce)(double const*, size_t);
+  };
+
+  static window_t const windows[] = {
+    { "msum", [](double const* s, size_t n) { return std::accumulate(s, s + n, 0.0); } },
+    { "mavg", [](double const* s, size_t n) { return std::accumulate(s, s + n, 0.0) / static_cast<double>(n); } },
+    { "mmin", [](double const* s, size_t n) { return *std::min_element(s, s + n); } },
+    { "mmax", [](double const* s, size_t n) { return *std::max_element(s, s + n); } }
+  };
+
+  for (auto& f : windows) {
+    std::string expr = std::string(f.name) + "(x, " + std::to_string(window) + ")";
+
+    std::printf(" %s, ns per tick\n", expr.c_str());
+
+    double naive = measure([&] {
+      ref = naiveWindow(x, window, f.reduce);
+      consume(ref.back());
+    });
+
+    report("naive window", naive, static_cast<double>(rows));
+
+    double batch = measure([&] { calc.calculateBatch(expr, columns, rows, res, validity); });
+
+    report("batch", batch, static_cast<double>(rows), naive);
+    compare("batch of " + expr, res, ref, 1e-9);
+  }
+
+  std::printf(" ema(x, 0.01), ns per tick\n");
+
+  double loop = measure([&] {
+    ref.resize(rows);
+    ref[0] = x[0];
+    for (size_t t = 1; t < rows; ++t)
+      ref[t] = ref[t - 1] + 0.01 * (x[t] - ref[t - 1]);
+    consume(ref.back());
+  });
+
+  report("loop", loop, static_cast<double>(rows));
+
+  double batch = measure([&] { calc.calculateBatch("ema(x, 0.01)", columns, rows, res, validity); });
+
+  report("batch", batch, static_cast<double>(rows), loop);
+  compare("batch of ema(x, 0.01)", res, ref, 0);
+
+  // ticks which arrive one by one pay for setting the variable and for the call
+  std::printf(" msum(x, %zu) tick by tick, ns per tick\n", window);
+
+  program_t prog = calc.compile("msum(x, " + std::to_string(window) + ")");
+  double ticks = measure([&] {
+    prog.reset();
+    for (size_t t = 0; t < rows; ++t) {
+      calc.setVariable("x", x[t]);
+      res[t] = calc.calculate(prog);
+    }
+  });
+
+  ref = naiveWindow(x, window, windows[0].reduce);
+  report("calculate(program_t&) per tick", ticks, static_cast<double>(rows));
+  compare("msum tick by tick", res, ref, 1e-9);
+}
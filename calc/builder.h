@@ -0,0 +1,409 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+#include "include/operation.h"
+#include "include/variable.h"
+#include "compiler.h"
+#include "storage.h"
+
+/**
+ * @brief Built-in operations which expressions can be composed of
+ * @warning evaluation inlines the same arithmetic as plugins, ^ uses pow and may differ from the plugin in the last ulps
+ */
+struct add_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::INFIX_OP;
+  static constexpr char const* name = "+";
+  static double apply(double a, double b) noexcept { return a + b; }
+};
+
+struct sub_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::INFIX_OP;
+  static constexpr char const* name = "-";
+  static double apply(double a, double b) noexcept { return a - b; }
+};
+
+struct mul_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::INFIX_OP;
+  static constexpr char const* name = "*";
+  static double apply(double a, double b) noexcept { return a * b; }
+};
+
+struct div_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::INFIX_OP;
+  static constexpr char const* name = "/";
+  static double apply(double a, double b) noexcept { return a / b; }
+};
+
+struct pow_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::INFIX_OP;
+  static constexpr char const* name = "^";
+  static double apply(double a, double b) noexcept {
+    return a < 0 && b < 0 ? operation_t::domainError() : std::pow(a, b);
+  }
+};
+
+struct neg_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::PREFIX_OP;
+  static constexpr char const* name = "-";
+  static double apply(double a) noexcept { return -a; }
+};
+
+struct sin_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::FUNCTION;
+  static constexpr char const* name = "sin";
+  static double apply(double a) noexcept { return std::sin(a); }
+};
+
+struct cos_tag_t {
+  static constexpr operation_t::operation_type_t type = operation_t::operation_type_t::FUNCTION;
+  static constexpr char const* name = "cos";
+  static double apply(double a) noexcept { return std::cos(a); }
+};
+
+/**
+ * Find loaded operation which implements the built-in one
+ * @warning throws calc_exception_t if no plugin provides the operation
+ * @param[in] ops - loaded operations
+ * @return operation
+ */
+template <typename tag_t>
+std::shared_ptr<operation_t> findOperation(ops_maps const& ops) {
+  if constexpr (tag_t::type == operation_t::operation_type_t::INFIX_OP) {
+    auto oi = ops.inf.find(tag_t::name);
+    if (oi != ops.inf.end())
+      return oi->second;
+  }
+  else if constexpr (tag_t::type == operation_t::operation_type_t::PREFIX_OP) {
+    auto oi = ops.pref.find(tag_t::name);
+    if (oi != ops.pref.end())
+      return oi->second;
+  }
+  else {
+    auto oi = ops.funcs.find(tag_t::name);
+    if (oi != ops.funcs.end())
+      return oi->second;
+  }
+
+  throw calc_exception_t(calc_error_t::UNKNOWN_OPERATION, 0, "Unknown operation");
+}
+
+/**
+ * @brief Base of all expression types
+ */
+struct expr_base_t {};
+
+/**
+ * Check if type is an expression
+ */
+template <typename T>
+constexpr bool is_expr_v = std::is_base_of_v<expr_base_t, T>;
+
+/**
+ * @brief Number in expression
+ */
+class expr_const_t : public expr_base_t {
+private:
+  double value;  ///< value of number
+
+public:
+  /**
+   * Constructor
+   * @param[in] val - value of number
+   */
+  explicit expr_const_t(double val) noexcept : value(val) {}
+
+  /**
+   * Calculate expression
+   * @return value of number
+   */
+  double evaluate() const noexcept {
+    return value;
+  }
+
+  /**
+   * Returns copy with variables bound to storage
+   * @param[in] v - storage of variables
+   * @return copy of number
+   */
+  expr_const_t bind(var_storage_t& v) const {
+    return *this;
+  }
+
+  /**
+   * Append Reverse Polish Notation of expression
+   * @param[in] ops - loaded operations
+   * @param[in] v - storage of variables
+   * @param[out] rpnTokens - rpn queue
+   */
+  void lower(ops_maps const& ops, var_storage_t& v, token_queue_t& rpnTokens) const {
+    rpnTokens.push(std::unique_ptr<token_t>(new token_number_t(value)));
+  }
+};
+
+/**
+ * @brief Variable in expression
+ */
+class expr_var_t : public expr_base_t {
+private:
+  std::string name;                ///< name of variable
+  variable_t const* var = nullptr; ///< bound variable
+
+  /**
+   * Find variable in storage, create it if it is absent
+   * @warning throws calc_exception_t if the storage is full
+   * @param[in] v - storage of variables
+   * @return variable
+   */
+  std::shared_ptr<variable_t> const& find(var_storage_t& v) const {
+    return v.obtain(name);
+  }
+
+public:
+  /**
+   * Constructor
+   * @param[in] n - name of variable
+   */
+  explicit expr_var_t(std::string n) : name(std::move(n)) {}
+
+  /**
+   * Calculate expression
+   * @warning the expression must be bound and the variable initialized
+   * @return value of variable
+   */
+  double evaluate() const noexcept {
+    return var->getValue();
+  }
+
+  /**
+   * Returns copy with variables bound to storage
+   * @param[in] v - storage of variables, absent variables are created
+   * @return bound copy
+   */
+  expr_var_t bind(var_storage_t& v) const {
+    expr_var_t res(*this);
+
+    res.var = find(v).get();
+    return res;
+  }
+
+  /**
+   * Append Reverse Polish Notation of expression
+   * @param[in] ops - loaded operations
+   * @param[in] v - storage of variables, absent variables are created
+   * @param[out] rpnTokens - rpn queue
+   */
+  void lower(ops_maps const& ops, var_storage_t& v, token_queue_t& rpnTokens) const {
+    rpnTokens.push(std::unique_ptr<token_t>(new token_variable_t(find(v))));
+  }
+};
+
+/**
+ * @brief Built-in prefix operation or function of one operand
+ */
+template <typename tag_t, typename arg_t>
+class expr_unary_t : public expr_base_t {
+private:
+  arg_t arg;  ///< operand
+
+public:
+  /**
+   * Constructor
+   * @param[in] a - operand
+   */
+  explicit expr_unary_t(arg_t const& a) : arg(a) {}
+
+  /**
+   * Calculate expression
+   * @return result of operation
+   */
+  double evaluate() const noexcept {
+    return tag_t::apply(arg.evaluate());
+  }
+
+  /**
+   * Returns copy with variables bound to storage
+   * @param[in] v - storage of variables, absent variables are created
+   * @return bound copy
+   */
+  expr_unary_t bind(var_storage_t& v) const {
+    return expr_unary_t(arg.bind(v));
+  }
+
+  /**
+   * Append Reverse Polish Notation of expression
+   * @param[in] ops - loaded operations
+   * @param[in] v - storage of variables, absent variables are created
+   * @param[out] rpnTokens - rpn queue
+   */
+  void lower(ops_maps const& ops, var_storage_t& v, token_queue_t& rpnTokens) const {
+    arg.lower(ops, v, rpnTokens);
+    rpnTokens.push(std::unique_ptr<token_t>(new token_operation_t(findOperation<tag_t>(ops))));
+  }
+};
+
+/**
+ * @brief Built-in infix operation
+ */
+template <typename tag_t, typename lhs_t, typename rhs_t>
+class expr_binary_t : public expr_base_t {
+private:
+  lhs_t lhs;  ///< left operand
+  rhs_t rhs;  ///< right operand
+
+public:
+  /**
+   * Constructor
+   * @param[in] l - left operand
+   * @param[in] r - right operand
+   */
+  expr_binary_t(lhs_t const& l, rhs_t const& r) : lhs(l), rhs(r) {}
+
+  /**
+   * Calculate expression
+   * @return result of operation
+   */
+  double evaluate() const noexcept {
+    return tag_t::apply(lhs.evaluate(), rhs.evaluate());
+  }
+
+  /**
+   * Returns copy with variables bound to storage
+   * @param[in] v - storage of variables, absent variables are created
+   * @return bound copy
+   */
+  expr_binary_t bind(var_storage_t& v) const {
+    return expr_binary_t(lhs.bind(v), rhs.bind(v));
+  }
+
+  /**
+   * Append Reverse Polish Notation of expression
+   * @param[in] ops - loaded operations
+   * @param[in] v - storage of variables, absent variables are created
+   * @param[out] rpnTokens - rpn queue
+   */
+  void lower(ops_maps const& ops, var_storage_t& v, token_queue_t& rpnTokens) const {
+    lhs.lower(ops, v, rpnTokens);
+    rhs.lower(ops, v, rpnTokens);
+    rpnTokens.push(std::unique_ptr<token_t>(new token_operation_t(findOperation<tag_t>(ops))));
+  }
+};
+
+/**
+ * Make variable of expression
+ * @param[in] name - name of variable
+ * @return expression
+ */
+inline expr_var_t var(std::string const& name) {
+  return expr_var_t(name);
+}
+
+/**
+ * Make number of expression
+ * @param[in] value - value of number
+ * @return expression
+ */
+inline expr_const_t constant(double value) noexcept {
+  return expr_const_t(value);
+}
+
+/**
+ * Convert operand of built-in operation to expression
+ * @param[in] x - expression or number
+ * @return expression
+ */
+template <typename T>
+auto toExpr(T const& x) {
+  if constexpr (is_expr_v<T>)
+    return x;
+  else
+    return expr_const_t(static_cast<double>(x));
+}
+
+/**
+ * Check if types are operands of built-in infix operation: at least one expression and possibly a number
+ */
+template <typename L, typename R>
+constexpr bool is_expr_pair_v = (is_expr_v<L> || is_expr_v<R>) &&
+  (is_expr_v<L> || std::is_arithmetic_v<L>) && (is_expr_v<R> || std::is_arithmetic_v<R>);
+
+/**
+ * Sum of operands, one of them may be a number
+ */
+template <typename L, typename R, typename = std::enable_if_t<is_expr_pair_v<L, R>>>
+auto operator+(L const& l, R const& r) {
+  return expr_binary_t<add_tag_t, decltype(toExpr(l)), decltype(toExpr(r))>(toExpr(l), toExpr(r));
+}
+
+/**
+ * Difference of operands, one of them may be a number
+ */
+template <typename L, typename R, typename = std::enable_if_t<is_expr_pair_v<L, R>>>
+auto operator-(L const& l, R const& r) {
+  return expr_binary_t<sub_tag_t, decltype(toExpr(l)), decltype(toExpr(r))>(toExpr(l), toExpr(r));
+}
+
+/**
+ * Product of operands, one of them may be a number
+ */
+template <typename L, typename R, typename = std::enable_if_t<is_expr_pair_v<L, R>>>
+auto operator*(L const& l, R const& r) {
+  return expr_binary_t<mul_tag_t, decltype(toExpr(l)), decltype(toExpr(r))>(toExpr(l), toExpr(r));
+}
+
+/**
+ * Quotient of operands, one of them may be a number
+ */
+template <typename L, typename R, typename = std::enable_if_t<is_expr_pair_v<L, R>>>
+auto operator/(L const& l, R const& r) {
+  return expr_binary_t<div_tag_t, decltype(toExpr(l)), decltype(toExpr(r))>(toExpr(l), toExpr(r));
+}
+
+/**
+ * Power of operands, one of them may be a number
+ * @warning ^ has the wrong priority in C++ to be overloaded
+ */
+template <typename L, typename R, typename = std::enable_if_t<is_expr_pair_v<L, R>>>
+auto pow(L const& l, R const& r) {
+  return expr_binary_t<pow_tag_t, decltype(toExpr(l)), decltype(toExpr(r))>(toExpr(l), toExpr(r));
+}
+
+/**
+ * Negation of expression
+ */
+template <typename A, typename = std::enable_if_t<is_expr_v<A>>>
+auto operator-(A const& a) {
+  return expr_unary_t<neg_tag_t, A>(a);
+}
+
+/**
+ * Sine of expression
+ */
+template <typename A, typename = std::enable_if_t<is_expr_v<A>>>
+auto sin(A const& a) {
+  return expr_unary_t<sin_tag_t, A>(a);
+}
+
+/**
+ * Cosine of expression
+ */
+template <typename A, typename = std::enable_if_t<is_expr_v<A>>>
+auto cos(A const& a) {
+  return expr_unary_t<cos_tag_t, A>(a);
+}
+
+/**
+ * Translate expression into verified program
+ * @warning throws calc_exception_t if some operation is not loaded from plugins
+ * @param[in] e - expression
+ * @param[in] ops - loaded operations
+ * @param[in] v - storage of variables, absent variables are created
+ * @return compiled program
+ */
+template <typename expr_t, typename = std::enable_if_t<is_expr_v<expr_t>>>
+program_t lower(expr_t const& e, ops_maps const& ops, var_storage_t& v) {
+  token_queue_t rpnTokens;
+
+  e.lower(ops, v, rpnTokens);
+  return compiler_t().compile(rpnTokens);
+}
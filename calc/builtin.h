@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cmath>
+#include "include/operation.h"
+#include "error.h"
+
+/**
+ * @brief Fused multiply-add fma(a, b, c) = a * b + c with a single rounding
+ * @warning is not loaded from plugins, the optimizer inserts it into rpn queue by itself
+ */
+class fma_op_t : public function_t {
+public:
+  /**
+   * Default constructor
+   */
+  fma_op_t() = default;
+
+  /**
+   * Takes three operands
+   */
+  size_t arity() const noexcept override {
+    return 3;
+  }
+
+  /**
+   * Returns the semantics of operation
+   */
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::FMA;
+  }
+
+  /**
+   * Performs computation on already extracted operands
+   * param[in] args - operands a, b, c
+   * @return a * b + c
+   */
+  double evaluate(double const* args) override {
+    return std::fma(args[0], args[1], args[2]);
+  }
+
+  /**
+   * Performs computation on blocks of operands
+   * param[in] args - arrays of operands a, b, c
+   * param[out] res - results
+   * param[in] n - number of elements in each array
+   */
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = std::fma(args[0][i], args[1][i], args[2][i]);
+  }
+
+  /**
+   * Performs computation on blocks of single precision operands
+   * param[in] args - arrays of operands a, b, c
+   * param[out] res - results
+   * param[in] n - number of elements in each array
+   */
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = std::fma(args[0][i], args[1][i], args[2][i]);
+  }
+
+  /**
+   * Computes partial derivatives of the result by each operand
+   * param[in] args - operands a, b, c
+   * param[out] partials - derivatives by a, b, c
+   * @return true
+   */
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = args[1];
+    partials[1] = args[0];
+    partials[2] = 1;
+    return true;
+  }
+
+  /**
+   * Performs operand processing
+   * param[in] stack - stack of operands
+   */
+  void process(token_stack_t& stack) override {
+    double c = getNumber(stack);
+    double b = getNumber(stack);
+    double a = getNumber(stack);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(std::fma(a, b, c))));
+  }
+};
+
+
+/**
+ * @brief Separator of function arguments
+ * @warning is not loaded from plugins, the scanner emits it for comma and the parser consumes it
+ */
+class separator_t : public infix_t {
+public:
+  /**
+   * Default constructor
+   */
+  separator_t() : infix_t(-1.0, infix_t::operation_assoc_t::TO_RIGHT) {}
+
+  /**
+   * Separator never reaches rpn queue
+   * @warning throws calc_exception_t
+   * param[in] stack - stack of operands
+   */
+  void process(token_stack_t& stack) override {
+    throw calc_exception_t(calc_error_t::SYNTAX, 0, "Unexpected separator");
+  }
+};
@@ -1,11 +1,17 @@
-﻿#include "calc.h"
+﻿#include <cmath>
+#include "calc.h"
+#include "trace.h"
 
 /**
  * Calculate by rpn queue
+ * @warning throws calc_exception_t with position for uninitialized variables and domain errors
  * @param[in] rpnTokens - rpn queue
  * @returns result of calculation
  */
 double calculator_t::calculate(token_queue_t& rpnTokens) {
+  trace_span_t span("evaluate tokens", "evaluation");
+  tracer_t& tracer = tracer_t::instance();
+  bool timed = tracer.timed();
   token_stack_t operands;
 
   while (!rpnTokens.empty()) {
@@ -14,12 +20,28 @@ double calculator_t::calculate(token_queue_t& rpnTokens) {
 
     if (tok->type == token_t::token_type_t::TOKEN_TYPE_NUMBER ||
           tok->type == token_t::token_type_t::TOKEN_TYPE_VARIABLE) {
+      if (tok->type == token_t::token_type_t::TOKEN_TYPE_VARIABLE &&
+            !static_cast<token_variable_t*>(tok.get())->var->isInit())
+        throw calc_exception_t(calc_error_t::UNINITIALIZED_VARIABLE, tok->pos, "Uninitialized variable");
       operands.push(std::move(tok));
     }
     else {
       token_operation_t* op = static_cast<token_operation_t*>(tok.get());
 
-      op->operation->process(operands);
+      // plugins know nothing of positions, so their domain errors get the position of the operation here
+      try {
+        if (timed) {
+          uint64_t start = tracer.now();
+
+          op->operation->process(operands);
+          tracer.call("process", start, op->pos);
+        }
+        else
+          op->operation->process(operands);
+      }
+      catch (domain_error_t&) {
+        throw calc_exception_t(calc_error_t::DOMAIN, op->pos, "Domain error");
+      }
     }
   }
 
@@ -35,4 +57,171 @@ double calculator_t::calculate(token_queue_t& rpnTokens) {
   token_number_t* num = static_cast<token_number_t*>(tok.get());
   
   return num->value;
+}
+
+/**
+ * Run bound program, operands are checked only for operations with restricted domain
+ * @param[in] prog - compiled program
+ * @returns result of calculation or domain error at the first operation outside its domain
+ */
+calc_result_t calculator_t::run(program_t const& prog) {
+  calc_result_t res;
+
+  if (stack.size() < prog.maxDepth)
+    stack.resize(prog.maxDepth);
+
+  // the compiler has verified that the stack neither underflows nor exceeds maxDepth
+  double* sp = stack.data();
+  std::vector<instr_t> const& code = prog.fused.empty() ? prog.code : prog.fused;
+  tracer_t& tracer = tracer_t::instance();
+  bool timed = tracer.timed(); // calls are timed only while the evaluation is recorded
+
+  for (size_t i = 0; i < code.size(); ++i) {
+    instr_t const& in = code[i];
+
+    switch (in.code) {
+      case instr_t::opcode_t::PUSH_NUMBER:
+        *sp++ = in.value;
+        break;
+      case instr_t::opcode_t::PUSH_VARIABLE:
+        *sp++ = prog.vars[in.slot]->getValue();
+        break;
+      case instr_t::opcode_t::CALL:
+        sp -= in.arity;
+        if (in.checked && !in.operation->inDomain(sp)) {
+          res.error = calc_error_t::DOMAIN;
+          res.position = in.pos;
+          return res;
+        }
+        if (timed) {
+          uint64_t start = tracer.now();
+
+          *sp = in.operation->evaluate(sp);
+          tracer.call("process", start, in.pos);
+        }
+        else
+          *sp = in.operation->evaluate(sp);
+        ++sp;
+        break;
+      case instr_t::opcode_t::UPDATE:
+      {
+        state_t& st = *prog.states[in.slot];
+
+        sp -= in.arity;
+        // the sample outside the domain is not taken
+        if (in.checked && !in.operation->inDomain(sp)) {
+          res.error = calc_error_t::DOMAIN;
+          res.position = in.pos;
+          return res;
+        }
+        *sp = st.result = static_cast<stateful_t*>(in.operation)->update(st, sp);
+        ++sp;
+        break;
+      }
+      case instr_t::opcode_t::PUSH_VARIABLE2:
+        *sp++ = prog.vars[in.slot]->getValue();
+        *sp++ = prog.vars[in.slot2]->getValue();
+        break;
+      case instr_t::opcode_t::MUL_VV:
+        *sp++ = prog.vars[in.slot]->getValue() * prog.vars[in.slot2]->getValue();
+        break;
+      case instr_t::opcode_t::MUL_VC:
+        *sp++ = prog.vars[in.slot]->getValue() * in.value;
+        break;
+      case instr_t::opcode_t::ADD_V:
+        sp[-1] += prog.vars[in.slot]->getValue();
+        break;
+      case instr_t::opcode_t::MUL_V:
+        sp[-1] *= prog.vars[in.slot]->getValue();
+        break;
+      case instr_t::opcode_t::ADD_C:
+        sp[-1] += in.value;
+        break;
+      case instr_t::opcode_t::SUB_C:
+        sp[-1] -= in.value;
+        break;
+      case instr_t::opcode_t::MUL_C:
+        sp[-1] *= in.value;
+        break;
+      case instr_t::opcode_t::DIV_C:
+        sp[-1] /= in.value;
+        break;
+      case instr_t::opcode_t::MUL_ADD:
+        sp -= 2;
+        sp[-1] += sp[0] * sp[1];
+        break;
+      case instr_t::opcode_t::FMA_ADD:
+        sp -= 2;
+        sp[-1] = std::fma(sp[0], sp[1], sp[-1]);
+        break;
+      case instr_t::opcode_t::MUL_C_ADD:
+        --sp;
+        sp[-1] += sp[0] * in.value;
+        break;
+      case instr_t::opcode_t::JUMP_IF_FALSE:
+        // NaN condition is the result of the whole conditional
+        if (sp[-1] != sp[-1])
+          i += in.slot2 - 1;
+        else if (*--sp == 0)
+          i += in.slot - 1;
+        break;
+      case instr_t::opcode_t::JUMP:
+        i += in.slot - 1;
+        break;
+      default: // instructions of formula sets never appear in program_t
+        break;
+    }
+  }
+
+  res.value = stack[0];
+  return res;
+}
+
+/**
+ * Calculate by compiled program, operands are checked only for operations with restricted domain
+ * @warning throws calc_exception_t if the program has uninitialized variables or domain error
+ * @param[in] prog - compiled program
+ * @returns result of calculation
+ */
+double calculator_t::calculate(program_t& prog) {
+  trace_span_t span("evaluate", "evaluation");
+
+  prog.bind();
+
+  calc_result_t res = run(prog);
+
+  if (!res)
+    throw calc_exception_t(res.error, res.position);
+  return res.value;
+}
+
+/**
+ * Calculate by compiled program without throwing
+ * @param[in] prog - compiled program
+ * @returns result of calculation or error with its position
+ */
+calc_result_t calculator_t::tryCalculate(program_t& prog) noexcept {
+  trace_span_t span("evaluate", "evaluation");
+  calc_result_t res;
+  size_t slot;
+
+  if (!prog.tryBind(slot)) {
+    res.error = calc_error_t::UNINITIALIZED_VARIABLE;
+    res.position = prog.position(slot);
+    return res;
+  }
+
+  // operations may still throw from process if they don't override evaluate
+  try {
+    res = run(prog);
+  }
+  catch (calc_exception_t& e) {
+    res.error = e.code;
+    res.position = e.position;
+  }
+  catch (std::exception&) {
+    res.error = calc_error_t::DOMAIN;
+  }
+
+  return res;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "include/operation.h"
 #include "include/variable.h"
+#include "program.h"
 
 /**
  * @brief Class of the rpn queue evaluator
@@ -9,6 +10,14 @@
 class calculator_t {
 private:
   ops_maps ops;        ///< Struct which stores all known operations
+  std::vector<double> stack;  ///< Preallocated operand stack for compiled programs
+
+  /**
+   * Run bound program, operands are checked only for operations with restricted domain
+   * @param[in] prog - compiled program
+   * @returns result of calculation or domain error at the first operation outside its domain
+   */
+  calc_result_t run(program_t const& prog);
 public:
   /**
    * Default constructor
@@ -25,11 +34,27 @@ public:
 
   /**
    * Calculate by rpn queue
+   * @warning throws calc_exception_t with position for uninitialized variables and domain errors
    * @param[in] rpnTokens - rpn queue
    * @returns result of calculation
    */
   double calculate(token_queue_t& rpnTokens);
 
+  /**
+   * Calculate by compiled program, operands are checked only for operations with restricted domain
+   * @warning throws calc_exception_t if the program has uninitialized variables or domain error
+   * @param[in] prog - compiled program
+   * @returns result of calculation
+   */
+  double calculate(program_t& prog);
+
+  /**
+   * Calculate by compiled program without throwing
+   * @param[in] prog - compiled program
+   * @returns result of calculation or error with its position
+   */
+  calc_result_t tryCalculate(program_t& prog) noexcept;
+
   /**
    * Destructor
    */
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include "canon.h"
+
+/**
+ * Append bytes of value to key
+ * @param[in] key - key
+ * @param[out] key - augmented key
+ * @param[in] value - value
+ */
+template <typename T>
+static void append(std::string& key, T const& value) {
+  char bytes[sizeof(T)];
+
+  std::memcpy(bytes, &value, sizeof(T));
+  key.append(bytes, sizeof(T));
+}
+
+/**
+ * Sort operands of commutative operations in the tree
+ * @param[in] node - root of the tree
+ * @param[out] node - tree with sorted operands
+ * @return key of the tree structure where all variables are alike
+ */
+std::string canonicalizer_t::sort(expr_node_t& node) {
+  std::string res;
+
+  switch (node.type) {
+    case expr_node_t::node_type_t::NODE_TYPE_NUMBER:
+      res += 'n';
+      append(res, node.value);
+      return res;
+    case expr_node_t::node_type_t::NODE_TYPE_VARIABLE:
+      return "v";
+    default:
+      break;
+  }
+
+  std::vector<std::string> shapes;
+
+  for (auto& arg : node.args)
+    shapes.push_back(sort(*arg));
+
+  if (node.args.size() > 1 && node.operation->isCommutative()) {
+    std::vector<size_t> order(node.args.size());
+    std::vector<expr_tree_t> args;
+
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&shapes](size_t a, size_t b) {
+      return shapes[a] < shapes[b];
+    });
+    for (size_t i : order)
+      args.push_back(std::move(node.args[i]));
+    node.args = std::move(args);
+    std::sort(shapes.begin(), shapes.end());
+  }
+
+  res += 'o';
+  append(res, node.operation.get());
+  for (auto& shape : shapes)
+    res += shape;
+  res += ')';
+  return res;
+}
+
+/**
+ * Append key of the tree where variables are numbered by their first occurrence
+ * @param[in] node - root of the tree with sorted operands
+ */
+void canonicalizer_t::write(expr_node_t const& node) {
+  switch (node.type) {
+    case expr_node_t::node_type_t::NODE_TYPE_NUMBER:
+      k += 'n';
+      append(k, node.value);
+      break;
+    case expr_node_t::node_type_t::NODE_TYPE_VARIABLE:
+    {
+      auto vi = index.emplace(node.var.get(), static_cast<uint32_t>(vars.size())).first;
+
+      if (vi->second == vars.size())
+        vars.push_back(node.var);
+      k += 'v';
+      append(k, vi->second);
+      break;
+    }
+    default:
+      k += 'o';
+      append(k, node.operation.get());
+      for (auto& arg : node.args)
+        write(*arg);
+      k += ')';
+      break;
+  }
+}
+
+/**
+ * Rewrite rpn queue into canonical form
+ * @warning throws calc_exception_t if the queue is not a single correct expression
+ * @param[in] rpnTokens - rpn queue
+ * @param[out] rpnTokens - empty queue
+ * @return canonical rpn queue, it computes the same value
+ */
+token_queue_t& canonicalizer_t::canonicalize(token_queue_t& rpnTokens) {
+  // the tree has no brackets, so redundant ones are gone
+  expr_tree_t tree = expr_node_t::fromRpn(rpnTokens);
+
+  while (!qres.empty())
+    qres.pop();
+  k.assign(1, '\0');
+  vars.clear();
+  index.clear();
+  sort(*tree);
+  write(*tree);
+  tree->toRpn(qres);
+  return qres;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include "tree.h"
+
+/**
+ * @brief Class which rewrites rpn queue into canonical form and makes its key
+ * @warning expressions which differ by brackets, by order of operands of commutative operations or by
+ * consistent renaming of variables get the same key. Operands are sorted by their structure, so ties between
+ * subexpressions of the same structure may leave some equivalent expressions with different keys, which costs
+ * a compilation but never a wrong result.
+ */
+class canonicalizer_t {
+private:
+  token_queue_t qres;                                      ///< resulting rpn queue
+  std::string k;                                           ///< key of the last expression
+  std::vector<std::shared_ptr<variable_t>> vars;           ///< variables of the last expression by canonical index
+  std::unordered_map<variable_t const*, uint32_t> index;   ///< canonical indices of variables
+
+  /**
+   * Sort operands of commutative operations in the tree
+   * @param[in] node - root of the tree
+   * @param[out] node - tree with sorted operands
+   * @return key of the tree structure where all variables are alike
+   */
+  static std::string sort(expr_node_t& node);
+
+  /**
+   * Append key of the tree where variables are numbered by their first occurrence
+   * @param[in] node - root of the tree with sorted operands
+   */
+  void write(expr_node_t const& node);
+
+public:
+  /**
+   * Rewrite rpn queue into canonical form
+   * @warning throws calc_exception_t if the queue is not a single correct expression
+   * @param[in] rpnTokens - rpn queue
+   * @param[out] rpnTokens - empty queue
+   * @return canonical rpn queue, it computes the same value
+   */
+  token_queue_t& canonicalize(token_queue_t& rpnTokens);
+
+  /**
+   * Returns key of the last expression
+   * @warning the key is binary, it starts with zero character and never equals a string with expression.
+   * Operations are identified by address, so keys are valid while the operations are alive.
+   * @return key
+   */
+  std::string const& key() const noexcept {
+    return k;
+  }
+
+  /**
+   * Returns variables of the last expression
+   * @return variables by canonical index, i.e. by their first occurrence in canonical form
+   */
+  std::vector<std::shared_ptr<variable_t>> const& variables() const noexcept {
+    return vars;
+  }
+};
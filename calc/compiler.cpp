@@ -0,0 +1,143 @@
+#include <algorithm>
+#include "compiler.h"
+#include "trace.h"
+
+/**
+ * @brief Code range which produces an operand of the compiled program
+ */
+struct operand_t {
+  size_t start;  ///< index of the first instruction
+  size_t cond;   ///< index of ? instruction if the operand is c ? a, npos otherwise
+  size_t split;  ///< index of the first instruction of a if the operand is c ? a
+};
+
+static constexpr size_t npos = static_cast<size_t>(-1);
+
+/**
+ * Compile rpn queue, conditionals c ? a : b are lowered into c, JUMP_IF_FALSE, a, JUMP, b
+ * @warning throws calc_exception_t if operations lack operands or more than one result remains
+ * @param[in] rpnTokens - rpn queue
+ * @param[out] rpnTokens - empty queue
+ * @return compiled program
+ */
+program_t compiler_t::compile(token_queue_t& rpnTokens) {
+  trace_span_t span("compile", "pipeline");
+  program_t prog;
+  std::vector<operand_t> operands;
+
+  while (!rpnTokens.empty()) {
+    std::unique_ptr<token_t> tok = std::move(rpnTokens.front());
+    rpnTokens.pop();
+    instr_t in;
+
+    in.pos = tok->pos;
+
+    switch (tok->type) {
+      case token_t::token_type_t::TOKEN_TYPE_NUMBER:
+        in.code = instr_t::opcode_t::PUSH_NUMBER;
+        in.value = static_cast<token_number_t*>(tok.get())->value;
+        operands.push_back({prog.code.size(), npos, npos});
+        break;
+      case token_t::token_type_t::TOKEN_TYPE_VARIABLE:
+      {
+        std::shared_ptr<variable_t>& var = static_cast<token_variable_t*>(tok.get())->var;
+        auto vi = std::find(prog.vars.begin(), prog.vars.end(), var);
+
+        in.code = instr_t::opcode_t::PUSH_VARIABLE;
+        in.slot = vi - prog.vars.begin();
+        if (vi == prog.vars.end())
+          prog.vars.push_back(var);
+        operands.push_back({prog.code.size(), npos, npos});
+        break;
+      }
+      default:
+      {
+        std::shared_ptr<operation_t>& op = static_cast<token_operation_t*>(tok.get())->operation;
+
+        if (op->arity() == 0 && op->type != operation_t::operation_type_t::FUNCTION)
+          continue; // brackets do nothing
+        if (operands.size() < op->arity())
+          throw calc_exception_t(calc_error_t::SYNTAX, in.pos, "Syntax error");
+
+        size_t first = operands.size() - op->arity();
+        operand_t res = {op->arity() == 0 ? prog.code.size() : operands[first].start, npos, npos};
+
+        for (size_t k = first + (op->kind() == operation_t::operation_kind_t::SELECT ? 1 : 0); k < operands.size(); ++k)
+          if (operands[k].cond != npos)
+            throw calc_exception_t(calc_error_t::SYNTAX, prog.code[operands[k].cond].pos, "Expected : after ?");
+
+        if (op->kind() == operation_t::operation_kind_t::SELECT) {
+          if (op->arity() != 2 || operands[first].cond == npos)
+            throw calc_exception_t(calc_error_t::SYNTAX, in.pos, "Expected ? before :");
+
+          operand_t const& c = operands[first];
+          size_t la = c.cond - c.split;
+          size_t lb = prog.code.size() - c.cond - 1;
+          instr_t jf;
+
+          // ? becomes the jump over b, the jump over a is inserted before a, so offsets are relative
+          prog.code[c.cond].code = instr_t::opcode_t::JUMP;
+          prog.code[c.cond].operation = nullptr;
+          prog.code[c.cond].arity = 0;
+          prog.code[c.cond].slot = lb + 1;
+          jf.code = instr_t::opcode_t::JUMP_IF_FALSE;
+          jf.pos = prog.code[c.cond].pos;
+          jf.slot = la + 2;
+          jf.slot2 = la + lb + 2;
+          prog.code.insert(prog.code.begin() + c.split, jf);
+          prog.branches = true;
+          operands.resize(first);
+          operands.push_back(res);
+          continue;
+        }
+        if (op->kind() == operation_t::operation_kind_t::COND) {
+          if (op->arity() != 2)
+            throw calc_exception_t(calc_error_t::SYNTAX, in.pos, "Syntax error");
+          res.cond = prog.code.size();
+          res.split = operands[first + 1].start;
+        }
+
+        std::shared_ptr<operation_t> callee = op;
+
+        // a constant last operand is folded into the operation, e.g. x^3 gets its multiplication chain
+        if (op->arity() >= 2 && op->kind() != operation_t::operation_kind_t::COND && operands.back().cond == npos &&
+              operands.back().start + 1 == prog.code.size() && prog.code.back().code == instr_t::opcode_t::PUSH_NUMBER) {
+          std::shared_ptr<operation_t> fixed = op->specialize(prog.code.back().value);
+
+          if (fixed && fixed->arity() + 1 == op->arity()) {
+            callee = std::move(fixed);
+            prog.code.pop_back();
+            operands.pop_back();
+          }
+        }
+
+        in.code = instr_t::opcode_t::CALL;
+        in.arity = callee->arity();
+        in.operation = callee.get();
+        in.checked = callee->hasDomain();
+        if (stateful_t* st = dynamic_cast<stateful_t*>(callee.get())) {
+          // every call site keeps its own history
+          in.code = instr_t::opcode_t::UPDATE;
+          in.slot = prog.states.size();
+          prog.states.push_back(st->makeState());
+        }
+        if (std::find(prog.ops.begin(), prog.ops.end(), callee) == prog.ops.end())
+          prog.ops.push_back(callee);
+        operands.resize(first);
+        operands.push_back(res);
+        break;
+      }
+    }
+
+    prog.code.push_back(in);
+    // the depth of linear code bounds the depth of every path through the branches
+    prog.maxDepth = std::max(prog.maxDepth, operands.size());
+  }
+
+  if (operands.size() != 1)
+    throw calc_exception_t(calc_error_t::SYNTAX, prog.code.empty() ? 0 : prog.code.back().pos, "Syntax error");
+  if (operands[0].cond != npos)
+    throw calc_exception_t(calc_error_t::SYNTAX, prog.code[operands[0].cond].pos, "Expected : after ?");
+
+  return prog;
+}
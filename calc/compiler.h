@@ -0,0 +1,28 @@
+#pragma once
+
+#include "program.h"
+
+/**
+ * @brief Class which translates rpn queue into verified program
+ */
+class compiler_t {
+public:
+  /**
+   * Default constructor
+   */
+  compiler_t() = default;
+
+  /**
+   * Compile rpn queue
+   * @warning throws calc_exception_t if operations lack operands or more than one result remains
+   * @param[in] rpnTokens - rpn queue
+   * @param[out] rpnTokens - empty queue
+   * @return compiled program
+   */
+  program_t compile(token_queue_t& rpnTokens);
+
+  /**
+   * Destructor
+   */
+  ~compiler_t() = default;
+};
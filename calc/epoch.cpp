@@ -0,0 +1,99 @@
+#include <thread>
+#include <algorithm>
+#include "epoch.h"
+
+/**
+ * Destructor, unpins the reader and reclaims what it has been holding back
+ */
+epoch_t::guard_t::~guard_t() {
+  if (!owner)
+    return;
+  owner->slots[slot].epoch.store(0, std::memory_order_release);
+  owner->slots[slot].used.store(false, std::memory_order_release);
+
+  // readers never wait for reclamation, it is done by the one which gets the lock
+  if (owner->pending.load(std::memory_order_relaxed) != 0 && owner->m.try_lock()) {
+    owner->reclaim();
+    owner->m.unlock();
+  }
+}
+
+/**
+ * Pin the current epoch, objects published at this moment stay alive until the guard is destroyed
+ * @warning waits while all maxReaders slots are taken
+ * @return guard of the reader
+ */
+epoch_t::guard_t epoch_t::pin() noexcept {
+  for (size_t i = 0;; i = (i + 1) % maxReaders) {
+    bool free = false;
+
+    if (!slots[i].used.load(std::memory_order_relaxed) &&
+          slots[i].used.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+      // the epoch is visible to writers before the reader loads any published pointer
+      slots[i].epoch.store(global.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+      return guard_t(this, i);
+    }
+    if (i + 1 == maxReaders)
+      std::this_thread::yield();
+  }
+}
+
+/**
+ * Delete the object when no reader can see it anymore
+ * @warning the object must be unpublished before the call
+ * @param[in] deleter - deletes the object
+ */
+void epoch_t::retire(std::function<void()> deleter) {
+  std::lock_guard<std::mutex> lock(m);
+
+  // readers which pin after the increment see only the new publication
+  retired.push_back({global.fetch_add(1, std::memory_order_seq_cst), std::move(deleter)});
+  pending.store(retired.size(), std::memory_order_relaxed);
+  reclaim();
+}
+
+/**
+ * Delete retired objects whose readers have unpinned
+ * @warning m must be locked
+ */
+void epoch_t::reclaim() {
+  uint64_t oldest = global.load(std::memory_order_seq_cst);
+
+  for (slot_t const& s : slots) {
+    uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+
+    if (e != 0)
+      oldest = std::min(oldest, e);
+  }
+
+  // an object retired in epoch e may be seen by readers pinned in epochs up to e
+  auto ri = std::partition(retired.begin(), retired.end(), [oldest](retired_t const& r) {
+    return r.epoch >= oldest;
+  });
+  std::vector<retired_t> ready(std::make_move_iterator(ri), std::make_move_iterator(retired.end()));
+
+  retired.erase(ri, retired.end());
+  pending.store(retired.size(), std::memory_order_relaxed);
+  for (retired_t& r : ready)
+    r.deleter();
+}
+
+/**
+ * Delete retired objects whose readers have unpinned
+ * @return number of objects which are still waiting
+ */
+size_t epoch_t::collect() {
+  std::lock_guard<std::mutex> lock(m);
+
+  reclaim();
+  return retired.size();
+}
+
+/**
+ * Destructor, deletes all retired objects
+ * @warning no reader may be pinned
+ */
+epoch_t::~epoch_t() {
+  for (retired_t& r : retired)
+    r.deleter();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Epoch-based reclamation of objects which readers access without locks
+ * @warning readers pin an epoch while they use the objects, a retired object is deleted
+ * only after every reader which could have seen it has unpinned
+ */
+class epoch_t {
+public:
+  static constexpr size_t maxReaders = 64;  ///< number of readers which can be pinned at once
+
+  /**
+   * @brief Pinned epoch of a reader, unpinned on destruction
+   */
+  class guard_t {
+  private:
+    epoch_t* owner;  ///< epochs where the reader is pinned, nullptr after move
+    size_t slot;     ///< slot of the reader
+
+  public:
+    /**
+     * Constructor
+     * @param[in] e - epochs
+     * @param[in] s - slot of the reader
+     */
+    guard_t(epoch_t* e, size_t s) noexcept : owner(e), slot(s) {}
+
+    /**
+     * Move constructor
+     * @param[in] other - guard which becomes empty
+     */
+    guard_t(guard_t&& other) noexcept : owner(other.owner), slot(other.slot) {
+      other.owner = nullptr;
+    }
+
+    guard_t(guard_t const&) = delete;
+    guard_t& operator=(guard_t const&) = delete;
+    guard_t& operator=(guard_t&&) = delete;
+
+    /**
+     * Destructor, unpins the reader and reclaims what it has been holding back
+     */
+    ~guard_t();
+  };
+
+private:
+  /**
+   * @brief Reader slot on its own cache line
+   */
+  struct alignas(64) slot_t {
+    std::atomic<uint64_t> epoch{0};  ///< pinned epoch, 0 if the reader has not pinned yet
+    std::atomic<bool> used{false};   ///< true if the slot is taken by a reader
+  };
+
+  /**
+   * @brief Object waiting for the readers of its epoch
+   */
+  struct retired_t {
+    uint64_t epoch;                 ///< epoch when the object was unpublished
+    std::function<void()> deleter;  ///< deletes the object
+  };
+
+  std::atomic<uint64_t> global{1};    ///< current epoch
+  slot_t slots[maxReaders];           ///< reader slots
+  std::atomic<size_t> pending{0};     ///< number of retired objects
+  std::mutex m;                       ///< guard of retired
+  std::vector<retired_t> retired;     ///< retired objects
+
+  /**
+   * Delete retired objects whose readers have unpinned
+   * @warning m must be locked
+   */
+  void reclaim();
+
+public:
+  /**
+   * Default constructor
+   */
+  epoch_t() = default;
+
+  /**
+   * Pin the current epoch, objects published at this moment stay alive until the guard is destroyed
+   * @warning waits while all maxReaders slots are taken
+   * @return guard of the reader
+   */
+  guard_t pin() noexcept;
+
+  /**
+   * Delete the object when no reader can see it anymore
+   * @warning the object must be unpublished before the call
+   * @param[in] deleter - deletes the object
+   */
+  void retire(std::function<void()> deleter);
+
+  /**
+   * Delete retired objects whose readers have unpinned
+   * @return number of objects which are still waiting
+   */
+  size_t collect();
+
+  /**
+   * Destructor, deletes all retired objects
+   * @warning no reader may be pinned
+   */
+  ~epoch_t();
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <exception>
+#include <cstddef>
+
+/**
+ * @brief Possible errors of expression processing
+ */
+enum class calc_error_t {
+  NONE,                    ///< no error
+  SYNTAX,                  ///< operations lack operands or several results remain
+  BRACKETS,                ///< unpaired or mismatched brackets
+  UNEXPECTED_END,          ///< expression ends with an operation
+  UNEXPECTED_TOKEN,        ///< operand or operation in the wrong place
+  UNKNOWN_OPERATION,       ///< designation is not loaded from plugins
+  UNINITIALIZED_VARIABLE,  ///< variable has no value
+  DOMAIN,                  ///< operation got operands outside its domain
+  INCOMPATIBLE_PLUGINS,    ///< loaded plugins conflict with each other
+  BAD_INPUT,               ///< batch input does not match the program
+  NO_DERIVATIVE,           ///< operation has no derivative rule
+  STORAGE_LIMIT,           ///< new variable exceeds the limits of variable storage
+  INTERNAL                 ///< any other failure
+};
+
+/**
+ * Returns description of error
+ * @param[in] err - error code
+ * @return description of error
+ */
+inline char const* describe(calc_error_t err) noexcept {
+  switch (err) {
+    case calc_error_t::NONE:
+      return "No error";
+    case calc_error_t::SYNTAX:
+      return "Syntax error";
+    case calc_error_t::BRACKETS:
+      return "Error with brackets";
+    case calc_error_t::UNEXPECTED_END:
+      return "Unexpected end";
+    case calc_error_t::UNEXPECTED_TOKEN:
+      return "Unexpected token";
+    case calc_error_t::UNKNOWN_OPERATION:
+      return "Unknown operation";
+    case calc_error_t::UNINITIALIZED_VARIABLE:
+      return "Uninitialized variable";
+    case calc_error_t::DOMAIN:
+      return "Domain error";
+    case calc_error_t::INCOMPATIBLE_PLUGINS:
+      return "Incompatible plugins";
+    case calc_error_t::BAD_INPUT:
+      return "Bad input";
+    case calc_error_t::NO_DERIVATIVE:
+      return "No derivative rule";
+    case calc_error_t::STORAGE_LIMIT:
+      return "Variable storage is full";
+    default:
+      return "Internal error";
+  }
+}
+
+/**
+ * @brief Expected-style result of calculation
+ */
+struct calc_result_t {
+  double value = 0;                         ///< result if there is no error
+  calc_error_t error = calc_error_t::NONE;  ///< error code
+  size_t position = 0;                      ///< position in expression where the error was detected
+
+  /**
+   * Check the result
+   * @return true if there is no error
+   */
+  explicit operator bool() const noexcept {
+    return error == calc_error_t::NONE;
+  }
+};
+
+/**
+ * @brief Exception which carries error code and position in expression
+ */
+class calc_exception_t : public std::exception {
+public:
+  calc_error_t const code;  ///< error code
+  size_t const position;    ///< position in expression where the error was detected
+
+  /**
+   * Constructor
+   * param[in] err - error code
+   * param[in] pos - position in expression
+   * param[in] msg - message
+   */
+  calc_exception_t(calc_error_t err, size_t pos, char const* msg) : std::exception(msg), code(err), position(pos) {}
+
+  /**
+   * Constructor with default message
+   * param[in] err - error code
+   * param[in] pos - position in expression
+   */
+  calc_exception_t(calc_error_t err, size_t pos) : calc_exception_t(err, pos, describe(err)) {}
+};
@@ -1,41 +1,841 @@
 #pragma once
 
+#include <cmath>
+
 #include "loader.h"
 #include "scanner.h"
 #include "parser.h"
+#include "optimizer.h"
+#include "compiler.h"
+#include "peephole.h"
 #include "calc.h"
+#include "batch.h"
+#include "vm.h"
+#include "autodiff.h"
+#include "typed.h"
+#include "builder.h"
+#include "memo.h"
+#include "multi.h"
+#include "tiered.h"
+#include "trace.h"
+#include "profiler.h"
 
 /**
  * @brief Class of the string expression evaluator
  */
 class str_calc_t {
+public:
+  /**
+   * @brief Possible evaluators of expression
+   */
+  enum class backend_t {
+    BACKEND_TOKENS,   ///< interpreter of Reverse Polish Notation queue of tokens, conditionals run as compiled programs
+    BACKEND_STACK,    ///< compiled program on preallocated stack
+    BACKEND_REGISTER, ///< register machine with threaded dispatch, programs are cached by expression
+    BACKEND_TIERED    ///< programs cached by expression, hot ones are promoted to faster tiers in background
+  };
+
+  /**
+   * @brief Possible precisions of compiled program evaluation
+   */
+  enum class precision_t {
+    PRECISION_SINGLE,      ///< float
+    PRECISION_DOUBLE,      ///< double
+    PRECISION_COMPENSATED  ///< double with compensated arithmetic operations
+  };
+
 private:
-  loader_t l;             ///< Instance of class which can load operations and functions from plugins
+  /**
+   * @brief Programs of expression calculated by BACKEND_REGISTER
+   */
+  struct register_entry_t {
+    program_t prog;           ///< program of stack machine
+    vm_program_t vm;          ///< program of register machine
+    bool registers = false;   ///< the program runs on the register machine
+  };
+
+  static constexpr size_t registerCapacity = 1024;  ///< number of cached programs of BACKEND_REGISTER
+
+  std::shared_ptr<loader_t> l;  ///< Instance of class which can load operations and functions from plugins, may be shared
   scanner_t s;            ///< Instance of class which can transform string into queue of tokens
   parser_t p;             ///< Instance of class which can transform queue to Reverse Polish Notation queue
+  optimizer_t o;          ///< Instance of class which can rewrite Reverse Polish Notation queue into cheaper one
+  compiler_t k;           ///< Instance of class which can translate Reverse Polish Notation queue into verified program
+  peephole_t f;           ///< Instance of class which can fuse instructions of compiled program into superinstructions
   calculator_t c;         ///< Instance of class which can calculate by Reverse Polish Notation queue
-  vars_map v;             ///< Storage of variables created during calculations
+  batch_calculator_t b;   ///< Instance of class which can calculate compiled program for many rows
+  vm_compiler_t vc;       ///< Instance of class which can translate compiled program for register machine
+  vm_calculator_t vm;     ///< Instance of register machine
+  autodiff_t d;           ///< Instance of class which can calculate gradient of compiled program
+  reverse_autodiff_t rd;  ///< Instance of class which can calculate gradient by all variables with a tape
+  std::vector<double> g;  ///< Gradient of the last expression by slot
+  typed_calculator_t<float> cf;          ///< Instance of single precision evaluator
+  typed_calculator_t<compensated_t> cc;  ///< Instance of compensated precision evaluator
+  multi_compiler_t mk;    ///< Instance of class which can merge compiled programs sharing their subexpressions
+  multi_calculator_t mc;  ///< Instance of class which can calculate merged programs for many rows
+  tiered_calculator_t tc; ///< Instance of class which can cache programs and promote hot ones
+  std::unique_ptr<hot_profiler_t> hot;  ///< Top expressions by calls and time, nullptr if profiling is disabled
+  backend_t backend = backend_t::BACKEND_TOKENS;  ///< Evaluator of expressions
+  precision_t precision = precision_t::PRECISION_DOUBLE;  ///< Precision of compiled program evaluation
+  var_storage_t v;        ///< Storage of variables created during calculations
+  uint64_t closed = 0;    ///< Scopes of variables closed when the caches of programs were checked
+  std::map<std::string, register_entry_t> registered;  ///< Programs of BACKEND_REGISTER by string with expression
   bool dllsIsCompatible;  ///< True if the dll is compatible
+  uint64_t version = 0;   ///< Version of the registry whose operations are set
+
+  /**
+   * Switch to the published registry if it has changed since the last call
+   * @warning the caller must hold a guard from l->pin() while it uses the registry
+   * @return published registry
+   */
+  registry_t const& sync() {
+    registry_t const& r = l->registry();
+
+    if (r.version != version) {
+      version = r.version;
+      dllsIsCompatible = r.compatible;
+      tc.clear();
+      registered.clear();
+      c.setOperations(r.loadedOps);
+      o.setOperations(r.loadedOps);
+    }
+    return r;
+  }
+
+  /**
+   * Forget cached programs if some scope of variables has been closed since the last call,
+   * the programs may refer to variables whose names refer to new ones now
+   */
+  void forgetClosed() {
+    if (v.stats().closed != closed) {
+      closed = v.stats().closed;
+      tc.clear();
+      registered.clear();
+    }
+  }
+
+  /**
+   * Remove unused variables if the storage is full, tokens of the last expression no longer refer to them
+   */
+  void reclaim() {
+    if (v.full()) {
+      registered.clear();
+      v.collect();
+    }
+  }
+
+  /**
+   * Check if rpn queue has conditionals
+   * @param[in] rpnTokens - rpn queue
+   * @param[out] rpnTokens - the same queue
+   * @return true if some operation is a part of conditional
+   */
+  static bool hasConditionals(token_queue_t& rpnTokens) {
+    bool res = false;
+
+    // the queue is rotated once, so it is left in the same order
+    for (size_t k = rpnTokens.size(); k-- > 0;) {
+      std::unique_ptr<token_t> tok = std::move(rpnTokens.front());
+
+      rpnTokens.pop();
+      if (tok->type == token_t::token_type_t::TOKEN_TYPE_OPERATION) {
+        operation_t::operation_kind_t kind = static_cast<token_operation_t*>(tok.get())->operation->kind();
+
+        res = res || kind == operation_t::operation_kind_t::COND || kind == operation_t::operation_kind_t::SELECT;
+      }
+      rpnTokens.push(std::move(tok));
+    }
+    return res;
+  }
+
+  /**
+   * Translate program for the register machine
+   * @param[in] prog - compiled program
+   * @param[out] res - register machine program
+   * @return false if the program has conditionals or stateful functions or exceeds the registers of the machine,
+   * such programs run on the stack machine
+   */
+  bool toRegisters(program_t const& prog, vm_program_t& res) {
+    if (prog.branches || !prog.states.empty())
+      return false;
+
+    try {
+      res = vc.compile(prog);
+    }
+    catch (calc_exception_t&) {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Find programs of expression for BACKEND_REGISTER, the expression is compiled on its first calculation
+   * @warning throws calc_exception_t if string is incorrect
+   * @param[in] expression - string with expression
+   * @return programs of stack machine and register machine
+   */
+  register_entry_t& registerEntry(std::string const& expression) {
+    {
+      epoch_t::guard_t guard = l->pin();
+
+      sync();
+    }
+    forgetClosed();
+
+    auto ri = registered.find(expression);
+
+    if (ri != registered.end())
+      return ri->second;
+    if (registered.size() >= registerCapacity)
+      registered.clear();
+
+    register_entry_t e;
+
+    e.prog = compile(expression);
+    e.registers = toRegisters(e.prog, e.vm);
+    return registered.insert(std::make_pair(expression, std::move(e))).first->second;
+  }
+
+  /**
+   * Run calculation from string on the chosen backend in the chosen precision, calculate and tryCalculate
+   * differ only by how they report the error
+   * @warning throws calc_exception_t if string is incorrect, the token interpreter throws its errors as well
+   * @param[in] expression - string with expression
+   * @return result of calculation or error with its position
+   */
+  calc_result_t dispatch(std::string const& expression) {
+    calc_result_t res;
+
+    if (backend == backend_t::BACKEND_TOKENS) {
+      epoch_t::guard_t guard = l->pin();
+      registry_t const& r = sync();
+
+      if (!dllsIsCompatible)
+        throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+      reclaim();
+
+      token_queue_t& rpnTokens = o.optimize(p.parse(s.scan(expression, r.loadedOps, r.cv, v)));
+
+      // the rpn queue would evaluate both branches, only the compiled program skips the untaken one
+      if (hasConditionals(rpnTokens)) {
+        program_t prog = k.compile(rpnTokens);
+
+        return c.tryCalculate(prog);
+      }
+      res.value = c.calculate(rpnTokens);
+      return res;
+    }
+
+    // other precisions run the expression as BACKEND_STACK does
+    if (backend == backend_t::BACKEND_TIERED && precision == precision_t::PRECISION_DOUBLE) {
+      epoch_t::guard_t guard = l->pin();
+      registry_t const& r = sync();
+
+      if (!dllsIsCompatible)
+        throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+      reclaim();
+      forgetClosed();
+
+      // new expressions start without rewrites, the background compiler applies them when they get hot
+      return tc.calculate(expression, [&]() -> token_queue_t& {
+        return p.parse(s.scan(expression, r.loadedOps, r.cv, v));
+      }, v.map());
+    }
+
+    if (backend == backend_t::BACKEND_REGISTER && precision == precision_t::PRECISION_DOUBLE) {
+      register_entry_t& e = registerEntry(expression);
+      size_t slot;
+
+      // every string evaluation starts without history, as a new program does
+      e.prog.reset();
+      if (e.registers && e.prog.tryBind(slot))
+        return vm.run(e.vm);
+      return c.tryCalculate(e.prog);
+    }
+
+    program_t prog = compile(expression);
+
+    if (precision == precision_t::PRECISION_SINGLE)
+      return cf.tryCalculate(prog);
+    if (precision == precision_t::PRECISION_COMPENSATED)
+      return cc.tryCalculate(prog);
+    return c.tryCalculate(prog);
+  }
+
+  /**
+   * Find columns of variables of program
+   * @param[in] vars - variables of program by slot
+   * @param[in] columns - values of variables by name
+   * @param[in] rows - number of rows
+   * @param[out] slots - values of variables by slot, nullptr for variables without column
+   * @return false if some column has fewer values than rows
+   */
+  bool bindColumns(std::vector<std::shared_ptr<variable_t>> const& vars,
+                   std::map<std::string, std::vector<double>> const& columns, size_t rows,
+                   std::vector<double const*>& slots) const {
+    slots.assign(vars.size(), nullptr);
+    for (auto& col : columns) {
+      auto vi = v.find(col.first);
+
+      if (col.second.size() < rows)
+        return false;
+      if (vi == v.end())
+        continue;
+      for (size_t slot = 0; slot < vars.size(); ++slot)
+        if (vars[slot] == vi->second)
+          slots[slot] = col.second.data();
+    }
+    return true;
+  }
+
+  /**
+   * Calculate program for every row in the precision of evaluator
+   * @warning throws calc_exception_t if a variable without column is uninitialized
+   * @param[in] tc - evaluator of the precision
+   * @param[in] prog - compiled program
+   * @param[in] slots - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - results of rows rounded to double, NaN if the row has no result
+   * @param[out] validity - bitmap, bit (i % 64) of element i / 64 is set if row i has a result
+   * @return number of valid rows
+   */
+  template <typename number_t>
+  static size_t calculateTyped(typed_calculator_t<number_t>& tc, program_t& prog, std::vector<double const*> const& slots,
+                               size_t rows, std::vector<double>& results, std::vector<uint64_t>& validity) {
+    std::vector<std::vector<number_t>> values(slots.size());
+    std::vector<number_t const*> columns(slots.size(), nullptr);
+    std::vector<number_t> typed;
+    std::vector<size_t> faults;
+    size_t valid = 0;
+
+    // columns are converted once, not on every load of a block
+    for (size_t slot = 0; slot < slots.size(); ++slot) {
+      if (!slots[slot])
+        continue;
+      values[slot].reserve(rows);
+      for (size_t r = 0; r < rows; ++r)
+        values[slot].push_back(static_cast<number_t>(slots[slot][r]));
+      columns[slot] = values[slot].data();
+    }
+
+    tc.calculate(prog, columns, rows, typed, faults);
+    results.resize(rows);
+    validity.assign((rows + 63) / 64, 0);
+    for (size_t r = 0; r < rows; ++r) {
+      results[r] = static_cast<double>(typed[r]);
+      if (faults[r] == program_t::noFault) {
+        validity[r / 64] |= uint64_t(1) << (r % 64);
+        ++valid;
+      }
+    }
+    return valid;
+  }
+
+  /**
+   * Calculate program for every row in the chosen precision other than double
+   * @warning throws calc_exception_t if a variable without column is uninitialized
+   * @param[in] prog - compiled program
+   * @param[in] slots - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - results of rows rounded to double, NaN if the row has no result
+   * @param[out] validity - bitmap, bit (i % 64) of element i / 64 is set if row i has a result
+   * @return number of valid rows
+   */
+  size_t calculateTyped(program_t& prog, std::vector<double const*> const& slots, size_t rows,
+                        std::vector<double>& results, std::vector<uint64_t>& validity) {
+    if (precision == precision_t::PRECISION_SINGLE)
+      return calculateTyped(cf, prog, slots, rows, results, validity);
+    return calculateTyped(cc, prog, slots, rows, results, validity);
+  }
+
 public:
   /**
-   * Default constuctor
+   * Constuctor
+   * @param[in] loader - loader of plugins shared with other evaluators, a new one if omitted
+   */
+  str_calc_t(std::shared_ptr<loader_t> loader = std::make_shared<loader_t>()) : l(std::move(loader)), tc(l) {
+    epoch_t::guard_t guard = l->pin();
+
+    sync();
+  }
+
+  /**
+   * Returns loader of plugins to share it with other evaluators
+   * @return loader
+   */
+  std::shared_ptr<loader_t> const& loader() const noexcept {
+    return l;
+  }
+
+  /**
+   * Load plugins anew and publish them to all evaluators which share the loader, calculations
+   * which are running meanwhile finish with the old plugins
+   * @param[in] path - relative path to plugins directory. Default "plugins".
+   * @return false if the loaded items are incompatible, the current plugins stay then
+   */
+  bool reload(std::string const& path = "plugins") {
+    return l->reload(path);
+  }
+
+  /**
+   * Set rewrites which the optimizer is allowed to apply
+   * @param[in] options - allowed rewrites
    */
-  str_calc_t() {
-    dllsIsCompatible = l.checkLoadedElems();
-    c.setOperations(l.loadedOps);
+  void setOptimization(optimizer_t::options_t const& options) {
+    o.setOptions(options);
+    registered.clear();
+  }
+
+  /**
+   * Returns operation counts before and after optimization of the last expression
+   * @return statistics of the last optimization
+   */
+  optimizer_t::report_t const& optimizationReport() const noexcept {
+    return o.report();
+  }
+
+  /**
+   * Set rewrites which the instruction fusion is allowed to apply
+   * @param[in] options - allowed rewrites
+   */
+  void setFusion(peephole_t::options_t const& options) {
+    f.setOptions(options);
+    registered.clear();
+  }
+
+  /**
+   * Set profile which orders superinstructions by their usefulness on real workloads
+   * @param[in] profile - profile of real workloads, nullptr to use the static order
+   */
+  void setFusionProfile(peephole_t::profile_t const* profile) {
+    f.setProfile(profile);
+    registered.clear();
+  }
+
+  /**
+   * Returns dispatch counts before and after fusion of the last expression
+   * @return statistics of the last fusion
+   */
+  peephole_t::report_t const& fusionReport() const noexcept {
+    return f.report();
+  }
+
+  /**
+   * Turn memoization of pure function on or off, programs compiled earlier keep the previous behaviour
+   * @warning throws calc_exception_t if the function is unknown, not pure, variadic or takes too many arguments
+   * @param[in] name - name of function
+   * @param[in] on - true to memoize results
+   * @param[in] entries - number of cache entries
+   */
+  void setMemoization(std::string const& name, bool on, size_t entries = 4096) {
+    // the registry is immutable, so the change is published as its modified copy
+    l->update([&](registry_t& r) {
+      auto fi = r.loadedOps.funcs.find(name);
+
+      if (fi == r.loadedOps.funcs.end())
+        throw calc_exception_t(calc_error_t::UNKNOWN_OPERATION, 0, "Unknown function");
+
+      std::shared_ptr<function_t> func = fi->second;
+      memo_op_t* memo = dynamic_cast<memo_op_t*>(func.get());
+
+      if (memo)
+        func = memo->wrapped();
+      if (!func->isPure())
+        throw calc_exception_t(calc_error_t::BAD_INPUT, 0, "Function is not pure");
+      if (dynamic_cast<variadic_t*>(func.get()))
+        throw calc_exception_t(calc_error_t::BAD_INPUT, 0, "Variadic function can't be memoized");
+      if (on)
+        func = std::make_shared<memo_op_t>(func, entries);
+
+      r.loadedOps.funcs.erase(fi);
+      r.loadedOps.funcs.insert(std::make_pair(name, func));
+    });
+  }
+
+  /**
+   * Returns hit statistics of memoized functions
+   * @return statistics by name of function
+   */
+  std::map<std::string, memo_stats_t> memoizationStats() const {
+    std::map<std::string, memo_stats_t> res;
+    epoch_t::guard_t guard = l->pin();
+
+    for (auto& func : l->registry().loadedOps.funcs) {
+      memo_op_t const* memo = dynamic_cast<memo_op_t const*>(func.second.get());
+
+      if (memo)
+        res[func.first] = memo->stats();
+    }
+    return res;
+  }
+
+  /**
+   * Set thresholds of promotion and rewrites of the optimized tier for BACKEND_TIERED
+   * @param[in] options - thresholds and rewrites
+   */
+  void setTiering(tiered_calculator_t::options_t const& options) {
+    tc.setOptions(options);
+  }
+
+  /**
+   * Returns tiers, executions and compilation times of expressions calculated by BACKEND_TIERED
+   * @return statistics by string with expression
+   */
+  std::map<std::string, tiered_calculator_t::stats_t> tieringStats() const {
+    return tc.stats();
+  }
+
+  /**
+   * Set deduplication of rows with the same values of variables for calculateBatch
+   * @param[in] options - options of deduplication
+   */
+  void setBatching(batch_calculator_t::options_t const& options) noexcept {
+    b.setOptions(options);
+  }
+
+  /**
+   * Returns statistics of deduplication of rows by calculateBatch
+   * @return statistics, ratio() is the dedup ratio
+   */
+  batch_calculator_t::stats_t const& batchStats() const noexcept {
+    return b.stats();
+  }
+
+  /**
+   * Start or stop tracking of the expressions which dominate calls and evaluation time of calculate()
+   * @param[in] capacity - number of expressions tracked by calls and by time, 0 stops tracking and forgets them
+   */
+  void setProfiling(size_t capacity) {
+    hot = capacity ? std::make_unique<hot_profiler_t>(capacity) : nullptr;
+  }
+
+  /**
+   * Returns profiler of expressions
+   * @return profiler, nullptr if profiling is disabled
+   */
+  hot_profiler_t const* profiler() const noexcept {
+    return hot.get();
+  }
+
+  /**
+   * Choose evaluator of expressions
+   * @param[in] be - evaluator
+   */
+  void setBackend(backend_t be) noexcept {
+    backend = be;
+  }
+
+  /**
+   * Choose precision of compiled program evaluation, also of batches, the register machine is used only in double precision
+   * @param[in] pr - precision
+   */
+  void setPrecision(precision_t pr) noexcept {
+    precision = pr;
+  }
+
+  /**
+   * Set value of variable, the variable is created if it is unknown
+   * @warning throws calc_exception_t if the variable is unknown and the storage is full
+   * @param[in] name - name of variable
+   * @param[in] value - the value to be assigned
+   */
+  void setVariable(std::string const& name, double value) {
+    reclaim();
+    v.obtain(name)->setValue(value);
+  }
+
+  /**
+   * Open scope of variables, e.g. for a request
+   * @warning the scope must not outlive the calculator
+   * @return scope which removes the variables created meanwhile when it is closed or destroyed,
+   * compiled programs keep their variables alive but the names refer to new variables then
+   */
+  var_storage_t::scope_t openScope() {
+    return v.scope();
+  }
+
+  /**
+   * Set limits of variable storage, unknown names fail with STORAGE_LIMIT when the storage is full
+   * @param[in] limits - limits
+   */
+  void setVariableLimits(var_storage_t::limits_t const& limits) noexcept {
+    v.setLimits(limits);
+  }
+
+  /**
+   * Remove uninitialized variables which no compiled program refers to
+   * @return number of removed variables
+   */
+  size_t collectVariables() {
+    registered.clear();
+    return v.collect();
+  }
+
+  /**
+   * Returns counters of variable storage
+   * @return counters
+   */
+  var_stats_t const& variableStats() const noexcept {
+    return v.stats();
+  }
+
+  /**
+   * Compile expression from string
+   * @warning throws calc_exception_t if string is incorrect
+   * @param[in] expression - string with expression
+   * @return compiled program
+   */
+  program_t compile(std::string const& expression) {
+    epoch_t::guard_t guard = l->pin();
+    registry_t const& r = sync();
+
+    if (!dllsIsCompatible)
+      throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+    reclaim();
+
+    // operations of the program keep their plugins loaded after the guard is released
+    program_t prog = k.compile(o.optimize(p.parse(s.scan(expression, r.loadedOps, r.cv, v))));
+
+    f.fuse(prog);
+    return prog;
+  }
+
+  /**
+   * Compile expressions from strings into one program which computes their common subexpressions once
+   * @warning throws calc_exception_t if some string is incorrect or has conditionals or stateful functions
+   * @param[in] expressions - strings with expressions
+   * @return merged program
+   */
+  multi_program_t compile(std::vector<std::string> const& expressions) {
+    std::vector<program_t> progs;
+
+    for (auto const& expr : expressions)
+      progs.push_back(compile(expr));
+    return mk.compile(progs);
+  }
+
+  /**
+   * Bind variables of expression built by builder.h to the storage of calculator
+   * @warning the bound expression doesn't own its variables, close no scope which has created them meanwhile
+   * @param[in] expression - expression, e.g. var("x") * var("x") + sin(var("y"))
+   * @return expression which can be evaluated inline
+   */
+  template <typename expr_t, typename = std::enable_if_t<is_expr_v<expr_t>>>
+  expr_t bind(expr_t const& expression) {
+    return expression.bind(v);
+  }
+
+  /**
+   * Compile expression built by builder.h without scanning and parsing
+   * @warning throws calc_exception_t if some operation is not loaded from plugins
+   * @param[in] expression - expression, e.g. var("x") * var("x") + sin(var("y"))
+   * @return compiled program
+   */
+  template <typename expr_t, typename = std::enable_if_t<is_expr_v<expr_t>>>
+  program_t lower(expr_t const& expression) {
+    token_queue_t rpnTokens;
+    epoch_t::guard_t guard = l->pin();
+    registry_t const& r = sync();
+
+    if (!dllsIsCompatible)
+      throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+    reclaim();
+
+    expression.lower(r.loadedOps, v, rpnTokens);
+    program_t prog = k.compile(o.optimize(rpnTokens));
+
+    f.fuse(prog);
+    return prog;
   }
 
   /**
    * Run calculaton from string
-   * @warning can throw std::exception if string is incorrect
+   * @warning can throw std::exception if string is incorrect. Stateful functions start without history on every
+   * backend, so they take a single sample, calculate(program_t&) continues their history.
    * @param[in] expression - string with expression
    * @return result of calculation
    */
   double calculate(std::string const& expression) {
-    if (dllsIsCompatible)
-      return c.calculate(p.parse(s.scan(expression, l.loadedOps, l.cv, v)));
-    else
-      throw std::exception("Incompatible plugins");
+    trace_span_t span("calculate", "api");
+    hot_profiler_t::sample_t sample(hot.get(), expression);
+
+    calc_result_t res = dispatch(expression);
+
+    if (!res)
+      throw calc_exception_t(res.error, res.position);
+    return res.value;
+  }
+
+  /**
+   * Run calculation of compiled program with current values of variables, e.g. on every tick of time series
+   * @warning throws calc_exception_t if the program has uninitialized variables or domain error
+   * @param[in] prog - compiled program, its stateful functions continue their history
+   * @return result of calculation
+   */
+  double calculate(program_t& prog) {
+    return c.calculate(prog);
+  }
+
+  /**
+   * Run calculaton from string without throwing
+   * @param[in] expression - string with expression
+   * @return result of calculation or error with its position
+   */
+  calc_result_t tryCalculate(std::string const& expression) noexcept {
+    trace_span_t span("calculate", "api");
+    hot_profiler_t::sample_t sample(hot.get(), expression);
+    calc_result_t res;
+
+    // an incorrect expression costs one exception, the compiled evaluation itself never throws
+    try {
+      return dispatch(expression);
+    }
+    catch (calc_exception_t& e) {
+      res.error = e.code;
+      res.position = e.position;
+    }
+    catch (std::exception&) {
+      res.error = calc_error_t::INTERNAL;
+    }
+
+    return res;
+  }
+
+  /**
+   * Run calculation from string together with derivatives by variables in one pass
+   * @warning throws calc_exception_t if string is incorrect or some operation has no derivative rule
+   * @param[in] expression - string with expression
+   * @param[in] names - names of variables to differentiate by
+   * @param[out] grad - derivatives by variables in the order of names
+   * @return result of calculation
+   */
+  double gradient(std::string const& expression, std::vector<std::string> const& names, std::vector<double>& grad) {
+    program_t prog = compile(expression);
+    std::vector<variable_t const*> wrt;
+
+    for (auto& name : names) {
+      auto vi = v.find(name);
+
+      wrt.push_back(vi == v.end() ? nullptr : vi->second.get());
+    }
+    return d.calculate(prog, wrt, grad);
+  }
+
+  /**
+   * Run calculation from string together with derivatives by all known variables
+   * @warning throws calc_exception_t if string is incorrect or some operation has no derivative rule
+   * @param[in] expression - string with expression
+   * @param[out] grad - derivatives by every variable of storage, zero for variables absent in expression
+   * @return result of calculation
+   */
+  double gradient(std::string const& expression, std::map<std::string, double>& grad) {
+    program_t prog = compile(expression);
+    double res = rd.calculate(prog, g);
+
+    for (auto& var : v)
+      grad[var.first] = 0;
+    for (auto& var : v)
+      for (size_t slot = 0; slot < prog.vars.size(); ++slot)
+        if (prog.vars[slot] == var.second)
+          grad[var.first] = g[slot];
+    return res;
+  }
+
+  /**
+   * Run calculation from string for every row of variable values without throwing
+   * @param[in] expression - string with expression
+   * @param[in] columns - values of variables by name, variables without column keep their value
+   * @param[in] rows - number of rows, every column must have at least as many values
+   * @param[out] results - results of rows
+   * @param[out] validity - bitmap, bit (i % 64) of element i / 64 is set if row i has a result
+   * @return number of valid rows in value or error which prevents the whole calculation
+   */
+  calc_result_t calculateBatch(std::string const& expression, std::map<std::string, std::vector<double>> const& columns,
+                               size_t rows, std::vector<double>& results, std::vector<uint64_t>& validity) noexcept {
+    trace_span_t span("calculate batch", "api");
+    calc_result_t res;
+
+    try {
+      program_t prog = compile(expression);
+      std::vector<double const*> slots;
+
+      if (!bindColumns(prog.vars, columns, rows, slots)) {
+        res.error = calc_error_t::BAD_INPUT;
+        return res;
+      }
+      if (precision == precision_t::PRECISION_DOUBLE)
+        return b.calculate(prog, slots, rows, results, validity);
+
+      res.value = static_cast<double>(calculateTyped(prog, slots, rows, results, validity));
+      return res;
+    }
+    catch (calc_exception_t& e) {
+      res.error = e.code;
+      res.position = e.position;
+    }
+    catch (std::exception&) {
+      res.error = calc_error_t::INTERNAL;
+    }
+
+    return res;
+  }
+
+  /**
+   * Run calculation of several expressions from strings for every row of variable values in a single pass
+   * @param[in] expressions - strings with expressions
+   * @param[in] columns - values of variables by name, variables without column keep their value
+   * @param[in] rows - number of rows, every column must have at least as many values
+   * @param[out] results - result of expression k for row r at k * rows + r, NaN if the row has no result
+   * @return number of expressions in value or error which prevents the whole calculation,
+   * the value is the index of the expression which fails to compile then
+   * @warning expressions with conditionals or stateful functions can't be merged, the set fails as a whole
+   */
+  calc_result_t calculateBatch(std::vector<std::string> const& expressions,
+                               std::map<std::string, std::vector<double>> const& columns, size_t rows,
+                               std::vector<double>& results) noexcept {
+    calc_result_t res;
+    std::vector<program_t> progs;
+
+    try {
+      for (auto const& expr : expressions) {
+        res.value = static_cast<double>(progs.size());
+        progs.push_back(compile(expr));
+      }
+
+      res.value = 0;
+
+      multi_program_t prog = mk.compile(progs);
+      std::vector<double const*> slots;
+
+      if (!bindColumns(prog.vars, columns, rows, slots)) {
+        res.error = calc_error_t::BAD_INPUT;
+        return res;
+      }
+      if (precision == precision_t::PRECISION_DOUBLE)
+        mc.calculate(prog, slots, rows, results);
+      else {
+        std::vector<double> one;
+        std::vector<uint64_t> validity;
+
+        // the merged program runs in double only, so other precisions calculate the formulas apart
+        results.resize(progs.size() * rows);
+        for (size_t k = 0; k < progs.size(); ++k) {
+          bindColumns(progs[k].vars, columns, rows, slots);
+          calculateTyped(progs[k], slots, rows, one, validity);
+          std::copy(one.begin(), one.end(), results.begin() + k * rows);
+        }
+      }
+      res.value = static_cast<double>(prog.outputs);
+    }
+    catch (calc_exception_t& e) {
+      res.error = e.code;
+      res.position = e.position;
+    }
+    catch (std::exception&) {
+      res.error = calc_error_t::INTERNAL;
+    }
+
+    return res;
   }
 
   /**
@@ -1,34 +1,139 @@
+#include <type_traits>
 #include "loader.h"
+#include "trace.h"
+
+/**
+ * Class of variadic function whose call site operations keep the dll loaded
+ */
+class kept_variadic_t : public variadic_t {
+private:
+  std::shared_ptr<library_t> dll;     ///< dll of the function, destroyed after the function
+  std::shared_ptr<variadic_t> func;   ///< variadic function from the dll
+
+public:
+  /**
+   * Constructor
+   * @param[in] f - variadic function from the dll
+   * @param[in] d - dll of the function
+   */
+  kept_variadic_t(std::shared_ptr<variadic_t> f, std::shared_ptr<library_t> d) : dll(std::move(d)), func(std::move(f)) {}
+
+  /**
+   * Make operation for the call site
+   * @param[in] n - number of operands at the call site
+   * @return operation which takes n operands
+   */
+  std::shared_ptr<operation_t> bind(size_t n) override;
+
+  /**
+   * Returns purity of the function from the dll
+   * @return true if the function is pure
+   */
+  bool isPure() const noexcept override {
+    return func->isPure();
+  }
+};
+
+/**
+ * Share the ownership of the element with its dll, the element is destroyed before the dll is freed
+ * @param[in] elem - element created by the dll
+ * @param[in] dll - dll of the element
+ * @return pointer to the same element
+ */
+template <typename T>
+static std::shared_ptr<T> keep(std::shared_ptr<T> elem, std::shared_ptr<library_t> const& dll) {
+  struct holder_t {
+    std::shared_ptr<library_t> dll;  ///< destroyed last
+    std::shared_ptr<T> elem;         ///< destroyed first
+  };
+  auto holder = std::make_shared<holder_t>(holder_t{dll, std::move(elem)});
+
+  return std::shared_ptr<T>(holder, holder->elem.get());
+}
+
+/**
+ * Make operation for the call site
+ * @param[in] n - number of operands at the call site
+ * @return operation which takes n operands
+ */
+std::shared_ptr<operation_t> kept_variadic_t::bind(size_t n) {
+  return keep(func->bind(n), dll);
+}
+
+/**
+ * Add elements of one dll which are not loaded yet
+ * @param[in] from - elements loaded from the dll
+ * @param[in] dll - dll
+ * @param[out] to - elements of all dlls
+ */
+template <typename map_t>
+static void merge(map_t const& from, std::shared_ptr<library_t> const& dll, map_t& to) {
+  for (auto& elem : from) {
+    // operations which variadic functions make at call sites are kept by a wrapper
+    if constexpr (std::is_same_v<map_t, funcs_map>) {
+      if (auto var = std::dynamic_pointer_cast<variadic_t>(elem.second)) {
+        to.insert(std::make_pair(elem.first, std::make_shared<kept_variadic_t>(var, dll)));
+        continue;
+      }
+    }
+    to.insert(std::make_pair(elem.first, keep(elem.second, dll)));
+  }
+}
 
 /**
  * Constructor from path to directory
- * @param[in] path - relative path to plugins directory. Default "plugins".
+ * @param[in] path - relative path to plugins directory
  */
-loader_t::loader_t(std::string path) {
+registry_t::registry_t(std::string const& path) {
+  trace_span_t span("load plugins", "loader");
   HMODULE hdll = NULL;
 
   for (auto& dll : std::filesystem::directory_iterator(std::filesystem::current_path().string() + "\\" + path)) {
     if (dll.path().extension() == ".dll") {
+      trace_span_t dllSpan("load dll", "loader");
+
       hdll = LoadLibrary(dll.path().string().c_str());
       if (hdll) {
-        loadedDlls.push_back(hdll);
-
+        std::shared_ptr<library_t> lib = std::make_shared<library_t>(hdll);
         dllfuncp load = (dllfuncp)GetProcAddress(hdll, "load");
-        if (load)
-          load(loadedOps, cv);
+        abifuncp abi = (abifuncp)GetProcAddress(hdll, "abiVersion");
+
+        if (!load && !abi)
+          continue; // not a plugin
+
+        // a plugin built with other headers would make operations of other layout, it is freed unloaded
+        if (!load || !abi || abi() != pluginAbiVersion) {
+          abiMatches = false;
+          continue;
+        }
+
+        ops_maps ops;
+
+        // elements of the dll are loaded apart, so each of them refers to its dll
+        dlls.push_back(std::move(lib));
+        load(ops, cv);
+        merge(ops.funcs, dlls.back(), loadedOps.funcs);
+        merge(ops.pref, dlls.back(), loadedOps.pref);
+        merge(ops.inf, dlls.back(), loadedOps.inf);
+        merge(ops.postf, dlls.back(), loadedOps.postf);
       }
     }
   }
+  compatible = checkLoadedElems();
 }
 
 /**
  * Method that checks the loaded elements for compatibility
  * @return true if the loaded items are compatible
  */
-bool loader_t::checkLoadedElems() {
+bool registry_t::checkLoadedElems() const {
+  // plugins of other version are not loaded, the rest may lack operations
+  if (!abiMatches)
+    return false;
+
   auto fi = loadedOps.funcs.begin();
   auto ci = cv.begin();
-  
+
   // checking function and constant names
   while (fi != loadedOps.funcs.end() && ci != cv.end()) {
     if (fi->first > ci->first)
@@ -55,15 +160,84 @@ bool loader_t::checkLoadedElems() {
   return true;
 }
 
+/**
+ * Constructor from path to directory
+ * @param[in] path - relative path to plugins directory. Default "plugins".
+ */
+loader_t::loader_t(std::string path) {
+  registry_t* reg = new registry_t(path);
+
+  reg->version = ++versions;
+  current.store(reg);
+}
+
+/**
+ * Publish new registry, running evaluators switch to it on their next call
+ * @param[in] reg - registry, loaded or copied from the current one
+ * @return false if the loaded items are incompatible, the current registry stays then
+ */
+bool loader_t::publish(std::unique_ptr<registry_t> reg) {
+  if (!reg->checkLoadedElems())
+    return false;
+
+  std::lock_guard<std::mutex> lock(writer);
+
+  swap(std::move(reg));
+  return true;
+}
+
+/**
+ * Publish a modified copy of the current registry, publications are serialized
+ * @param[in] change - modification of the copy, may throw to cancel the publication
+ * @return false if the modified items are incompatible, the current registry stays then
+ */
+bool loader_t::update(std::function<void(registry_t&)> const& change) {
+  std::lock_guard<std::mutex> lock(writer);
+  std::unique_ptr<registry_t> reg(new registry_t(*current.load()));
+
+  change(*reg);
+  if (!reg->checkLoadedElems())
+    return false;
+  swap(std::move(reg));
+  return true;
+}
+
+/**
+ * Publish new registry
+ * @warning writer must be locked
+ * @param[in] reg - compatible registry
+ */
+void loader_t::swap(std::unique_ptr<registry_t> reg) {
+  reg->version = ++versions;
+  reg->compatible = true;
+
+  // readers which have loaded the old registry keep it until they unpin
+  registry_t const* old = current.exchange(reg.release(), std::memory_order_seq_cst);
+  epochs.retire([old]() { delete old; });
+}
+
+/**
+ * Load plugins anew and publish them
+ * @param[in] path - relative path to plugins directory. Default "plugins".
+ * @return false if the loaded items are incompatible, the current registry stays then
+ */
+bool loader_t::reload(std::string const& path) {
+  return publish(std::unique_ptr<registry_t>(new registry_t(path)));
+}
+
+/**
+ * Method that checks the published elements for compatibility
+ * @return true if the loaded items are compatible
+ */
+bool loader_t::checkLoadedElems() {
+  epoch_t::guard_t guard = pin();
+
+  return registry().compatible;
+}
+
 /**
  * Destructor
  */
 loader_t::~loader_t() {
-  loadedOps.funcs.clear();
-  loadedOps.inf.clear();
-  loadedOps.pref.clear();
-  loadedOps.postf.clear();
-
-  for (auto& dll : loadedDlls)
-    FreeLibrary(dll);
-}
\ No newline at end of file
+  delete current.load();
+}
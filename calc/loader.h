@@ -1,10 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <mutex>
 #include <filesystem>
 #include <windows.h>
 #include "include/operation.h"
 #include "include/variable.h"
+#include "epoch.h"
 
 /**
  * The type of pointer to a function that adds elements from a dll
@@ -12,15 +14,105 @@
 using dllfuncp = void (*)(ops_maps&, cv_map&);
 
 /**
- * Class that loads elements from dlls
+ * The type of pointer to a function that returns the version of plugin interface of a dll
  */
-class loader_t {
+using abifuncp = unsigned (*)();
+
+/**
+ * Class that owns a loaded dll, the dll is freed with the last operation which refers to it
+ */
+class library_t {
 private:
-  std::vector<HMODULE> loadedDlls;   ///< loaded dlls we want to free after session
+  HMODULE hdll;  ///< loaded dll
+
+public:
+  /**
+   * Constructor
+   * @param[in] h - loaded dll
+   */
+  library_t(HMODULE h) : hdll(h) {}
+
+  library_t(library_t const&) = delete;
+  library_t& operator=(library_t const&) = delete;
+
+  /**
+   * Returns loaded dll
+   * @return dll
+   */
+  HMODULE handle() const noexcept {
+    return hdll;
+  }
+
+  /**
+   * Destructor
+   */
+  ~library_t() {
+    FreeLibrary(hdll);
+  }
+};
+
+/**
+ * Class of immutable set of elements loaded from dlls
+ * @warning every operation keeps its dll loaded, so compiled programs outlive the registry safely
+ */
+class registry_t {
 public:
-  ops_maps loadedOps;                ///< operators and function loaded from all plugins 
-  cv_map cv;                         ///< const value (like pi or e) loaded from all plugins
+  ops_maps loadedOps;                              ///< operators and function loaded from all plugins
+  cv_map cv;                                       ///< const value (like pi or e) loaded from all plugins
+  std::vector<std::shared_ptr<library_t>> dlls;    ///< loaded dlls
+  uint64_t version = 0;                            ///< number of publication, set by loader_t
+  bool compatible = true;                          ///< result of checkLoadedElems
+  bool abiMatches = true;                          ///< every plugin has pluginAbiVersion, others are not loaded
+
+  /**
+   * Default constructor
+   */
+  registry_t() = default;
 
+  /**
+   * Constructor from path to directory
+   * @param[in] path - relative path to plugins directory
+   */
+  registry_t(std::string const& path);
+
+  /**
+   * Copy constructor for a modified registry, dlls are shared
+   * @param[in] other - registry
+   */
+  registry_t(registry_t const& other) = default;
+
+  /**
+   * Method that checks the loaded elements for compatibility
+   * @return true if the loaded items are compatible
+   */
+  bool checkLoadedElems() const;
+
+  /**
+   * Destructor
+   */
+  ~registry_t() = default;
+};
+
+/**
+ * Class that loads elements from dlls and publishes them to evaluators
+ * @warning readers pin an epoch and use registry() without locks, reload and publish swap
+ * the registry atomically and the old one is deleted after all its readers have unpinned
+ */
+class loader_t {
+private:
+  epoch_t epochs;                              ///< reclamation of unpublished registries
+  std::atomic<registry_t const*> current;      ///< published registry
+  std::mutex writer;                           ///< serializes publications
+  uint64_t versions = 0;                       ///< number of publications
+
+  /**
+   * Publish new registry
+   * @warning writer must be locked
+   * @param[in] reg - compatible registry
+   */
+  void swap(std::unique_ptr<registry_t> reg);
+
+public:
   /**
    * Constructor from path to directory
    * @param[in] path - relative path to plugins directory. Default "plugins".
@@ -28,13 +120,60 @@ public:
   loader_t(std::string path = "plugins");
 
   /**
-   * Method that checks the loaded elements for compatibility
+   * Pin the current epoch before calling registry()
+   * @return guard which keeps the registry alive
+   */
+  epoch_t::guard_t pin() noexcept {
+    return epochs.pin();
+  }
+
+  /**
+   * Returns published registry
+   * @warning the caller must hold a guard from pin() while it uses the registry
+   * @return registry
+   */
+  registry_t const& registry() const noexcept {
+    return *current.load(std::memory_order_seq_cst);
+  }
+
+  /**
+   * Publish new registry, running evaluators switch to it on their next call
+   * @param[in] reg - registry, loaded or copied from the current one
+   * @return false if the loaded items are incompatible, the current registry stays then
+   */
+  bool publish(std::unique_ptr<registry_t> reg);
+
+  /**
+   * Publish a modified copy of the current registry, publications are serialized
+   * @param[in] change - modification of the copy, may throw to cancel the publication
+   * @return false if the modified items are incompatible, the current registry stays then
+   */
+  bool update(std::function<void(registry_t&)> const& change);
+
+  /**
+   * Load plugins anew and publish them
+   * @param[in] path - relative path to plugins directory. Default "plugins".
+   * @return false if the loaded items are incompatible, the current registry stays then
+   */
+  bool reload(std::string const& path = "plugins");
+
+  /**
+   * Method that checks the published elements for compatibility
    * @return true if the loaded items are compatible
    */
   bool checkLoadedElems();
 
+  /**
+   * Delete unpublished registries whose readers have finished
+   * @return number of registries which are still in use
+   */
+  size_t collect() {
+    return epochs.collect();
+  }
+
   /**
    * Destructor
+   * @warning no reader may be pinned
    */
   ~loader_t();
-};
\ No newline at end of file
+};
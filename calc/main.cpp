@@ -6,6 +6,8 @@ int main(int argc, char* argv[]) {
   str_calc_t calc;
   std::string string;
 
+  calc.setProfiling(64);
+
   while (true) {
     size_t i = 0;
     size_t len;
@@ -29,6 +31,16 @@ int main(int argc, char* argv[]) {
       continue;
     }
 
+    // report of the most called and the slowest expressions
+    if (string.compare(i, std::string::npos, ":hot") == 0) {
+      calc.profiler()->write(std::cout, 10);
+      continue;
+    }
+    if (string.compare(i, std::string::npos, ":hot json") == 0) {
+      calc.profiler()->writeJson(std::cout, 10);
+      continue;
+    }
+
     std::cout << string + "  ==  ";
 
     try {
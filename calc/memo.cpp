@@ -0,0 +1,184 @@
+#include <cmath>
+#include <cstring>
+#include "memo.h"
+#include "error.h"
+
+/**
+ * Returns bit pattern of number
+ * @param[in] x - number
+ * @return bit pattern
+ */
+static uint64_t toBits(double x) noexcept {
+  uint64_t bits;
+
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+/**
+ * Constructor
+ * @param[in] n - number of arguments, at most maxArity
+ * @param[in] size - number of entries, rounded up to a power of two
+ */
+memo_cache_t::memo_cache_t(size_t n, size_t size) : arity(n) {
+  size_t s = 1;
+
+  if (n > maxArity)
+    throw calc_exception_t(calc_error_t::BAD_INPUT, 0, "Too many arguments to memoize");
+  while (s < size)
+    s <<= 1;
+  entries.reset(new entry_t[s]);
+  mask = s - 1;
+}
+
+/**
+ * Returns entry index of arguments
+ * @param[in] bits - bit patterns of arguments
+ * @return index of entry
+ */
+size_t memo_cache_t::index(uint64_t const* bits) const noexcept {
+  uint64_t h = 0;
+
+  for (size_t k = 0; k < arity; ++k)
+    h = (h ^ bits[k]) * 0x9E3779B97F4A7C15ULL;
+
+  // quantized inputs differ only in high bits of mantissa and exponent, so they are mixed into low bits
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return static_cast<size_t>(h) & mask;
+}
+
+/**
+ * Look for the result of function
+ * @param[in] args - arguments
+ * @param[out] res - cached result
+ * @return true if the result is found
+ */
+bool memo_cache_t::find(double const* args, double& res) noexcept {
+  uint64_t bits[maxArity];
+
+  for (size_t k = 0; k < arity; ++k)
+    bits[k] = toBits(args[k]);
+
+  entry_t& e = entries[index(bits)];
+  uint32_t seq = e.seq.load(std::memory_order_acquire);
+  bool found = seq != 0 && (seq & 1) == 0;
+
+  for (size_t k = 0; found && k < arity; ++k)
+    found = e.key[k].load(std::memory_order_relaxed) == bits[k];
+  uint64_t value = e.value.load(std::memory_order_relaxed);
+
+  // the entry is valid only if no writer has touched it while it was read
+  std::atomic_thread_fence(std::memory_order_acquire);
+  found = found && e.seq.load(std::memory_order_relaxed) == seq;
+
+  if (!found) {
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  hits.fetch_add(1, std::memory_order_relaxed);
+  std::memcpy(&res, &value, sizeof(res));
+  return true;
+}
+
+/**
+ * Store the result of function
+ * @param[in] args - arguments
+ * @param[in] res - result
+ */
+void memo_cache_t::store(double const* args, double res) noexcept {
+  uint64_t bits[maxArity];
+
+  for (size_t k = 0; k < arity; ++k)
+    bits[k] = toBits(args[k]);
+
+  entry_t& e = entries[index(bits)];
+  uint32_t seq = e.seq.load(std::memory_order_relaxed);
+
+  if ((seq & 1) != 0 || !e.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+    return; // another writer holds the entry, the result is just not cached
+
+  // readers which see the new key or value must also see the odd sequence number
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t k = 0; k < arity; ++k)
+    e.key[k].store(bits[k], std::memory_order_relaxed);
+  e.value.store(toBits(res), std::memory_order_relaxed);
+  e.seq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * Constructor
+ * @param[in] f - pure function of at most memo_cache_t::maxArity arguments
+ * @param[in] size - number of cache entries
+ */
+memo_op_t::memo_op_t(std::shared_ptr<function_t> f, size_t size) : func(std::move(f)), cache(func->arity(), size) {
+}
+
+/**
+ * Performs operand processing, results which are not cached or are NaN come from the wrapped function,
+ * so it throws the same errors as the wrapped function
+ * param[in] stack - stack of operands
+ */
+void memo_op_t::process(token_stack_t& stack) {
+  double args[memo_cache_t::maxArity];
+  size_t n = arity();
+  double res;
+
+  for (size_t k = n; k-- > 0;)
+    args[k] = getNumber(stack);
+  // evaluate caches NaN for operands outside of the domain, where process of the function throws
+  if (cache.find(args, res) && !std::isnan(res)) {
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(res)));
+    return;
+  }
+
+  for (size_t k = 0; k < n; ++k)
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(args[k])));
+  func->process(stack);
+  cache.store(args, static_cast<token_number_t*>(stack.top().get())->value);
+}
+
+/**
+ * Performs computation on already extracted operands, looks into the cache first
+ * param[in] args - arity() operands from left to right
+ * @return result of function
+ */
+double memo_op_t::evaluate(double const* args) {
+  double res;
+
+  if (!cache.find(args, res)) {
+    res = func->evaluate(args);
+    cache.store(args, res);
+  }
+  return res;
+}
+
+/**
+ * Performs computation on blocks of single precision operands by the wrapped function
+ * param[in] args - arity() arrays of n operands
+ * param[out] res - n results
+ * param[in] n - number of elements in each array
+ */
+void memo_op_t::evaluateBlock(float const* const* args, float* res, size_t n) {
+  func->evaluateBlock(args, res, n);
+}
+
+/**
+ * Performs computation on blocks of operands, looks into the cache for every element
+ * param[in] args - arity() arrays of n operands
+ * param[out] res - n results
+ * param[in] n - number of elements in each array
+ */
+void memo_op_t::evaluateBlock(double const* const* args, double* res, size_t n) {
+  double a[memo_cache_t::maxArity];
+  size_t ar = arity();
+
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t k = 0; k < ar; ++k)
+      a[k] = args[k][i];
+    res[i] = evaluate(a);
+  }
+}
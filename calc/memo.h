@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "include/operation.h"
+
+/**
+ * @brief Hit statistics of memoization cache
+ */
+struct memo_stats_t {
+  uint64_t hits = 0;    ///< calls answered from the cache
+  uint64_t misses = 0;  ///< calls which evaluated the function
+
+  /**
+   * Returns share of calls answered from the cache
+   * @return hit rate in [0, 1]
+   */
+  double hitRate() const noexcept {
+    return hits + misses == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+  }
+};
+
+/**
+ * @brief Fixed-size direct-mapped cache of function results keyed by bit patterns of arguments
+ * @warning lock-free: readers never wait, a writer skips the entry if another writer holds it
+ */
+class memo_cache_t {
+public:
+  static constexpr size_t maxArity = 4;  ///< largest number of arguments which fits into an entry
+
+private:
+  /**
+   * @brief Entry of the cache guarded by sequence number, odd while being written
+   */
+  struct entry_t {
+    std::atomic<uint32_t> seq{0};                 ///< sequence number, 0 for empty entry
+    std::atomic<uint64_t> key[maxArity] = {};     ///< bit patterns of arguments
+    std::atomic<uint64_t> value{0};               ///< bit pattern of result
+  };
+
+  std::unique_ptr<entry_t[]> entries;  ///< entries
+  size_t mask;                         ///< number of entries minus one
+  size_t arity;                        ///< number of arguments of function
+  std::atomic<uint64_t> hits{0};       ///< calls answered from the cache
+  std::atomic<uint64_t> misses{0};     ///< calls which evaluated the function
+
+  /**
+   * Returns entry index of arguments
+   * @param[in] bits - bit patterns of arguments
+   * @return index of entry
+   */
+  size_t index(uint64_t const* bits) const noexcept;
+
+public:
+  /**
+   * Constructor
+   * @param[in] n - number of arguments, at most maxArity
+   * @param[in] size - number of entries, rounded up to a power of two
+   */
+  memo_cache_t(size_t n, size_t size);
+
+  /**
+   * Look for the result of function
+   * @param[in] args - arguments
+   * @param[out] res - cached result
+   * @return true if the result is found
+   */
+  bool find(double const* args, double& res) noexcept;
+
+  /**
+   * Store the result of function
+   * @param[in] args - arguments
+   * @param[in] res - result
+   */
+  void store(double const* args, double res) noexcept;
+
+  /**
+   * Returns hit statistics
+   * @return statistics
+   */
+  memo_stats_t stats() const noexcept {
+    memo_stats_t s;
+
+    s.hits = hits.load(std::memory_order_relaxed);
+    s.misses = misses.load(std::memory_order_relaxed);
+    return s;
+  }
+};
+
+/**
+ * @brief Pure function whose results are memoized
+ * @warning the result never differs from the wrapped function: keys are exact bit patterns of arguments
+ */
+class memo_op_t : public function_t {
+private:
+  std::shared_ptr<function_t> func;  ///< wrapped function
+  memo_cache_t cache;                ///< cache of results
+
+public:
+  /**
+   * Constructor
+   * @param[in] f - pure function of at most memo_cache_t::maxArity arguments
+   * @param[in] size - number of cache entries
+   */
+  memo_op_t(std::shared_ptr<function_t> f, size_t size);
+
+  /**
+   * Returns the wrapped function
+   * @return function
+   */
+  std::shared_ptr<function_t> const& wrapped() const noexcept {
+    return func;
+  }
+
+  /**
+   * Returns hit statistics
+   * @return statistics
+   */
+  memo_stats_t stats() const noexcept {
+    return cache.stats();
+  }
+
+  /**
+   * Performs operand processing, results which are not cached or are NaN come from the wrapped function,
+   * so it throws the same errors as the wrapped function
+   * param[in] stack - stack of operands
+   */
+  void process(token_stack_t& stack) override;
+
+  /**
+   * Performs computation on already extracted operands, looks into the cache first
+   * param[in] args - arity() operands from left to right
+   * @return result of function
+   */
+  double evaluate(double const* args) override;
+
+  /**
+   * Performs computation on blocks of single precision operands by the wrapped function
+   * param[in] args - arity() arrays of n operands
+   * param[out] res - n results
+   * param[in] n - number of elements in each array
+   */
+  void evaluateBlock(float const* const* args, float* res, size_t n) override;
+
+  /**
+   * Performs computation on blocks of operands, looks into the cache for every element
+   * param[in] args - arity() arrays of n operands
+   * param[out] res - n results
+   * param[in] n - number of elements in each array
+   */
+  void evaluateBlock(double const* const* args, double* res, size_t n) override;
+
+  /**
+   * Returns the number of operands of the wrapped function
+   * @return number of operands
+   */
+  size_t arity() const noexcept override {
+    return func->arity();
+  }
+
+  /**
+   * Returns the semantics of the wrapped function
+   * @return semantics
+   */
+  operation_kind_t kind() const noexcept override {
+    return func->kind();
+  }
+
+  /**
+   * Returns true
+   * @return true
+   */
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  /**
+   * Returns true if the wrapped function restricts its domain
+   * @return true if evaluators must check operands
+   */
+  bool hasDomain() const noexcept override {
+    return func->hasDomain();
+  }
+
+  /**
+   * Check operands against the domain of the wrapped function
+   * param[in] args - arity() operands from left to right
+   * @return false if the wrapped function is not defined for the operands
+   */
+  bool inDomain(double const* args) const noexcept override {
+    return func->inDomain(args);
+  }
+
+  /**
+   * Computes partial derivatives by the wrapped function
+   * param[in] args - arity() operands from left to right
+   * param[out] partials - arity() derivatives of the result by operands
+   * @return false if the wrapped function has no derivative rule
+   */
+  bool derivative(double const* args, double* partials) override {
+    return func->derivative(args, partials);
+  }
+};
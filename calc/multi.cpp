@@ -0,0 +1,265 @@
+#include <cstring>
+#include <algorithm>
+#include "multi.h"
+
+/**
+ * Find or create the node of instruction
+ * @warning calls of operations which are not pure get a node of their own, so they are never shared
+ * @param[in] in - instruction, variable slot refers to multi_program_t::vars
+ * @param[in] args - operand nodes
+ * @return node index
+ */
+size_t multi_compiler_t::number(instr_t const& in, std::vector<size_t> args) {
+  std::vector<uint64_t> key(2);
+
+  key[0] = static_cast<uint64_t>(in.code);
+  switch (in.code) {
+    case instr_t::opcode_t::PUSH_NUMBER:
+      std::memcpy(&key[1], &in.value, sizeof(double)); // bit patterns keep 0 and -0 apart
+      break;
+    case instr_t::opcode_t::PUSH_VARIABLE:
+      key[1] = in.slot;
+      break;
+    default:
+      key[1] = reinterpret_cast<uintptr_t>(in.operation);
+      break;
+  }
+  key.insert(key.end(), args.begin(), args.end());
+
+  // well known arithmetic operations are pure even if they don't declare it
+  bool shared = in.code != instr_t::opcode_t::CALL || in.operation->isPure() ||
+    in.operation->kind() != operation_t::operation_kind_t::GENERIC;
+  auto ni = numbers.find(key);
+
+  if (shared && ni != numbers.end())
+    return ni->second;
+
+  node_t node;
+
+  node.instr = in;
+  node.args = std::move(args);
+  for (size_t a : node.args)
+    ++nodes[a].uses;
+  nodes.push_back(std::move(node));
+  if (shared)
+    numbers.emplace(std::move(key), nodes.size() - 1);
+  return nodes.size() - 1;
+}
+
+/**
+ * Emit instructions of the node
+ * @param[in] n - node index
+ * @param[in] depth - depth of stack before the node
+ * @param[out] res - program
+ */
+void multi_compiler_t::emit(size_t n, size_t depth, multi_program_t& res) {
+  node_t& node = nodes[n];
+  instr_t in;
+
+  res.maxDepth = std::max(res.maxDepth, depth + 1);
+  if (node.temp != npos) {
+    in.code = instr_t::opcode_t::LOAD;
+    in.slot = node.temp;
+    in.pos = node.instr.pos;
+    res.code.push_back(in);
+    return;
+  }
+
+  for (size_t k = 0; k < node.args.size(); ++k)
+    emit(node.args[k], depth + k, res);
+  res.code.push_back(node.instr);
+  if (node.instr.code != instr_t::opcode_t::CALL)
+    return;
+  ++res.calls;
+
+  // numbers and variables are pushed again, operations are computed only once
+  if (node.uses > 1) {
+    node.temp = res.temps++;
+    in.code = instr_t::opcode_t::STORE;
+    in.slot = node.temp;
+    in.pos = node.instr.pos;
+    res.code.push_back(in);
+  }
+}
+
+/**
+ * Merge compiled programs
+ * @warning throws calc_exception_t if a program has conditionals or stateful functions
+ * @param[in] formulas - compiled programs
+ * @return program which writes result of formula k to output k
+ */
+multi_program_t multi_compiler_t::compile(std::vector<program_t> const& formulas) {
+  multi_program_t res;
+  std::vector<size_t> roots;
+  std::vector<size_t> stack;
+
+  nodes.clear();
+  numbers.clear();
+
+  for (program_t const& prog : formulas) {
+    if (prog.branches || !prog.states.empty())
+      throw calc_exception_t(calc_error_t::BAD_INPUT, prog.code.front().pos,
+                             "Conditionals and stateful functions are not supported in formula sets");
+
+    // value numbering of the stack program, the compiler has verified its stack usage
+    stack.clear();
+    for (instr_t in : prog.code) {
+      std::vector<size_t> args;
+
+      switch (in.code) {
+        case instr_t::opcode_t::PUSH_NUMBER:
+          break;
+        case instr_t::opcode_t::PUSH_VARIABLE:
+        {
+          std::shared_ptr<variable_t> const& var = prog.vars[in.slot];
+          auto vi = std::find(res.vars.begin(), res.vars.end(), var);
+
+          in.slot = vi - res.vars.begin();
+          if (vi == res.vars.end())
+            res.vars.push_back(var);
+          break;
+        }
+        default:
+          args.assign(stack.end() - in.arity, stack.end());
+          stack.resize(stack.size() - in.arity);
+          ++res.separateCalls;
+          break;
+      }
+      stack.push_back(number(in, std::move(args)));
+    }
+    roots.push_back(stack.back());
+    ++nodes[stack.back()].uses;
+
+    for (auto const& op : prog.ops)
+      if (std::find(res.ops.begin(), res.ops.end(), op) == res.ops.end())
+        res.ops.push_back(op);
+  }
+
+  for (size_t k = 0; k < roots.size(); ++k) {
+    instr_t out;
+
+    emit(roots[k], 0, res);
+    out.code = instr_t::opcode_t::OUTPUT;
+    out.slot = k;
+    res.code.push_back(out);
+  }
+  res.outputs = roots.size();
+  return res;
+}
+
+/**
+ * Mark rows of the operation result which depend on a domain error
+ * @param[in] in - CALL instruction
+ * @param[in] top - first operand array, others follow with blockSize stride
+ * @param[in] depth - stack depth of the first operand
+ * @param[in] n - number of rows
+ */
+void multi_calculator_t::poison(instr_t const& in, double const* top, size_t depth, size_t n) {
+  uint8_t* b = bad.data() + depth * blockSize;
+
+  if (in.arity == 0)
+    std::fill(b, b + n, uint8_t(0));
+  for (size_t k = 1; k < in.arity; ++k)
+    for (size_t r = 0; r < n; ++r)
+      b[r] |= b[k * blockSize + r];
+  if (!in.checked)
+    return;
+  operands.resize(in.arity);
+  for (size_t r = 0; r < n; ++r) {
+    if (b[r])
+      continue;
+    for (size_t k = 0; k < in.arity; ++k)
+      operands[k] = top[k * blockSize + r];
+    b[r] = in.operation->inDomain(operands.data()) ? 0 : 1;
+  }
+}
+
+/**
+ * Calculate all formulas for every row
+ * @warning throws calc_exception_t if a variable without column is uninitialized,
+ * operations which don't override evaluateBlock may throw std::exception
+ * @param[in] prog - merged program
+ * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+ * @param[in] rows - number of rows
+ * @param[out] results - result of formula k for row r at k * rows + r, NaN if the formula has domain error
+ */
+void multi_calculator_t::calculate(multi_program_t const& prog, std::vector<double const*> const& columns,
+                                   size_t rows, std::vector<double>& results) {
+  size_t maxArity = 0;
+  bool checked = false;
+
+  for (size_t slot = 0; slot < prog.vars.size(); ++slot)
+    if (!columns[slot] && !prog.vars[slot]->isInit())
+      throw calc_exception_t(calc_error_t::UNINITIALIZED_VARIABLE, 0, "Uninitialized variable");
+  for (instr_t const& in : prog.code) {
+    maxArity = std::max(maxArity, in.arity);
+    checked = checked || in.checked;
+  }
+
+  stack.resize(prog.maxDepth * blockSize);
+  temps.resize(prog.temps * blockSize);
+  args.resize(maxArity);
+  results.resize(prog.outputs * rows);
+  // a domain error spoils only the formulas whose values depend on it, the rows are tracked only if it may happen
+  if (checked) {
+    bad.assign(prog.maxDepth * blockSize, 0);
+    badTemps.assign(prog.temps * blockSize, 0);
+  }
+
+  // every instruction is applied to the whole block, all formulas are done before the next block
+  for (size_t first = 0; first < rows; first += blockSize) {
+    size_t n = std::min(blockSize, rows - first);
+    size_t depth = 0;
+
+    for (instr_t const& in : prog.code) {
+      double* top = stack.data() + depth * blockSize;
+      uint8_t* b = checked ? bad.data() + depth * blockSize : nullptr;
+
+      switch (in.code) {
+        case instr_t::opcode_t::PUSH_NUMBER:
+          std::fill(top, top + n, in.value);
+          if (checked)
+            std::fill(b, b + n, uint8_t(0));
+          ++depth;
+          break;
+        case instr_t::opcode_t::PUSH_VARIABLE:
+          if (columns[in.slot])
+            std::copy(columns[in.slot] + first, columns[in.slot] + first + n, top);
+          else
+            std::fill(top, top + n, prog.vars[in.slot]->getValue());
+          if (checked)
+            std::fill(b, b + n, uint8_t(0));
+          ++depth;
+          break;
+        case instr_t::opcode_t::STORE:
+          std::copy(top - blockSize, top - blockSize + n, temps.data() + in.slot * blockSize);
+          if (checked)
+            std::copy(b - blockSize, b - blockSize + n, badTemps.data() + in.slot * blockSize);
+          break;
+        case instr_t::opcode_t::LOAD:
+          std::copy(temps.data() + in.slot * blockSize, temps.data() + in.slot * blockSize + n, top);
+          if (checked)
+            std::copy(badTemps.data() + in.slot * blockSize, badTemps.data() + in.slot * blockSize + n, b);
+          ++depth;
+          break;
+        case instr_t::opcode_t::OUTPUT:
+          --depth;
+          std::copy(top - blockSize, top - blockSize + n, results.data() + in.slot * rows + first);
+          for (size_t r = 0; checked && r < n; ++r)
+            if ((b - blockSize)[r])
+              results[in.slot * rows + first + r] = operation_t::domainError();
+          break;
+        default:
+          depth -= in.arity;
+          top = stack.data() + depth * blockSize;
+          for (size_t k = 0; k < in.arity; ++k)
+            args[k] = top + k * blockSize;
+          if (checked)
+            poison(in, top, depth, n);
+          in.operation->evaluateBlock(args.data(), top, n);
+          ++depth;
+          break;
+      }
+    }
+  }
+}
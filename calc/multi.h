@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include "program.h"
+
+/**
+ * @brief Several formulas compiled into one program which computes their common subexpressions once
+ */
+struct multi_program_t {
+  std::vector<instr_t> code;                      ///< instructions, every formula ends with OUTPUT
+  std::vector<std::shared_ptr<variable_t>> vars;  ///< variables of all formulas referred by slot
+  std::vector<std::shared_ptr<operation_t>> ops;  ///< operations kept alive while program exists
+  size_t maxDepth = 0;                            ///< maximal depth of operand stack
+  size_t temps = 0;                               ///< number of temporaries for shared subexpressions
+  size_t outputs = 0;                             ///< number of formulas
+  size_t calls = 0;                               ///< operation invocations per row
+  size_t separateCalls = 0;                       ///< operation invocations per row of the formulas compiled apart
+};
+
+/**
+ * @brief Class which merges compiled programs and shares their common subexpressions by value numbering
+ */
+class multi_compiler_t {
+private:
+  /**
+   * @brief Distinct value of the formulas
+   */
+  struct node_t {
+    instr_t instr;              ///< instruction which computes the value from the values of args
+    std::vector<size_t> args;   ///< operand nodes
+    size_t uses = 0;            ///< number of nodes and outputs which take the value
+    size_t temp = npos;         ///< temporary which keeps the value after its first computation
+  };
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  std::vector<node_t> nodes;                        ///< values of all formulas
+  std::map<std::vector<uint64_t>, size_t> numbers;  ///< value numbers by instruction and operands
+
+  /**
+   * Find or create the node of instruction
+   * @warning calls of operations which are not pure get a node of their own, so they are never shared
+   * @param[in] in - instruction, variable slot refers to multi_program_t::vars
+   * @param[in] args - operand nodes
+   * @return node index
+   */
+  size_t number(instr_t const& in, std::vector<size_t> args);
+
+  /**
+   * Emit instructions of the node
+   * @param[in] n - node index
+   * @param[in] depth - depth of stack before the node
+   * @param[out] res - program
+   */
+  void emit(size_t n, size_t depth, multi_program_t& res);
+
+public:
+  /**
+   * Default constructor
+   */
+  multi_compiler_t() = default;
+
+  /**
+   * Merge compiled programs
+   * @warning throws calc_exception_t if a program has conditionals or stateful functions
+   * @param[in] formulas - compiled programs
+   * @return program which writes result of formula k to output k
+   */
+  multi_program_t compile(std::vector<program_t> const& formulas);
+
+  /**
+   * Destructor
+   */
+  ~multi_compiler_t() = default;
+};
+
+/**
+ * @brief Class which evaluates all formulas of merged program in a single pass over rows
+ */
+class multi_calculator_t {
+private:
+  static constexpr size_t blockSize = 256;  ///< number of rows processed at once
+
+  std::vector<double> stack;            ///< preallocated operand stack of blocks
+  std::vector<double> temps;            ///< temporaries of blocks
+  std::vector<double const*> args;      ///< operands of current operation
+  std::vector<uint8_t> bad;             ///< rows of stack entries whose values depend on a domain error
+  std::vector<uint8_t> badTemps;        ///< the same for temporaries
+  std::vector<double> operands;         ///< operands of a row being checked against the domain
+
+  /**
+   * Mark rows of the operation result which depend on a domain error
+   * @param[in] in - CALL instruction
+   * @param[in] top - first operand array, others follow with blockSize stride
+   * @param[in] depth - stack depth of the first operand
+   * @param[in] n - number of rows
+   */
+  void poison(instr_t const& in, double const* top, size_t depth, size_t n);
+
+public:
+  /**
+   * Default constructor
+   */
+  multi_calculator_t() = default;
+
+  /**
+   * Calculate all formulas for every row
+   * @warning throws calc_exception_t if a variable without column is uninitialized,
+   * operations which don't override evaluateBlock may throw std::exception
+   * @param[in] prog - merged program
+   * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - result of formula k for row r at k * rows + r, NaN if the formula has domain error
+   */
+  void calculate(multi_program_t const& prog, std::vector<double const*> const& columns, size_t rows,
+                 std::vector<double>& results);
+
+  /**
+   * Destructor
+   */
+  ~multi_calculator_t() = default;
+};
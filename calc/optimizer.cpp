@@ -0,0 +1,582 @@
+#include <cmath>
+#include <algorithm>
+#include "optimizer.h"
+#include "builtin.h"
+#include "trace.h"
+
+using kind_t = operation_t::operation_kind_t;
+
+/**
+ * Default constructor
+ */
+optimizer_t::optimizer_t() : fma(new fma_op_t) {}
+
+/**
+ * Set table of operations and functions
+ * @param[in] operations - struct with operations
+ */
+void optimizer_t::setOperations(ops_maps const& operations) {
+  add = sub = mul = neg = nullptr;
+
+  for (auto& op : operations.inf) {
+    switch (op.second->kind()) {
+      case kind_t::ADD:
+        add = op.second;
+        break;
+      case kind_t::SUB:
+        sub = op.second;
+        break;
+      case kind_t::MUL:
+        mul = op.second;
+        break;
+      default:
+        break;
+    }
+  }
+  for (auto& op : operations.pref)
+    if (op.second->kind() == kind_t::NEG)
+      neg = op.second;
+}
+
+/**
+ * Create operation node at the position of the rewritten tree
+ * @param[in] op - operation
+ * @param[in] args - operands from left to right
+ * @return created node
+ */
+expr_tree_t optimizer_t::makeOp(std::shared_ptr<operation_t> const& op, std::vector<expr_tree_t> args) {
+  expr_tree_t node = expr_node_t::makeOperation(op, std::move(args));
+
+  node->pos = curPos;
+  return node;
+}
+
+/**
+ * Create variable node at the position of the rewritten tree
+ * @param[in] x - variable node to copy
+ * @return created node
+ */
+expr_tree_t optimizer_t::makeVar(expr_node_t const* x) {
+  expr_tree_t node = expr_node_t::makeVariable(x->var);
+
+  node->pos = curPos;
+  return node;
+}
+
+/**
+ * Coefficient arithmetic with folding of numbers
+ * @param[in] a, b - coefficients, nullptr means zero
+ * @return resulting coefficient
+ */
+expr_tree_t optimizer_t::coefAdd(expr_tree_t a, expr_tree_t b) {
+  if (!a)
+    return b;
+  if (!b)
+    return a;
+  if (a->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && b->type == a->type)
+    return expr_node_t::makeNumber(a->value + b->value);
+
+  std::vector<expr_tree_t> args;
+  args.push_back(std::move(a));
+  args.push_back(std::move(b));
+  return makeOp(add, std::move(args));
+}
+
+expr_tree_t optimizer_t::coefSub(expr_tree_t a, expr_tree_t b) {
+  if (!b)
+    return a;
+  if (!a)
+    return coefNeg(std::move(b));
+  if (a->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && b->type == a->type)
+    return expr_node_t::makeNumber(a->value - b->value);
+
+  std::vector<expr_tree_t> args;
+  args.push_back(std::move(a));
+  args.push_back(std::move(b));
+  return makeOp(sub, std::move(args));
+}
+
+expr_tree_t optimizer_t::coefMul(expr_tree_t a, expr_tree_t b) {
+  if (!a || !b)
+    return nullptr;
+  if (a->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && b->type == a->type)
+    return expr_node_t::makeNumber(a->value * b->value);
+  // multiplication by one is dropped
+  if (a->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && a->value == 1.0)
+    return b;
+  if (b->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && b->value == 1.0)
+    return a;
+
+  std::vector<expr_tree_t> args;
+  args.push_back(std::move(a));
+  args.push_back(std::move(b));
+  return makeOp(mul, std::move(args));
+}
+
+expr_tree_t optimizer_t::coefNeg(expr_tree_t a) {
+  if (!a)
+    return nullptr;
+  if (a->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER)
+    return expr_node_t::makeNumber(-a->value);
+
+  std::vector<expr_tree_t> args;
+  if (neg) {
+    args.push_back(std::move(a));
+    return makeOp(neg, std::move(args));
+  }
+  args.push_back(expr_node_t::makeNumber(-1.0));
+  args.push_back(std::move(a));
+  return makeOp(mul, std::move(args));
+}
+
+/**
+ * Multiply polynomials
+ * @param[in] p, q - polynomials
+ * @return product
+ */
+optimizer_t::poly_t optimizer_t::polyMul(poly_t const& p, poly_t const& q) {
+  poly_t res(p.size() + q.size() - 1);
+
+  for (size_t i = 0; i < p.size(); ++i)
+    for (size_t j = 0; j < q.size(); ++j)
+      if (p[i] && q[j])
+        res[i + j] = coefAdd(std::move(res[i + j]), coefMul(p[i]->clone(), q[j]->clone()));
+  return res;
+}
+
+/**
+ * Check that polynomial has at most one term
+ * @param[in] p - polynomial
+ * @return true if all coefficients but one are zero
+ */
+bool optimizer_t::isMonomial(poly_t const& p) {
+  return std::count_if(p.begin(), p.end(), [](expr_tree_t const& c) { return c != nullptr; }) <= 1;
+}
+
+/**
+ * Check that the tree may be cloned and evaluated in another order without changing the result
+ * @param[in] node - tree
+ * @return true if no operation of the tree is stateful or declared impure
+ */
+static bool isPureTree(expr_node_t const* node) {
+  if (node->type == expr_node_t::node_type_t::NODE_TYPE_OPERATION) {
+    operation_t* op = node->operation.get();
+    kind_t k = op->kind();
+
+    // well known arithmetic is pure even if the plugin doesn't declare it
+    if (dynamic_cast<stateful_t*>(op) || (!op->isPure() && (k == kind_t::GENERIC || k == kind_t::COND || k == kind_t::SELECT)))
+      return false;
+  }
+  for (auto& arg : node->args)
+    if (!isPureTree(arg.get()))
+      return false;
+  return true;
+}
+
+/**
+ * Represent the tree as a polynomial in variable
+ * @param[in] node - tree
+ * @param[in] x - variable of polynomial
+ * @param[out] res - coefficients of polynomial
+ * @return false if the tree is not a polynomial in x or some coefficient is not pure
+ */
+bool optimizer_t::toPoly(expr_node_t const* node, variable_t const* x, poly_t& res) {
+  res.clear();
+
+  if (!node->dependsOn(x)) { // the whole subtree is a coefficient
+    // coefficients are cloned and reordered, so calls with side effects or history would change the result
+    if (!isPureTree(node))
+      return false;
+    res.push_back(node->clone());
+    return true;
+  }
+  if (node->type == expr_node_t::node_type_t::NODE_TYPE_VARIABLE) {
+    res.push_back(nullptr);
+    res.push_back(expr_node_t::makeNumber(1.0));
+    return true;
+  }
+
+  poly_t p, q;
+
+  switch (node->operation->kind()) {
+    case kind_t::ADD:
+    case kind_t::SUB:
+      if (!toPoly(node->args[0].get(), x, p) || !toPoly(node->args[1].get(), x, q))
+        return false;
+      res.resize(std::max(p.size(), q.size()));
+      for (size_t i = 0; i < res.size(); ++i) {
+        expr_tree_t a = i < p.size() ? std::move(p[i]) : nullptr;
+        expr_tree_t b = i < q.size() ? std::move(q[i]) : nullptr;
+
+        if (node->is(kind_t::ADD))
+          res[i] = coefAdd(std::move(a), std::move(b));
+        else
+          res[i] = coefSub(std::move(a), std::move(b));
+      }
+      return true;
+    case kind_t::NEG:
+      if (!toPoly(node->args[0].get(), x, res))
+        return false;
+      for (auto& c : res)
+        c = coefNeg(std::move(c));
+      return true;
+    case kind_t::MUL:
+      // expanded product of binomials loses the cancellation which the factors have, e.g. (x-1)*(x-1) near 1
+      if (!toPoly(node->args[0].get(), x, p) || !toPoly(node->args[1].get(), x, q) ||
+            (!isMonomial(p) && !isMonomial(q)))
+        return false;
+      if (p.size() + q.size() - 2 > maxDegree)
+        return false;
+      res = polyMul(p, q);
+      return true;
+    case kind_t::DIV:
+    {
+      expr_node_t const* d = node->args[1].get();
+
+      // only division by a number and only with reciprocal allowed
+      if (!opts.fastMath || d->type != expr_node_t::node_type_t::NODE_TYPE_NUMBER ||
+            d->value == 0 || !std::isfinite(1.0 / d->value))
+        return false;
+      if (!toPoly(node->args[0].get(), x, res))
+        return false;
+      for (auto& c : res)
+        c = coefMul(std::move(c), expr_node_t::makeNumber(1.0 / d->value));
+      return true;
+    }
+    case kind_t::POW:
+    {
+      expr_node_t const* e = node->args[1].get();
+
+      // only small natural powers
+      if (e->type != expr_node_t::node_type_t::NODE_TYPE_NUMBER || e->value < 1 ||
+            e->value != std::trunc(e->value) || e->value > maxDegree)
+        return false;
+      if (!toPoly(node->args[0].get(), x, p) || (e->value > 1 && !isMonomial(p)))
+        return false;
+      if ((p.size() - 1) * static_cast<size_t>(e->value) > maxDegree)
+        return false;
+      for (auto& c : p)
+        res.push_back(c ? c->clone() : nullptr);
+      for (int i = 1; i < static_cast<int>(e->value); ++i)
+        res = polyMul(res, p);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * Build Horner form of polynomial
+ * @param[in] p - coefficients of polynomial of at least second degree, they are moved into the tree
+ * @param[in] x - variable of polynomial
+ * @return tree
+ */
+expr_tree_t optimizer_t::horner(poly_t& p, expr_node_t const* x) {
+  expr_tree_t acc = std::move(p.back());
+
+  for (size_t i = p.size() - 1; i-- > 0;) {
+    std::vector<expr_tree_t> args;
+
+    // leading coefficient one needs no multiplication
+    if (acc->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER && acc->value == 1.0) {
+      acc = makeVar(x);
+      if (p[i]) {
+        args.push_back(std::move(acc));
+        args.push_back(std::move(p[i]));
+        acc = makeOp(add, std::move(args));
+      }
+      continue;
+    }
+
+    args.push_back(std::move(acc));
+    args.push_back(makeVar(x));
+    if (p[i]) {
+      args.push_back(std::move(p[i]));
+      acc = makeOp(fma, std::move(args));
+    }
+    else
+      acc = makeOp(mul, std::move(args));
+  }
+  return acc;
+}
+
+/**
+ * Try to replace the tree with Horner form of polynomial in one of its variables
+ * @param[in] node - tree
+ * @param[out] node - cheaper tree if it was found, its coefficients are rewritten
+ * @return true if the tree was replaced
+ */
+bool optimizer_t::tryHorner(expr_tree_t& node) {
+  std::vector<expr_node_t const*> vars;
+  std::vector<expr_node_t const*> nodes = { node.get() };
+  expr_node_t const* best = nullptr;
+  size_t bestCost = node->countOperations();
+  poly_t p;
+
+  curPos = node->pos;
+
+  // collect distinct variables of the tree
+  while (!nodes.empty()) {
+    expr_node_t const* n = nodes.back();
+    nodes.pop_back();
+    if (n->type == expr_node_t::node_type_t::NODE_TYPE_VARIABLE) {
+      bool found = false;
+      for (auto& v : vars)
+        found = found || v->var == n->var;
+      if (!found)
+        vars.push_back(n);
+    }
+    for (auto& arg : n->args)
+      nodes.push_back(arg.get());
+  }
+
+  for (auto& x : vars) {
+    if (!toPoly(node.get(), x->var.get(), p))
+      continue;
+    while (!p.empty() && !p.back())
+      p.pop_back();
+    if (p.size() < 3) // Horner form does not help below quadratic polynomials
+      continue;
+
+    size_t cost = horner(p, x)->countOperations();
+    if (cost < bestCost) {
+      bestCost = cost;
+      best = x;
+    }
+  }
+
+  if (!best)
+    return false;
+
+  toPoly(node.get(), best->var.get(), p);
+  while (!p.back())
+    p.pop_back();
+  // coefficients may be polynomials in other variables or have rewrites of their own
+  for (auto& c : p)
+    if (c)
+      rewrite(c);
+  curPos = node->pos;
+  node = horner(p, best);
+  ++rep.polynomials;
+  return true;
+}
+
+/**
+ * Try to replace pure operation of numbers with its result
+ * @param[in] node - tree whose operands are rewritten
+ * @param[out] node - number if the operation was evaluated
+ * @return true if the tree was replaced
+ */
+bool optimizer_t::tryFold(expr_tree_t& node) {
+  operation_t* op = node->operation.get();
+  kind_t k = op->kind();
+
+  // well known arithmetic is pure even if the plugin doesn't declare it, conditionals are left to the compiler
+  if (!op->isPure() && (k == kind_t::GENERIC || k == kind_t::COND || k == kind_t::SELECT))
+    return false;
+
+  std::vector<double> args;
+
+  for (auto& arg : node->args) {
+    if (arg->type != expr_node_t::node_type_t::NODE_TYPE_NUMBER)
+      return false;
+    args.push_back(arg->value);
+  }
+
+  // domain errors are left for the evaluator, which reports their position, NaN of other operations is folded
+  if (op->hasDomain() && !op->inDomain(args.data()))
+    return false;
+
+  double res = op->evaluate(args.data());
+
+  size_t pos = node->pos;
+
+  node = expr_node_t::makeNumber(res);
+  node->pos = pos;
+  ++rep.folded;
+  return true;
+}
+
+/**
+ * Build tree of associative operation from serial runs combined by balanced tree
+ * @param[in] op - operation
+ * @param[in] leaves - operands from left to right, they are moved into the tree
+ * @param[in] lo, hi - range of operands
+ * @param[in] run - operands of serial run, 1 for balanced tree of operands
+ * @return tree whose runs are independent partial results
+ */
+expr_tree_t optimizer_t::balance(std::shared_ptr<operation_t> const& op, std::vector<expr_tree_t>& leaves,
+                                 size_t lo, size_t hi, size_t run) {
+  if (hi - lo <= run) {
+    expr_tree_t acc = std::move(leaves[lo]);
+
+    for (size_t i = lo + 1; i < hi; ++i) {
+      std::vector<expr_tree_t> args;
+
+      args.push_back(std::move(acc));
+      args.push_back(std::move(leaves[i]));
+      acc = makeOp(op, std::move(args));
+      if (opts.fold)
+        tryFold(acc);
+    }
+    return acc;
+  }
+
+  size_t runs = (hi - lo + run - 1) / run;
+  size_t mid = lo + (runs + 1) / 2 * run;
+  std::vector<expr_tree_t> args;
+
+  args.push_back(balance(op, leaves, lo, mid, run));
+  args.push_back(balance(op, leaves, mid, hi, run));
+
+  expr_tree_t res = makeOp(op, std::move(args));
+
+  if (opts.fold)
+    tryFold(res);
+  return res;
+}
+
+/**
+ * Try to replace long chain of additions and subtractions or of multiplications with balanced trees,
+ * so that the evaluator can overlap independent operations
+ * @warning floating point operations are not associative, the result may differ in the last bits and
+ * intermediate overflow may happen elsewhere, though shorter serial runs accumulate less rounding error
+ * @param[in] node - tree
+ * @param[out] node - difference of sums or product of independent partial results whose operands are rewritten
+ * @return true if the tree was replaced
+ */
+bool optimizer_t::tryBalance(expr_tree_t& node) {
+  bool sum = node->is(kind_t::ADD) || node->is(kind_t::SUB);
+
+  if (sum ? !add || !sub : !node->is(kind_t::MUL) || !mul)
+    return false;
+
+  auto member = [sum](expr_node_t const* n) {
+    return sum ? n->is(kind_t::ADD) || n->is(kind_t::SUB) : n->is(kind_t::MUL);
+  };
+  // the stack machine fuses serial runs into superinstructions, so it prefers few long runs to a balanced tree
+  auto run = [this](size_t n) {
+    return opts.accumulators ? (n + opts.accumulators - 1) / opts.accumulators : 1;
+  };
+  std::vector<expr_node_t const*> nodes = { node.get() };
+  size_t count = 0;
+
+  // the chain is measured before it is taken apart
+  while (!nodes.empty()) {
+    expr_node_t const* n = nodes.back();
+    nodes.pop_back();
+    if (member(n))
+      for (auto& arg : n->args)
+        nodes.push_back(arg.get());
+    else
+      ++count;
+  }
+  if (count < minChain)
+    return false;
+
+  size_t pos = node->pos;
+  std::vector<expr_tree_t> terms[2]; // added and subtracted operands
+  std::vector<std::pair<expr_tree_t, bool>> chain;
+
+  chain.emplace_back(std::move(node), false);
+  while (!chain.empty()) {
+    expr_tree_t n = std::move(chain.back().first);
+    bool minus = chain.back().second;
+
+    chain.pop_back();
+    if (!member(n.get())) {
+      rewrite(n);
+      terms[minus].push_back(std::move(n));
+      continue;
+    }
+    // the right operand is pushed first, so operands are taken from left to right
+    chain.emplace_back(std::move(n->args[1]), minus != n->is(kind_t::SUB));
+    chain.emplace_back(std::move(n->args[0]), minus);
+  }
+
+  // the leftmost operand is always added
+  curPos = pos;
+  node = balance(sum ? add : mul, terms[0], 0, terms[0].size(), run(terms[0].size()));
+  if (!terms[1].empty()) {
+    std::vector<expr_tree_t> args;
+
+    args.push_back(std::move(node));
+    args.push_back(balance(add, terms[1], 0, terms[1].size(), run(terms[1].size())));
+    node = makeOp(sub, std::move(args));
+    if (opts.fold)
+      tryFold(node);
+  }
+  ++rep.chains;
+  return true;
+}
+
+/**
+ * Apply all allowed rewrites to the tree
+ * @param[in] node - tree
+ * @param[out] node - rewritten tree
+ */
+void optimizer_t::rewrite(expr_tree_t& node) {
+  if (node->type != expr_node_t::node_type_t::NODE_TYPE_OPERATION)
+    return;
+
+  if (opts.horner && add && mul && (node->is(kind_t::ADD) || node->is(kind_t::SUB) ||
+        node->is(kind_t::MUL) || node->is(kind_t::POW)) && tryHorner(node))
+    return;
+
+  // operands of the rebalanced chain are rewritten already
+  if (opts.reassociate && tryBalance(node))
+    return;
+
+  for (auto& arg : node->args)
+    rewrite(arg);
+
+  if (opts.fold && tryFold(node))
+    return;
+
+  // x / c -> x * (1 / c)
+  if (opts.fastMath && mul && node->is(kind_t::DIV) &&
+        node->args[1]->type == expr_node_t::node_type_t::NODE_TYPE_NUMBER) {
+    double r = 1.0 / node->args[1]->value;
+
+    if (node->args[1]->value != 0 && std::isfinite(r)) {
+      std::vector<expr_tree_t> args;
+
+      curPos = node->pos;
+      args.push_back(std::move(node->args[0]));
+      args.push_back(expr_node_t::makeNumber(r));
+      node = makeOp(mul, std::move(args));
+      ++rep.reciprocals;
+    }
+  }
+}
+
+/**
+ * Optimize expression tree
+ * @param[in] tree - expression tree
+ * @param[out] tree - optimized expression tree
+ */
+void optimizer_t::optimize(expr_tree_t& tree) {
+  trace_span_t span("optimize", "pipeline");
+
+  rep = report_t();
+  rep.opsBefore = tree->countOperations();
+  rewrite(tree);
+  rep.opsAfter = tree->countOperations();
+}
+
+/**
+ * Optimize rpn queue
+ * @warning throws calc_exception_t if the queue is not a single correct expression
+ * @param[in] rpnTokens - rpn queue
+ * @return optimized rpn queue
+ */
+token_queue_t& optimizer_t::optimize(token_queue_t& rpnTokens) {
+  expr_tree_t tree = expr_node_t::fromRpn(rpnTokens);
+
+  while (!qres.empty())
+    qres.pop();
+  optimize(tree);
+  tree->toRpn(qres);
+  return qres;
+}
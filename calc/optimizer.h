@@ -0,0 +1,195 @@
+#pragma once
+
+#include "tree.h"
+
+/**
+ * @brief Class which rewrites rpn queue into cheaper equivalent
+ */
+class optimizer_t {
+public:
+  /**
+   * @brief Rewrites which are allowed
+   */
+  struct options_t {
+    bool horner = false;       ///< rewrite polynomials in a single variable into Horner form with fma (changes rounding)
+    bool fastMath = false;     ///< replace division by constant with multiplication by reciprocal (changes rounding)
+    bool fold = false;         ///< evaluate pure operations of numbers at compile time
+    bool reassociate = false;  ///< rebalance long chains of additions or multiplications into trees (changes rounding)
+    size_t accumulators = 8;   ///< independent partial results of rebalanced chain, 0 for balanced tree
+  };
+
+  /**
+   * @brief Statistics of the last optimization
+   */
+  struct report_t {
+    size_t opsBefore = 0;    ///< number of operations before optimization
+    size_t opsAfter = 0;     ///< number of operations after optimization
+    size_t polynomials = 0;  ///< number of polynomials rewritten into Horner form
+    size_t reciprocals = 0;  ///< number of divisions replaced with multiplication
+    size_t folded = 0;       ///< number of operations evaluated at compile time
+    size_t chains = 0;       ///< number of associative chains rebalanced into trees
+  };
+
+private:
+  /**
+   * @brief Polynomial coefficients from lowest degree, nullptr means zero
+   */
+  using poly_t = std::vector<expr_tree_t>;
+
+  static size_t const maxDegree = 16;  ///< polynomials of greater degree are not rewritten
+  static size_t const minChain = 4;    ///< chains of fewer operands are as deep balanced as they are
+
+  options_t opts;                      ///< allowed rewrites
+  report_t rep;                        ///< statistics of the last optimization
+  token_queue_t qres;                  ///< resulting rpn queue
+  std::shared_ptr<operation_t> add;    ///< addition loaded from plugins
+  std::shared_ptr<operation_t> sub;    ///< subtraction loaded from plugins
+  std::shared_ptr<operation_t> mul;    ///< multiplication loaded from plugins
+  std::shared_ptr<operation_t> neg;    ///< negation loaded from plugins
+  std::shared_ptr<operation_t> fma;    ///< fused multiply-add
+  size_t curPos = 0;                   ///< position of the tree being rewritten
+
+  /**
+   * Create node at the position of the rewritten tree
+   * @param[in] op - operation
+   * @param[in] args - operands from left to right
+   * @param[in] x - variable node to copy
+   * @return created node
+   */
+  expr_tree_t makeOp(std::shared_ptr<operation_t> const& op, std::vector<expr_tree_t> args);
+  expr_tree_t makeVar(expr_node_t const* x);
+
+  /**
+   * Coefficient arithmetic with folding of numbers
+   * @param[in] a, b - coefficients, nullptr means zero
+   * @return resulting coefficient
+   */
+  expr_tree_t coefAdd(expr_tree_t a, expr_tree_t b);
+  expr_tree_t coefSub(expr_tree_t a, expr_tree_t b);
+  expr_tree_t coefMul(expr_tree_t a, expr_tree_t b);
+  expr_tree_t coefNeg(expr_tree_t a);
+
+  /**
+   * Multiply polynomials
+   * @param[in] p, q - polynomials
+   * @return product
+   */
+  poly_t polyMul(poly_t const& p, poly_t const& q);
+
+  /**
+   * Check that polynomial has at most one term
+   * @param[in] p - polynomial
+   * @return true if all coefficients but one are zero
+   */
+  static bool isMonomial(poly_t const& p);
+
+  /**
+   * Represent the tree as a polynomial in variable
+   * @param[in] node - tree
+   * @param[in] x - variable of polynomial
+   * @param[out] res - coefficients of polynomial
+   * @return false if the tree is not a polynomial in x or some coefficient is not pure
+   */
+  bool toPoly(expr_node_t const* node, variable_t const* x, poly_t& res);
+
+  /**
+   * Build Horner form of polynomial
+   * @param[in] p - coefficients of polynomial of at least second degree, they are moved into the tree
+   * @param[in] x - variable of polynomial
+   * @return tree
+   */
+  expr_tree_t horner(poly_t& p, expr_node_t const* x);
+
+  /**
+   * Try to replace the tree with Horner form of polynomial in one of its variables
+   * @param[in] node - tree
+   * @param[out] node - cheaper tree if it was found, its coefficients are rewritten
+   * @return true if the tree was replaced
+   */
+  bool tryHorner(expr_tree_t& node);
+
+  /**
+   * Try to replace pure operation of numbers with its result
+   * @param[in] node - tree whose operands are rewritten
+   * @param[out] node - number if the operation was evaluated
+   * @return true if the tree was replaced
+   */
+  bool tryFold(expr_tree_t& node);
+
+  /**
+   * Build tree of associative operation from serial runs combined by balanced tree
+   * @param[in] op - operation
+   * @param[in] leaves - operands from left to right, they are moved into the tree
+   * @param[in] lo, hi - range of operands
+   * @param[in] run - operands of serial run, 1 for balanced tree of operands
+   * @return tree whose runs are independent partial results
+   */
+  expr_tree_t balance(std::shared_ptr<operation_t> const& op, std::vector<expr_tree_t>& leaves,
+                      size_t lo, size_t hi, size_t run);
+
+  /**
+   * Try to replace long chain of additions and subtractions or of multiplications with balanced trees,
+   * so that the evaluator can overlap independent operations
+   * @warning floating point operations are not associative, the result may differ in the last bits and
+   * intermediate overflow may happen elsewhere, though shorter serial runs accumulate less rounding error
+   * @param[in] node - tree
+   * @param[out] node - difference of sums or product of independent partial results whose operands are rewritten
+   * @return true if the tree was replaced
+   */
+  bool tryBalance(expr_tree_t& node);
+
+  /**
+   * Apply all allowed rewrites to the tree
+   * @param[in] node - tree
+   * @param[out] node - rewritten tree
+   */
+  void rewrite(expr_tree_t& node);
+
+public:
+  /**
+   * Default constructor
+   */
+  optimizer_t();
+
+  /**
+   * Set table of operations and functions
+   * @param[in] operations - struct with operations
+   */
+  void setOperations(ops_maps const& operations);
+
+  /**
+   * Set allowed rewrites
+   * @param[in] options - allowed rewrites
+   */
+  void setOptions(options_t const& options) {
+    opts = options;
+  }
+
+  /**
+   * Returns statistics of the last optimization
+   * @return statistics
+   */
+  report_t const& report() const noexcept {
+    return rep;
+  }
+
+  /**
+   * Optimize rpn queue
+   * @warning throws calc_exception_t if the queue is not a single correct expression
+   * @param[in] rpnTokens - rpn queue
+   * @return optimized rpn queue
+   */
+  token_queue_t& optimize(token_queue_t& rpnTokens);
+
+  /**
+   * Optimize expression tree
+   * @param[in] tree - expression tree
+   * @param[out] tree - optimized expression tree
+   */
+  void optimize(expr_tree_t& tree);
+
+  /**
+   * Destructor
+   */
+  ~optimizer_t() = default;
+};
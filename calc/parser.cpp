@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "error.h"
+#include "trace.h"
 
 /**
  * Send operators with higher priority from stack with operators to general stack
@@ -28,25 +30,34 @@ void parser_t::displacementOperations(std::unique_ptr<token_t> op) {
       throw std::exception(err.c_str());
   }
 
-  // crowding out higher priority operations
+  // crowding out higher priority operations, : closes the nearest ? like a bracket
+  bool select = tmp->operation->kind() == operation_t::operation_kind_t::SELECT;
+
   while (!oper.empty()) {
     tok = std::move(oper.top());
     oper.pop();
-    if (!checkPrior(static_cast<token_operation_t*>(tok.get()), tmp)) {
+
+    operation_t::operation_kind_t kind = static_cast<token_operation_t*>(tok.get())->operation->kind();
+
+    if (!checkPrior(static_cast<token_operation_t*>(tok.get()), tmp) &&
+          !(select && kind == operation_t::operation_kind_t::SELECT)) {
       oper.push(std::move(tok));
       break;
     }
     else
       gen.push(std::move(tok));
+    if (select && kind == operation_t::operation_kind_t::COND)
+      break;
   }
   oper.push(std::move(op));
 }
 
 /**
  * Send operators from stack with operators to general stack until any open bracket
+ * @param[out] pos - position of the found open bracket
  * @return true if any open bracket was found
  */
-bool parser_t::displacementUntilAnyOpenBracket() {
+bool parser_t::displacementUntilAnyOpenBracket(size_t& pos) {
   std::unique_ptr<token_t> tok;
   token_operation_t* op;
 
@@ -66,8 +77,10 @@ bool parser_t::displacementUntilAnyOpenBracket() {
         
         if (pref->prefixType == prefix_op_t::prefix_type_t::PREFIX_OP)
           gen.push(std::move(tok));
-        else
+        else {
+          pos = tok->pos;
           return true;
+        }
         break;
       }
     }
@@ -139,6 +152,53 @@ bool parser_t::displacementUntilOpenBracket(std::unique_ptr<token_t> op) {
   return false;
 }
 
+/**
+ * Send operators from stack with operators to general stack until any open bracket, which stays in place
+ * @warning throws calc_exception_t if there is no open bracket
+ * @param[in] pos - position of the separator
+ */
+void parser_t::displacementUntilSeparator(size_t pos) {
+  while (!oper.empty()) {
+    token_operation_t* op = static_cast<token_operation_t*>(oper.top().get());
+
+    if (op->operation->type == operation_t::operation_type_t::PREFIX_OP &&
+          static_cast<prefix_op_t*>(op->operation.get())->prefixType == prefix_op_t::prefix_type_t::OPEN_BRACKET) {
+      ++argcs.top();
+      return;
+    }
+    gen.push(std::move(oper.top()));
+    oper.pop();
+  }
+
+  throw calc_exception_t(calc_error_t::SYNTAX, pos, "Unexpected separator");
+}
+
+/**
+ * Check the number of arguments of function whose brackets have just been closed, bind variadic function to it
+ * @warning throws calc_exception_t if the number of arguments doesn't match the function
+ * @param[in] argc - number of arguments in the brackets
+ * @param[in] pos - position of the closing bracket
+ */
+void parser_t::bindCall(size_t argc, size_t pos) {
+  if (!oper.empty()) {
+    token_operation_t* tok = static_cast<token_operation_t*>(oper.top().get());
+
+    if (tok->operation->type == operation_t::operation_type_t::FUNCTION) {
+      variadic_t* var = dynamic_cast<variadic_t*>(tok->operation.get());
+
+      // every call site of variadic function gets its own operation of fixed arity
+      if (var)
+        tok->operation = var->bind(argc);
+      else if (argc != tok->operation->arity())
+        throw calc_exception_t(calc_error_t::SYNTAX, tok->pos, "Wrong number of arguments");
+      return;
+    }
+  }
+
+  if (argc > 1)
+    throw calc_exception_t(calc_error_t::SYNTAX, pos, "Unexpected separator");
+}
+
 /**
  * Check which of operators has higher priority
  * @param[in] op1 - first token
@@ -156,9 +216,9 @@ bool parser_t::checkPrior(token_operation_t* op1, token_operation_t* op2) {
       
       // the displacement of infix operations is determined by priority and associativity
       if (tmpop1->assoc == infix_t::operation_assoc_t::TO_RIGHT)
-        return tmpop1->prior >= op2->operation.get()->prior;
+        return tmpop1->prior >= op2->operation->prior;
       else
-        return tmpop1->prior > op2->operation.get()->prior;
+        return tmpop1->prior > op2->operation->prior;
     }
     else
       return false;
@@ -170,7 +230,7 @@ bool parser_t::checkPrior(token_operation_t* op1, token_operation_t* op2) {
     if (tmpop1->prefixType == prefix_op_t::prefix_type_t::OPEN_BRACKET)
       return false;
     else
-      return tmpop1->prior > op2->operation.get()->prior;
+      return tmpop1->prior > op2->operation->prior;
   }
 }
 
@@ -193,11 +253,14 @@ parser_t::state_t parser_t::processOperand(std::unique_ptr<token_t> op) {
       switch (tok->operation->type) {
         case operation_t::operation_type_t::FUNCTION:
         case operation_t::operation_type_t::PREFIX_OP:
+          if (tok->operation->type == operation_t::operation_type_t::PREFIX_OP &&
+                static_cast<prefix_op_t*>(tok->operation.get())->prefixType == prefix_op_t::prefix_type_t::OPEN_BRACKET)
+            argcs.push(1);
           oper.push(std::move(op));
           state = state_t::STATE_OPERAND;
           break;
         default: // at this stage, it is not expected to encounter an infix or postfix operation
-          throw std::exception("Unexpected operation");
+          throw calc_exception_t(calc_error_t::UNEXPECTED_TOKEN, op->pos, "Unexpected operation");
       }
       break;
   }
@@ -212,13 +275,17 @@ parser_t::state_t parser_t::processOperand(std::unique_ptr<token_t> op) {
  */
 parser_t::state_t parser_t::processOperation(std::unique_ptr<token_t> op) {
   state_t state = state_t::STATE_OPERAND;
+  size_t pos = op->pos;
 
   if (op->type == token_t::token_type_t::TOKEN_TYPE_OPERATION) {
     token_operation_t* tok = static_cast<token_operation_t*>(op.get());
 
     switch (tok->operation->type) {
       case operation_t::operation_type_t::INFIX_OP:
-        displacementOperations(std::move(op));
+        if (dynamic_cast<separator_t*>(tok->operation.get()))
+          displacementUntilSeparator(pos);
+        else
+          displacementOperations(std::move(op));
         break;
       case operation_t::operation_type_t::POSTFIX_OP:
       {
@@ -226,18 +293,24 @@ parser_t::state_t parser_t::processOperation(std::unique_ptr<token_t> op) {
 
         if (postf->postfixType == postfix_op_t::postfix_type_t::POSTFIX_OP)
           displacementOperations(std::move(op));
-        else // due to the special behavior, the brackets are handled separately
+        else { // due to the special behavior, the brackets are handled separately
           if (!displacementUntilOpenBracket(std::move(op)))
-            throw std::exception("Error with brackets");
+            throw calc_exception_t(calc_error_t::BRACKETS, pos, "Error with brackets");
+
+          size_t argc = argcs.top();
+
+          argcs.pop();
+          bindCall(argc, pos);
+        }
         state = state_t::STATE_OPERATION;
         break;
       }
       default: // at this stage, only postfix and infix operations are expected
-        throw std::exception("Unexpected operation");
+        throw calc_exception_t(calc_error_t::UNEXPECTED_TOKEN, pos, "Unexpected operation");
     }
   }
   else // at this stage, only postfix and infix operations are expected
-    throw std::exception("Unexpected operand");
+    throw calc_exception_t(calc_error_t::UNEXPECTED_TOKEN, pos, "Unexpected operand");
 
   return state;
 }
@@ -252,6 +325,8 @@ void parser_t::clear() {
     gen.pop();
   while (!oper.empty())
     oper.pop();
+  while (!argcs.empty())
+    argcs.pop();
 }
 
 /**
@@ -260,8 +335,10 @@ void parser_t::clear() {
  * @return queue of tokens in RPN
  */
 token_queue_t& parser_t::parse(token_queue_t& tokens) {
+  trace_span_t span("parse", "pipeline");
   state_t state = state_t::STATE_OPERAND;
   std::unique_ptr<token_t> tok;
+  size_t pos = 0;
 
   clear();
 
@@ -269,6 +346,7 @@ token_queue_t& parser_t::parse(token_queue_t& tokens) {
   while (!tokens.empty()) {
     tok = std::move(tokens.front());
     tokens.pop();
+    pos = tok->pos;
 
     if (state == state_t::STATE_OPERAND) {
       state = processOperand(std::move(tok));
@@ -279,10 +357,10 @@ token_queue_t& parser_t::parse(token_queue_t& tokens) {
   }
 
   if (state == state_t::STATE_OPERAND)
-    throw std::exception("Unexpected end");
+    throw calc_exception_t(calc_error_t::UNEXPECTED_END, pos, "Unexpected end");
 
-  if(displacementUntilAnyOpenBracket())
-    throw std::exception("Missing a closing bracket");
+  if(displacementUntilAnyOpenBracket(pos))
+    throw calc_exception_t(calc_error_t::BRACKETS, pos, "Missing a closing bracket");
 
   // moving to the resulting queue
   while (!gen.empty()) {
@@ -293,6 +371,15 @@ token_queue_t& parser_t::parse(token_queue_t& tokens) {
   while (!oper.empty()) {
     tok = std::move(oper.top());
     oper.pop();
+
+    // variadic function without brackets takes one operand
+    if (tok->type == token_t::token_type_t::TOKEN_TYPE_OPERATION) {
+      token_operation_t* op = static_cast<token_operation_t*>(tok.get());
+      variadic_t* var = dynamic_cast<variadic_t*>(op->operation.get());
+
+      if (var)
+        op->operation = var->bind(1);
+    }
     qres.push(std::move(tok));
   }
 
@@ -2,6 +2,7 @@
 
 #include "include/variable.h"
 #include "include/operation.h"
+#include "builtin.h"
 
 /**
  * @brief Class which parse queue and transform it to rpn
@@ -11,6 +12,7 @@ private:
   token_queue_t qres;  ///< resulting queue with tokens in rpn
   token_stack_t gen;   ///< general stack with numbers and operations
   token_stack_t oper;  ///< intermediate stack with operation
+  std::stack<size_t> argcs;  ///< number of arguments separated so far in every open bracket
 
   /**
    * Possible states of parser
@@ -28,9 +30,10 @@ private:
 
   /**
    * Send operators from stack with operators to general stack until any open bracket
+   * @param[out] pos - position of the found open bracket
    * @return true if any open bracket was found
    */
-  bool displacementUntilAnyOpenBracket();
+  bool displacementUntilAnyOpenBracket(size_t& pos);
 
   /**
    * Send operators from stack with operators to general stack until open bracket with the same id
@@ -39,6 +42,21 @@ private:
    */
   bool displacementUntilOpenBracket(std::unique_ptr<token_t> op);
 
+  /**
+   * Send operators from stack with operators to general stack until any open bracket, which stays in place
+   * @warning throws calc_exception_t if there is no open bracket
+   * @param[in] pos - position of the separator
+   */
+  void displacementUntilSeparator(size_t pos);
+
+  /**
+   * Check the number of arguments of function whose brackets have just been closed, bind variadic function to it
+   * @warning throws calc_exception_t if the number of arguments doesn't match the function
+   * @param[in] argc - number of arguments in the brackets
+   * @param[in] pos - position of the closing bracket
+   */
+  void bindCall(size_t argc, size_t pos);
+
   /**
    * Check which of operators has higher priority
    * @param[in] op1 - first token
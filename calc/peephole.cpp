@@ -0,0 +1,183 @@
+#include <algorithm>
+#include "peephole.h"
+#include "trace.h"
+
+using kind_t = operation_t::operation_kind_t;
+using cls_t = peephole_t::class_t;
+using op_t = instr_t::opcode_t;
+
+/**
+ * Returns the static table of patterns, longer patterns first
+ * @return table of patterns
+ */
+std::vector<peephole_t::pattern_t> const& peephole_t::table() {
+  static std::vector<pattern_t> const patterns = {
+    { { cls_t::VARIABLE, cls_t::VARIABLE, cls_t::MUL }, op_t::MUL_VV },
+    { { cls_t::VARIABLE, cls_t::NUMBER, cls_t::MUL }, op_t::MUL_VC },
+    { { cls_t::NUMBER, cls_t::MUL, cls_t::ADD }, op_t::MUL_C_ADD },
+    { { cls_t::MUL, cls_t::ADD }, op_t::MUL_ADD },
+    { { cls_t::VARIABLE, cls_t::ADD }, op_t::ADD_V },
+    { { cls_t::VARIABLE, cls_t::MUL }, op_t::MUL_V },
+    { { cls_t::NUMBER, cls_t::ADD }, op_t::ADD_C },
+    { { cls_t::NUMBER, cls_t::SUB }, op_t::SUB_C },
+    { { cls_t::NUMBER, cls_t::MUL }, op_t::MUL_C },
+    { { cls_t::NUMBER, cls_t::DIV }, op_t::DIV_C },
+    { { cls_t::VARIABLE, cls_t::VARIABLE }, op_t::PUSH_VARIABLE2 }
+  };
+
+  return patterns;
+}
+
+/**
+ * Returns class of instruction
+ * @param[in] in - instruction
+ * @return class of instruction
+ */
+cls_t peephole_t::classify(instr_t const& in) noexcept {
+  switch (in.code) {
+    case op_t::PUSH_NUMBER:
+      return cls_t::NUMBER;
+    case op_t::PUSH_VARIABLE:
+      return cls_t::VARIABLE;
+    case op_t::CALL:
+      // superinstructions don't check operands, so calls with restricted domain are never fused
+      if (in.checked)
+        return cls_t::OTHER;
+      switch (in.operation->kind()) {
+        case kind_t::ADD:
+          return cls_t::ADD;
+        case kind_t::SUB:
+          return cls_t::SUB;
+        case kind_t::MUL:
+          return cls_t::MUL;
+        case kind_t::DIV:
+          return cls_t::DIV;
+        default:
+          return cls_t::OTHER;
+      }
+    default:
+      return cls_t::OTHER;
+  }
+}
+
+/**
+ * Check if the pattern matches the program at position
+ * @param[in] code - instructions
+ * @param[in] i - position
+ * @param[in] p - pattern
+ * @return true if the pattern matches
+ */
+bool peephole_t::matches(std::vector<instr_t> const& code, size_t i, pattern_t const& p) noexcept {
+  if (i + p.seq.size() > code.size())
+    return false;
+  for (size_t k = 0; k < p.seq.size(); ++k)
+    if (classify(code[i + k]) != p.seq[k])
+      return false;
+  return true;
+}
+
+/**
+ * Count patterns of the program
+ * @param[in] prog - compiled program
+ * @param[in] runs - how many times the program was calculated
+ */
+void peephole_t::profile_t::record(program_t const& prog, size_t runs) {
+  auto const& patterns = table();
+
+  for (size_t i = 0; i < prog.code.size(); ++i)
+    for (size_t p = 0; p < patterns.size(); ++p)
+      if (matches(prog.code, i, patterns[p]))
+        counts[p] += (patterns[p].seq.size() - 1) * runs;
+}
+
+/**
+ * Default constructor
+ */
+peephole_t::peephole_t() {
+  setProfile(nullptr);
+}
+
+/**
+ * Set profile which overrides the static order of patterns
+ * @param[in] profile - profile of real workloads, nullptr to use the static order
+ */
+void peephole_t::setProfile(profile_t const* profile) {
+  prof = profile;
+  order.resize(table().size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+
+  // patterns which saved more dispatches on real workloads are preferred, unseen ones are dropped
+  if (prof) {
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      return prof->weight(a) > prof->weight(b);
+    });
+    while (!order.empty() && prof->weight(order.back()) == 0)
+      order.pop_back();
+  }
+}
+
+/**
+ * Fill program_t::fused with superinstructions
+ * @param[in] prog - compiled program
+ * @param[out] prog - program with fused instructions
+ */
+void peephole_t::fuse(program_t& prog) {
+  trace_span_t span("fuse", "pipeline");
+  auto const& patterns = table();
+  std::vector<instr_t> const& code = prog.code;
+
+  prog.fused.clear();
+  if (prog.branches) {
+    // jump offsets count instructions of code, so conditional programs are not fused
+    rep.dispatchesBefore = rep.dispatchesAfter = code.size();
+    return;
+  }
+  for (size_t i = 0; i < code.size();) {
+    size_t p = patterns.size();
+
+    for (size_t cand : order) {
+      if (matches(code, i, patterns[cand])) {
+        p = cand;
+        break;
+      }
+    }
+
+    if (p == patterns.size()) {
+      prog.fused.push_back(code[i++]);
+      continue;
+    }
+
+    instr_t in = code[i];
+    in.code = patterns[p].fused;
+    switch (in.code) {
+      case op_t::MUL_VV:
+      case op_t::PUSH_VARIABLE2:
+        in.slot2 = code[i + 1].slot;
+        break;
+      case op_t::MUL_VC:
+        in.value = code[i + 1].value;
+        break;
+      case op_t::ADD_V:
+      case op_t::MUL_V:
+      case op_t::ADD_C:
+      case op_t::SUB_C:
+      case op_t::MUL_C:
+      case op_t::DIV_C:
+      case op_t::MUL_C_ADD:
+        in.pos = code[i + 1].pos; // position of the operation
+        break;
+      case op_t::MUL_ADD:
+        if (opts.contract)
+          in.code = op_t::FMA_ADD;
+        break;
+      default:
+        break;
+    }
+    prog.fused.push_back(in);
+    i += patterns[p].seq.size();
+  }
+
+  rep.dispatchesBefore = code.size();
+  rep.dispatchesAfter = prog.fused.size();
+}
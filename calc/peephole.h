@@ -0,0 +1,140 @@
+#pragma once
+
+#include <map>
+#include "program.h"
+
+/**
+ * @brief Class which fuses frequent instruction sequences of the program into superinstructions
+ */
+class peephole_t {
+public:
+  /**
+   * @brief Rewrites which are allowed
+   */
+  struct options_t {
+    bool contract = false;  ///< fuse multiplication and addition into fma with single rounding (changes rounding)
+  };
+
+  /**
+   * @brief Class of instruction which patterns are made of
+   */
+  enum class class_t {
+    NUMBER,
+    VARIABLE,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    OTHER
+  };
+
+  /**
+   * @brief Pattern of the static table
+   */
+  struct pattern_t {
+    std::vector<class_t> seq;   ///< sequence of instruction classes
+    instr_t::opcode_t fused;    ///< superinstruction which replaces the sequence
+  };
+
+  /**
+   * @brief Counts of table patterns met in the programs of real workloads
+   */
+  class profile_t {
+  private:
+    std::map<size_t, size_t> counts;  ///< number of dispatches saved by pattern index
+
+  public:
+    /**
+     * Count patterns of the program
+     * @param[in] prog - compiled program
+     * @param[in] runs - how many times the program was calculated
+     */
+    void record(program_t const& prog, size_t runs = 1);
+
+    /**
+     * Returns weight of the pattern
+     * @param[in] pattern - index of pattern in the static table
+     * @return number of dispatches which the pattern has saved on recorded workloads
+     */
+    size_t weight(size_t pattern) const noexcept {
+      auto ci = counts.find(pattern);
+      return ci == counts.end() ? 0 : ci->second;
+    }
+  };
+
+  /**
+   * @brief Statistics of the last fusion
+   */
+  struct report_t {
+    size_t dispatchesBefore = 0;  ///< number of instructions before fusion
+    size_t dispatchesAfter = 0;   ///< number of instructions after fusion
+  };
+
+private:
+  options_t opts;            ///< allowed rewrites
+  report_t rep;              ///< statistics of the last fusion
+  profile_t const* prof = nullptr;  ///< optional profile which reorders the table
+  std::vector<size_t> order; ///< indices of table patterns in order of preference
+
+  /**
+   * Returns class of instruction
+   * @param[in] in - instruction
+   * @return class of instruction
+   */
+  static class_t classify(instr_t const& in) noexcept;
+
+  /**
+   * Check if the pattern matches the program at position
+   * @param[in] code - instructions
+   * @param[in] i - position
+   * @param[in] p - pattern
+   * @return true if the pattern matches
+   */
+  static bool matches(std::vector<instr_t> const& code, size_t i, pattern_t const& p) noexcept;
+
+public:
+  /**
+   * Returns the static table of patterns, longer patterns first
+   * @return table of patterns
+   */
+  static std::vector<pattern_t> const& table();
+
+  /**
+   * Default constructor
+   */
+  peephole_t();
+
+  /**
+   * Set allowed rewrites
+   * @param[in] options - allowed rewrites
+   */
+  void setOptions(options_t const& options) {
+    opts = options;
+  }
+
+  /**
+   * Set profile which overrides the static order of patterns
+   * @param[in] profile - profile of real workloads, nullptr to use the static order
+   */
+  void setProfile(profile_t const* profile);
+
+  /**
+   * Returns statistics of the last fusion
+   * @return statistics
+   */
+  report_t const& report() const noexcept {
+    return rep;
+  }
+
+  /**
+   * Fill program_t::fused with superinstructions
+   * @param[in] prog - compiled program
+   * @param[out] prog - program with fused instructions
+   */
+  void fuse(program_t& prog);
+
+  /**
+   * Destructor
+   */
+  ~peephole_t() = default;
+};
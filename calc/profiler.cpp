@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <iomanip>
+#include <functional>
+#include "profiler.h"
+
+/**
+ * Swap heap entries and their positions
+ * @param[in] i, j - positions
+ */
+void space_saving_t::swap(size_t i, size_t j) {
+  std::swap(heap[i], heap[j]);
+  index[heap[i].key] = i;
+  index[heap[j].key] = j;
+}
+
+/**
+ * Restore the heap after the weight of entry has decreased or the entry was appended
+ * @param[in] i - position of entry
+ */
+void space_saving_t::siftUp(size_t i) {
+  while (i > 0 && heap[(i - 1) / 2].weight > heap[i].weight) {
+    swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/**
+ * Restore the heap after the weight of entry has increased
+ * @param[in] i - position of entry
+ */
+void space_saving_t::siftDown(size_t i) {
+  while (true) {
+    size_t least = i;
+
+    for (size_t c = 2 * i + 1; c <= 2 * i + 2 && c < heap.size(); ++c)
+      if (heap[c].weight < heap[least].weight)
+        least = c;
+    if (least == i)
+      return;
+    swap(i, least);
+    i = least;
+  }
+}
+
+/**
+ * Add weight to key
+ * @param[in] key - hash of expression
+ * @param[in] text - expression, copied only if the key is not tracked
+ * @param[in] weight - weight
+ */
+void space_saving_t::add(uint64_t key, std::string const& text, uint64_t weight) {
+  auto ii = index.find(key);
+
+  if (ii != index.end()) {
+    heap[ii->second].weight += weight;
+    siftDown(ii->second);
+    return;
+  }
+  if (capacity == 0)
+    return;
+
+  size_t len = std::min(text.size(), hot_profiler_t::maxText);
+
+  if (heap.size() < capacity) {
+    heap.push_back({ key, text.substr(0, len), weight, 0 });
+    index[key] = heap.size() - 1;
+    siftUp(heap.size() - 1);
+    return;
+  }
+
+  // the new key takes the place of the lightest one and inherits its weight as error
+  entry_t& e = heap.front();
+
+  index.erase(e.key);
+  e.key = key;
+  e.text.assign(text, 0, len);
+  e.error = e.weight;
+  e.weight += weight;
+  index[key] = 0;
+  siftDown(0);
+}
+
+/**
+ * Returns heaviest keys
+ * @param[in] k - number of keys
+ * @return keys from the heaviest
+ */
+std::vector<space_saving_t::entry_t> space_saving_t::top(size_t k) const {
+  std::vector<entry_t> res(heap);
+
+  k = std::min(k, res.size());
+  std::partial_sort(res.begin(), res.begin() + k, res.end(), [](entry_t const& a, entry_t const& b) {
+    return a.weight > b.weight;
+  });
+  res.resize(k);
+  return res;
+}
+
+/**
+ * Record call of expression
+ * @param[in] expression - string with expression
+ * @param[in] ns - evaluation time in nanoseconds
+ */
+void hot_profiler_t::record(std::string const& expression, uint64_t ns) {
+  // a collision of 64-bit hashes merges two expressions, which is negligible for a report
+  uint64_t key = std::hash<std::string>()(expression);
+
+  calls.add(key, expression, 1);
+  time.add(key, expression, ns);
+  ++totalCalls;
+  totalTime += ns;
+}
+
+/**
+ * Returns heaviest expressions
+ * @param[in] k - number of expressions in every list
+ * @return expressions by calls and by time
+ */
+hot_profiler_t::report_t hot_profiler_t::report(size_t k) const {
+  report_t res;
+
+  res.byCalls = calls.top(k);
+  res.byTime = time.top(k);
+  res.calls = totalCalls;
+  res.nanoseconds = totalTime;
+  return res;
+}
+
+/**
+ * Write heaviest expressions as text
+ * @param[in] out - stream
+ * @param[in] k - number of expressions in every list
+ */
+void hot_profiler_t::write(std::ostream& out, size_t k) const {
+  report_t rep = report(k);
+  auto share = [](uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+  };
+  // shares are written with fixed precision, the caller gets its stream back as it was
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+
+  out << "calls: " << rep.calls << ", time: " << rep.nanoseconds / 1000 << " us" << std::endl;
+  out << "by calls:" << std::endl;
+  for (auto& e : rep.byCalls)
+    out << std::setw(12) << e.weight << " (+-" << e.error << ") " << std::fixed << std::setprecision(1)
+        << std::setw(5) << share(e.weight, rep.calls) << "%  " << e.text << std::endl;
+  out << "by time, us:" << std::endl;
+  for (auto& e : rep.byTime)
+    out << std::setw(12) << e.weight / 1000 << " (+-" << e.error / 1000 << ") " << std::fixed << std::setprecision(1)
+        << std::setw(5) << share(e.weight, rep.nanoseconds) << "%  " << e.text << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+/**
+ * Write string as JSON string literal
+ * @param[in] out - stream
+ * @param[in] s - string
+ */
+static void quote(std::ostream& out, std::string const& s) {
+  static char const hex[] = "0123456789abcdef";
+
+  out << '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c < 0x20)
+      out << "\\u00" << hex[c >> 4] << hex[c & 15];
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+/**
+ * Write heaviest expressions as JSON
+ * @param[in] out - stream
+ * @param[in] k - number of expressions in every list
+ */
+void hot_profiler_t::writeJson(std::ostream& out, size_t k) const {
+  report_t rep = report(k);
+  auto list = [&out](char const* name, std::vector<space_saving_t::entry_t> const& entries) {
+    out << '"' << name << "\":[";
+    for (size_t i = 0; i < entries.size(); ++i) {
+      out << (i ? "," : "") << "{\"expression\":";
+      quote(out, entries[i].text);
+      out << ",\"weight\":" << entries[i].weight << ",\"error\":" << entries[i].error << '}';
+    }
+    out << ']';
+  };
+
+  out << "{\"calls\":" << rep.calls << ",\"nanoseconds\":" << rep.nanoseconds << ',';
+  list("byCalls", rep.byCalls);
+  out << ',';
+  list("byTime", rep.byTime);
+  out << '}' << std::endl;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * @brief Class of space-saving sketch which finds the heaviest keys of a stream in bounded memory
+ * @warning a key which is not tracked takes the place of the lightest one and inherits its weight as error,
+ * so the weight of a tracked key is overestimated by at most its error and every key heavier than
+ * total / capacity is tracked
+ */
+class space_saving_t {
+public:
+  /**
+   * @brief Tracked key
+   */
+  struct entry_t {
+    uint64_t key = 0;     ///< hash of expression
+    std::string text;     ///< expression, truncated
+    uint64_t weight = 0;  ///< estimated weight, never less than the true one
+    uint64_t error = 0;   ///< greatest overestimation of the weight
+  };
+
+private:
+  size_t capacity;                               ///< number of tracked keys
+  std::vector<entry_t> heap;                     ///< tracked keys, min-heap by weight
+  std::unordered_map<uint64_t, size_t> index;    ///< positions of keys in heap
+
+  /**
+   * Swap heap entries and their positions
+   * @param[in] i, j - positions
+   */
+  void swap(size_t i, size_t j);
+
+  /**
+   * Restore the heap after the weight of entry has decreased or the entry was appended
+   * @param[in] i - position of entry
+   */
+  void siftUp(size_t i);
+
+  /**
+   * Restore the heap after the weight of entry has increased
+   * @param[in] i - position of entry
+   */
+  void siftDown(size_t i);
+
+public:
+  /**
+   * Constructor
+   * @param[in] k - number of tracked keys
+   */
+  explicit space_saving_t(size_t k) : capacity(k) {}
+
+  /**
+   * Add weight to key
+   * @param[in] key - hash of expression
+   * @param[in] text - expression, copied only if the key is not tracked
+   * @param[in] weight - weight
+   */
+  void add(uint64_t key, std::string const& text, uint64_t weight);
+
+  /**
+   * Returns heaviest keys
+   * @param[in] k - number of keys
+   * @return keys from the heaviest
+   */
+  std::vector<entry_t> top(size_t k) const;
+
+  /**
+   * Forget all keys
+   */
+  void clear() noexcept {
+    heap.clear();
+    index.clear();
+  }
+};
+
+/**
+ * @brief Class which finds expressions dominating by calls and by evaluation time
+ */
+class hot_profiler_t {
+public:
+  /**
+   * @brief Heaviest expressions
+   */
+  struct report_t {
+    std::vector<space_saving_t::entry_t> byCalls;  ///< expressions from the most called, weight is calls
+    std::vector<space_saving_t::entry_t> byTime;   ///< expressions from the slowest in total, weight is nanoseconds
+    uint64_t calls = 0;                            ///< calls of all expressions
+    uint64_t nanoseconds = 0;                      ///< time of all calls
+  };
+
+  /**
+   * @brief Sample of one call which is recorded when it is destroyed, also when the call throws
+   */
+  class sample_t {
+  private:
+    hot_profiler_t* profiler;                       ///< profiler, nullptr if profiling is disabled
+    std::string const& expression;                  ///< expression being calculated
+    std::chrono::steady_clock::time_point start;    ///< start of call
+
+  public:
+    /**
+     * Constructor
+     * @param[in] p - profiler, nullptr if profiling is disabled
+     * @param[in] e - expression being calculated, it must outlive the sample
+     */
+    sample_t(hot_profiler_t* p, std::string const& e) : profiler(p), expression(e) {
+      if (profiler)
+        start = std::chrono::steady_clock::now();
+    }
+
+    sample_t(sample_t const&) = delete;
+    sample_t& operator=(sample_t const&) = delete;
+
+    /**
+     * Destructor, records the call
+     */
+    ~sample_t() {
+      if (profiler)
+        profiler->record(expression, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count()));
+    }
+  };
+
+  static constexpr size_t maxText = 256;  ///< longer expressions are truncated in reports, but counted apart
+
+private:
+  space_saving_t calls;      ///< sketch weighted by calls
+  space_saving_t time;       ///< sketch weighted by nanoseconds
+  uint64_t totalCalls = 0;   ///< calls of all expressions
+  uint64_t totalTime = 0;    ///< time of all calls
+
+public:
+  /**
+   * Constructor
+   * @param[in] k - number of expressions tracked by every sketch, memory is O(k * maxText)
+   */
+  explicit hot_profiler_t(size_t k) : calls(k), time(k) {}
+
+  /**
+   * Record call of expression
+   * @param[in] expression - string with expression
+   * @param[in] ns - evaluation time in nanoseconds
+   */
+  void record(std::string const& expression, uint64_t ns);
+
+  /**
+   * Returns heaviest expressions
+   * @param[in] k - number of expressions in every list
+   * @return expressions by calls and by time
+   */
+  report_t report(size_t k) const;
+
+  /**
+   * Write heaviest expressions as text
+   * @param[in] out - stream
+   * @param[in] k - number of expressions in every list
+   */
+  void write(std::ostream& out, size_t k) const;
+
+  /**
+   * Write heaviest expressions as JSON
+   * @param[in] out - stream
+   * @param[in] k - number of expressions in every list
+   */
+  void writeJson(std::ostream& out, size_t k) const;
+
+  /**
+   * Forget all expressions
+   */
+  void clear() noexcept {
+    calls.clear();
+    time.clear();
+    totalCalls = totalTime = 0;
+  }
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <vector>
+#include "include/operation.h"
+#include "include/variable.h"
+#include "error.h"
+
+/**
+ * @brief Instruction of the compiled program
+ */
+struct instr_t {
+  /**
+   * @brief Possible instructions
+   */
+  enum class opcode_t {
+    PUSH_NUMBER,     ///< push value
+    PUSH_VARIABLE,   ///< push value of variable from slot
+    CALL,            ///< replace arity operands on top of the stack with result of operation
+    UPDATE,          ///< the same for stateful operation with the state from slot
+    // superinstructions, they appear only in program_t::fused
+    PUSH_VARIABLE2,  ///< push values of variables from slot and slot2
+    MUL_VV,          ///< push product of variables from slot and slot2
+    MUL_VC,          ///< push product of variable from slot and value
+    ADD_V,           ///< add variable from slot to the top
+    MUL_V,           ///< multiply the top by variable from slot
+    ADD_C,           ///< add value to the top
+    SUB_C,           ///< subtract value from the top
+    MUL_C,           ///< multiply the top by value
+    DIV_C,           ///< divide the top by value
+    MUL_ADD,         ///< replace c, a, b on the top with c + a * b
+    FMA_ADD,         ///< replace c, a, b on the top with fma(a, b, c)
+    MUL_C_ADD,       ///< replace x, y on the top with x + y * value
+    // control flow, offsets are relative to the instruction
+    JUMP_IF_FALSE,   ///< pop condition, go slot ahead if it is zero, keep it and go slot2 ahead if it is NaN
+    JUMP,            ///< go slot ahead
+    // formula sets, they appear only in multi_program_t
+    STORE,           ///< copy the top into temporary from slot
+    LOAD,            ///< push temporary from slot
+    OUTPUT           ///< pop the top into result from slot
+  };
+
+  opcode_t code;                     ///< instruction
+  double value = 0;                  ///< number for PUSH_NUMBER
+  size_t slot = 0;                   ///< variable slot for PUSH_VARIABLE
+  size_t slot2 = 0;                  ///< second variable slot for superinstructions
+  size_t arity = 0;                  ///< number of operands for CALL and UPDATE
+  operation_t* operation = nullptr;  ///< operation for CALL and UPDATE
+  size_t pos = 0;                    ///< position in expression
+  bool checked = false;              ///< operands of CALL and UPDATE are checked by inDomain before the operation
+};
+
+/**
+ * @brief Program compiled from rpn queue whose stack usage was verified in advance
+ * @see compiler_t
+ */
+class program_t {
+public:
+  static constexpr size_t noFault = static_cast<size_t>(-1);  ///< position of the rows without domain error
+
+  std::vector<instr_t> code;                          ///< instructions
+  std::vector<instr_t> fused;                         ///< the same instructions with superinstructions, empty if not fused
+  std::vector<std::shared_ptr<variable_t>> vars;      ///< variables referred by slot
+  std::vector<std::shared_ptr<operation_t>> ops;      ///< operations kept alive while program exists
+  size_t maxDepth = 0;                                ///< maximal depth of operand stack
+  bool branches = false;                              ///< true if the program has jump instructions
+  std::vector<std::unique_ptr<state_t>> states;       ///< states of stateful operations referred by slot
+
+  /**
+   * Check that all variables of the program are initialized
+   * @param[out] slot - slot of the first uninitialized variable
+   * @return true if all variables are initialized
+   */
+  bool tryBind(size_t& slot) noexcept {
+    if (bound)
+      return true;
+    for (slot = 0; slot < vars.size(); ++slot)
+      if (!vars[slot]->isInit())
+        return false;
+    bound = true; // variables can't lose the value once set
+    return true;
+  }
+
+  /**
+   * Check that all variables of the program are initialized
+   * @warning throws calc_exception_t if any variable is uninitialized
+   */
+  void bind() {
+    size_t slot;
+
+    if (!tryBind(slot))
+      throw calc_exception_t(calc_error_t::UNINITIALIZED_VARIABLE, position(slot), "Uninitialized variable");
+  }
+
+  /**
+   * Refer slot to another variable, e.g. when the program is shared by expressions which differ by names
+   * @param[in] slot - slot of variable
+   * @param[in] var - variable
+   */
+  void rebind(size_t slot, std::shared_ptr<variable_t> const& var) {
+    if (vars[slot] != var) {
+      vars[slot] = var;
+      bound = false;
+    }
+  }
+
+  /**
+   * Start the evaluation context anew, stateful operations forget their samples
+   */
+  void reset() {
+    for (auto& st : states)
+      st->reset();
+  }
+
+  /**
+   * Returns position of the first use of variable in expression
+   * @param[in] slot - slot of variable
+   * @return position in expression
+   */
+  size_t position(size_t slot) const noexcept {
+    for (instr_t const& in : code)
+      if (in.code == instr_t::opcode_t::PUSH_VARIABLE && in.slot == slot)
+        return in.pos;
+    return 0;
+  }
+
+  /**
+   * Merge both evaluated branches of conditionals without branching, as block evaluators run both of them
+   * @param[in] c - conditions
+   * @param[in] a - values of c ? a : b for true conditions
+   * @param[out] a - results, NaN where the condition is NaN
+   * @param[in] b - values for false conditions
+   * @param[in] n - number of rows
+   */
+  template <typename number_t>
+  static void select(number_t const* c, number_t* a, number_t const* b, size_t n) noexcept {
+    for (size_t i = 0; i < n; ++i) {
+      double v = static_cast<double>(c[i]);
+
+      a[i] = v != v ? c[i] : v != 0 ? a[i] : b[i];
+    }
+  }
+
+  /**
+   * Find rows which take the branches of all conditionals being evaluated at the instruction,
+   * so that stateful operations of block evaluators take no samples from branches which are not taken
+   * and domain errors are reported only for the taken ones
+   * @param[in] conds - conditions of the conditionals being evaluated, stride values per nesting level
+   * @param[in] elses - indices of the first instructions of the second branches of the conditionals
+   * @param[in] i - index of instruction
+   * @param[in] stride - distance between conditions of adjacent nesting levels
+   * @param[in] n - number of rows
+   * @param[out] rows - indices of rows which take the branches in ascending order
+   * @param[in] faults - positions of domain errors by row, rows with an error have stopped, nullptr if there are none
+   */
+  template <typename number_t>
+  static void taken(number_t const* conds, std::vector<size_t> const& elses, size_t i, size_t stride, size_t n,
+                    std::vector<size_t>& rows, size_t const* faults = nullptr) {
+    rows.clear();
+    for (size_t r = 0; r < n; ++r) {
+      bool on = !faults || faults[r] == noFault;
+
+      for (size_t l = 0; on && l < elses.size(); ++l) {
+        double v = static_cast<double>(conds[l * stride + r]);
+
+        on = v == v && (v != 0) == (i < elses[l]);
+      }
+      if (on)
+        rows.push_back(r);
+    }
+  }
+
+  /**
+   * Check operands of the rows against the domain of operation, as a single row evaluation stops at its first error
+   * @param[in] in - CALL or UPDATE instruction with checked operands
+   * @param[in] top - first operand array, others follow with stride
+   * @param[in] stride - distance between operand arrays
+   * @param[in] rows - indices of rows which take the instruction
+   * @param[in] args - buffer for operands of a row
+   * @param[out] faults - position of the instruction for rows outside the domain
+   * @return true if any row is outside the domain
+   */
+  template <typename number_t>
+  static bool check(instr_t const& in, number_t const* top, size_t stride, std::vector<size_t> const& rows,
+                    std::vector<double>& args, size_t* faults) {
+    bool any = false;
+
+    args.resize(in.arity);
+    for (size_t r : rows) {
+      for (size_t k = 0; k < in.arity; ++k)
+        args[k] = static_cast<double>(top[k * stride + r]);
+      if (!in.operation->inDomain(args.data())) {
+        faults[r] = in.pos;
+        any = true;
+      }
+    }
+    return any;
+  }
+
+  /**
+   * Check that evaluation of the program has no effect besides its result
+   * @warning well known arithmetic operations are pure even if they don't declare it
+   * @return true if the program has no stateful operations and no operations which may be impure
+   */
+  bool isPure() const noexcept {
+    if (!states.empty())
+      return false;
+    for (instr_t const& in : code)
+      if (in.code == instr_t::opcode_t::CALL && !in.operation->isPure() &&
+            in.operation->kind() == operation_t::operation_kind_t::GENERIC)
+        return false;
+    return true;
+  }
+
+  /**
+   * Returns the binding state of the program
+   * @return true if all variables are known to be initialized
+   */
+  bool isBound() const noexcept {
+    return bound;
+  }
+
+private:
+  bool bound = false;  ///< true if all variables are known to be initialized
+};
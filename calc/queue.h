@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/**
+ * @brief Class of bounded lock-free queue for many producers and many consumers
+ * @warning every cell has a sequence number which tells whether it waits for a push or a pop, a thread claims
+ * its position by one compare-and-swap, pop reports empty queue while the claimed element is being written
+ */
+template <typename T>
+class mpmc_queue_t {
+private:
+  /**
+   * @brief Cell of ring buffer
+   */
+  struct cell_t {
+    std::atomic<size_t> seq;  ///< position of push which the cell waits for, the position + 1 when it waits for pop
+    T value;                  ///< element
+  };
+
+  static size_t const line = 64;  ///< size of cache line, positions of producers and consumers are kept apart
+
+  std::unique_ptr<cell_t[]> cells;             ///< ring buffer
+  size_t mask;                                 ///< capacity - 1, capacity is a power of two
+  alignas(line) std::atomic<size_t> head{0};   ///< position of the next push
+  alignas(line) std::atomic<size_t> tail{0};   ///< position of the next pop
+
+public:
+  /**
+   * Constructor
+   * @param[in] capacity - least number of elements the queue holds, rounded up to a power of two
+   */
+  explicit mpmc_queue_t(size_t capacity) {
+    size_t n = 2;
+
+    while (n < capacity)
+      n <<= 1;
+    cells.reset(new cell_t[n]);
+    mask = n - 1;
+    for (size_t i = 0; i < n; ++i)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  mpmc_queue_t(mpmc_queue_t const&) = delete;
+  mpmc_queue_t& operator=(mpmc_queue_t const&) = delete;
+
+  /**
+   * Add element to the tail
+   * @param[in] value - element
+   * @return false if the queue is full
+   */
+  bool push(T const& value) noexcept {
+    size_t pos = head.load(std::memory_order_relaxed);
+
+    while (true) {
+      cell_t& cell = cells[pos & mask];
+      intptr_t dif = static_cast<intptr_t>(cell.seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+
+      if (dif == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (dif < 0)
+        return false; // the cell still holds the element pushed one lap ago
+      else
+        pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Take element from the head
+   * @param[out] value - element
+   * @return false if the queue is empty
+   */
+  bool pop(T& value) noexcept {
+    size_t pos = tail.load(std::memory_order_relaxed);
+
+    while (true) {
+      cell_t& cell = cells[pos & mask];
+      intptr_t dif = static_cast<intptr_t>(cell.seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1);
+
+      if (dif == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.seq.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (dif < 0)
+        return false;
+      else
+        pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Destructor
+   */
+  ~mpmc_queue_t() = default;
+};
@@ -1,4 +1,6 @@
 #include "scanner.h"
+#include "error.h"
+#include "trace.h"
 
 /**
  * Clear the queue of tokens
@@ -20,7 +22,7 @@ void scanner_t::clearQueue() {
  * @return state after processing (true if last token was number, variable or postfix operation)
  */
 bool scanner_t::processName(std::string const& expression, size_t& index, ops_maps const& ops,
-                              cv_map const& cv, vars_map& vars) {
+                              cv_map const& cv, var_storage_t& vars) {
   size_t start = index;
   std::string name;
 
@@ -32,22 +34,20 @@ bool scanner_t::processName(std::string const& expression, size_t& index, ops_ma
   auto fi = ops.funcs.find(name); // attempt to process as a function name
   if (fi != ops.funcs.end()) {
     tokens.push(std::unique_ptr<token_t>(new token_operation_t(fi->second)));
+    tokens.back()->pos = start;
     return false;
   }
 
   auto ci = cv.find(name); // attempt to process as a constant name
   if (ci != cv.end()) {
     tokens.push(std::unique_ptr<token_t>(new token_number_t(ci->second)));
+    tokens.back()->pos = start;
     return true;
   }
 
-  auto vi = vars.find(name); // treat as a variable name
-  if (vi != vars.end())
-    tokens.push(std::unique_ptr<token_t>(new token_variable_t(vi->second)));
-  else { // there is no variable with this name
-    vars.insert(std::make_pair(name, std::shared_ptr<variable_t>(new variable_t)));
-    tokens.push(std::unique_ptr<token_t>(new token_variable_t(vars[name])));
-  }
+  // treat as a variable name, it is created if there is no variable with this name
+  tokens.push(std::unique_ptr<token_t>(new token_variable_t(vars.obtain(name, start))));
+  tokens.back()->pos = start;
   return true;
 }
 
@@ -79,11 +79,12 @@ bool scanner_t::processOperators(std::string const& expression, size_t& index, o
 
     if (start == end) { // prefix operation not found
       err += expression.substr(start, index - start);
-      throw(std::exception(err.c_str()));
+      throw(calc_exception_t(calc_error_t::UNKNOWN_OPERATION, start, err.c_str()));
     }
     else { // adding the token
       auto poi = ops.pref.find(expression.substr(start, end - start));
       tokens.push(std::unique_ptr<token_t>(new token_operation_t(poi->second)));
+      tokens.back()->pos = start;
       index = end;
     }
   }
@@ -107,7 +108,7 @@ bool scanner_t::processOperators(std::string const& expression, size_t& index, o
 
     if (start == end) { // infix or postfix operation not found
       err += expression.substr(start, index - start);
-      throw(std::exception(err.c_str()));
+      throw(calc_exception_t(calc_error_t::UNKNOWN_OPERATION, start, err.c_str()));
     }
     else {
       if (isAfterNum) { // adding the token with postfix operation
@@ -118,6 +119,7 @@ bool scanner_t::processOperators(std::string const& expression, size_t& index, o
         auto ioi = ops.inf.find(expression.substr(start, end - start));
         tokens.push(std::unique_ptr<token_t>(new token_operation_t(ioi->second)));
       }
+      tokens.back()->pos = start;
       index = end;
     }
   }
@@ -135,7 +137,9 @@ bool scanner_t::processOperators(std::string const& expression, size_t& index, o
  * @return queue of tokens
  */
 token_queue_t& scanner_t::scan(std::string const& expression, ops_maps const& ops,
-                                 cv_map const& cv, vars_map& vars) {
+                                 cv_map const& cv, var_storage_t& vars) {
+  trace_span_t span("scan", "pipeline");
+
   if (tokens.size() != 0)
     clearQueue();
 
@@ -149,14 +153,26 @@ token_queue_t& scanner_t::scan(std::string const& expression, ops_maps const& op
     else if (expression[index] == '.' || isdigit(expression[index])) { // process a number
       double val = 0;
       std::string::size_type shift;
-      val = std::stod(expression.substr(index), &shift);
+      try {
+        val = std::stod(expression.substr(index), &shift);
+      }
+      catch (std::exception&) { // a lone point or a number out of range
+        throw calc_exception_t(calc_error_t::SYNTAX, index, "Incorrect number");
+      }
       tokens.push(std::unique_ptr<token_t>(new token_number_t(val)));
+      tokens.back()->pos = index;
       index += shift;
       isAfterNum = true;
     }
     else if (expression[index] == '_' || isalpha(expression[index])) { // process a name
       isAfterNum = processName(expression, index, ops, cv, vars);
     }
+    else if (expression[index] == ',') { // process a separator of function arguments
+      tokens.push(std::unique_ptr<token_t>(new token_operation_t(separator)));
+      tokens.back()->pos = index;
+      ++index;
+      isAfterNum = false;
+    }
     else {
       isAfterNum = processOperators(expression, index, ops, isAfterNum); // process a designation
     }
@@ -2,6 +2,8 @@
 
 #include "include/variable.h"
 #include "include/operation.h"
+#include "builtin.h"
+#include "storage.h"
 
 /**
  * @brief Class that splits an expression string into tokens
@@ -9,6 +11,7 @@
 class scanner_t {
 private:
   token_queue_t tokens; ///< resulting queue of tokens
+  std::shared_ptr<separator_t> separator = std::make_shared<separator_t>(); ///< separator of function arguments
 
   /**
    * Process name of function, named const value or variables
@@ -22,7 +25,7 @@ private:
    * @return state after processing (true if last token was number, variable or postfix operation)
    */
   bool processName(std::string const& expression, size_t& index, ops_maps const& ops,
-                     cv_map const& cv, vars_map& vars);
+                     cv_map const& cv, var_storage_t& vars);
 
   /**
    * Process designation of operators
@@ -55,7 +58,7 @@ public:
    * @param[out] vars - augmented map of variables
    * @return queue of tokens
    */
-  token_queue_t& scan(std::string const& expression, ops_maps const& ops, cv_map const& cv, vars_map& vars);
+  token_queue_t& scan(std::string const& expression, ops_maps const& ops, cv_map const& cv, var_storage_t& vars);
 
   /**
    * Destructor
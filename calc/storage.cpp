@@ -0,0 +1,103 @@
+#include "storage.h"
+
+/**
+ * Returns estimated heap memory of variable
+ * @param[in] name - name of variable
+ * @return bytes
+ */
+size_t var_storage_t::footprint(std::string const& name) noexcept {
+  // tree node with colour and three links, variable with its reference counters, long names are allocated apart
+  size_t node = sizeof(vars_map::value_type) + 4 * sizeof(void*);
+  size_t var = sizeof(variable_t) + 2 * sizeof(long) + sizeof(void*);
+
+  return node + var + (name.size() >= sizeof(std::string) ? name.size() + 1 : 0);
+}
+
+/**
+ * Constructor from variables which are shared with another storage, no limits are set
+ * @param[in] v - variables
+ */
+var_storage_t::var_storage_t(vars_map const& v) : vars(v) {
+  for (auto& var : vars)
+    st.bytes += footprint(var.first);
+  st.live = vars.size();
+}
+
+/**
+ * Remove variable
+ * @param[in] vi - variable
+ * @return next variable
+ */
+vars_map::const_iterator var_storage_t::erase(vars_map::const_iterator vi) {
+  st.bytes -= footprint(vi->first);
+  --st.live;
+  ++st.reclaimed;
+  return vars.erase(vi);
+}
+
+/**
+ * Close the scope and all scopes opened after it
+ * @param[in] depth - number of scopes opened before the scope
+ */
+void var_storage_t::close(size_t depth) {
+  while (scopes.size() > depth) {
+    for (auto& name : scopes.back()) {
+      auto vi = vars.find(name);
+
+      // the name may have been collected meanwhile
+      if (vi != vars.end())
+        erase(vi);
+    }
+    scopes.pop_back();
+    ++st.closed;
+  }
+}
+
+/**
+ * Find variable, create it if it is absent
+ * @warning throws calc_exception_t if a new variable exceeds the limits even after collection
+ * @param[in] name - name of variable
+ * @param[in] pos - position of the name in expression for the error
+ * @return variable
+ */
+std::shared_ptr<variable_t> const& var_storage_t::obtain(std::string const& name, size_t pos) {
+  auto vi = vars.find(name);
+
+  if (vi != vars.end())
+    return vi->second;
+
+  size_t bytes = footprint(name);
+
+  if (st.live + 1 > lim.variables || st.bytes + bytes > lim.bytes) {
+    collect();
+    if (st.live + 1 > lim.variables || st.bytes + bytes > lim.bytes)
+      throw calc_exception_t(calc_error_t::STORAGE_LIMIT, pos, "Variable storage is full");
+  }
+
+  vi = vars.insert(std::make_pair(name, std::shared_ptr<variable_t>(new variable_t))).first;
+  st.bytes += bytes;
+  ++st.live;
+  ++st.created;
+  if (!scopes.empty())
+    scopes.back().push_back(name);
+  return vi->second;
+}
+
+/**
+ * Remove uninitialized variables which no compiled program refers to, e.g. names of mistyped expressions
+ * @warning variables with values stay until their scope closes, as their values can't be restored
+ * @return number of removed variables
+ */
+size_t var_storage_t::collect() {
+  size_t n = 0;
+
+  for (auto vi = vars.cbegin(); vi != vars.cend();) {
+    if (vi->second.use_count() == 1 && !vi->second->isInit()) {
+      vi = erase(vi);
+      ++n;
+    }
+    else
+      ++vi;
+  }
+  return n;
+}
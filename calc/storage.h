@@ -0,0 +1,201 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "include/variable.h"
+#include "error.h"
+
+/**
+ * @brief Counters of variable storage
+ */
+struct var_stats_t {
+  size_t live = 0;         ///< variables in the storage
+  size_t bytes = 0;        ///< estimated heap memory of the variables in the storage
+  uint64_t created = 0;    ///< variables created since the storage was made
+  uint64_t reclaimed = 0;  ///< variables removed by collection or by closing their scope
+  uint64_t closed = 0;     ///< scopes closed, their variables may be referred by programs
+};
+
+/**
+ * @brief Class of the storage of variables with limits and scopes
+ * @warning compiled programs share the ownership of their variables, so a variable which was removed from
+ * the storage stays alive while some program refers to it, but its name refers to a new variable then
+ */
+class var_storage_t {
+public:
+  /**
+   * @brief Limits of storage, creation of variable fails when it exceeds them and collection does not help
+   */
+  struct limits_t {
+    size_t variables = SIZE_MAX;  ///< number of variables
+    size_t bytes = SIZE_MAX;      ///< estimated heap memory
+  };
+
+  /**
+   * @brief Scope of variables, the variables created while it is the innermost open scope are removed when it closes
+   * @warning the scope must not outlive the storage, closing outer scope closes inner ones too
+   */
+  class scope_t {
+  private:
+    var_storage_t* storage;  ///< storage, nullptr if the scope is closed
+    size_t depth;            ///< number of scopes opened before this one
+
+  public:
+    /**
+     * Constructor
+     * @param[in] s - storage
+     * @param[in] d - number of scopes opened before this one
+     */
+    scope_t(var_storage_t* s, size_t d) noexcept : storage(s), depth(d) {}
+
+    scope_t(scope_t const&) = delete;
+    scope_t& operator=(scope_t const&) = delete;
+
+    /**
+     * Move constructor
+     * @param[in] other - scope which becomes closed
+     */
+    scope_t(scope_t&& other) noexcept : storage(other.storage), depth(other.depth) {
+      other.storage = nullptr;
+    }
+
+    /**
+     * Remove the variables created in the scope
+     */
+    void close() {
+      if (storage)
+        storage->close(depth);
+      storage = nullptr;
+    }
+
+    /**
+     * Destructor
+     */
+    ~scope_t() {
+      close();
+    }
+  };
+
+private:
+  vars_map vars;                               ///< variables by name
+  limits_t lim;                                ///< limits
+  var_stats_t st;                              ///< counters
+  std::vector<std::vector<std::string>> scopes;  ///< names of variables created in every open scope
+
+  /**
+   * Returns estimated heap memory of variable
+   * @param[in] name - name of variable
+   * @return bytes
+   */
+  static size_t footprint(std::string const& name) noexcept;
+
+  /**
+   * Remove variable
+   * @param[in] vi - variable
+   * @return next variable
+   */
+  vars_map::const_iterator erase(vars_map::const_iterator vi);
+
+  /**
+   * Close the scope and all scopes opened after it
+   * @param[in] depth - number of scopes opened before the scope
+   */
+  void close(size_t depth);
+
+public:
+  /**
+   * Default constructor
+   */
+  var_storage_t() = default;
+
+  /**
+   * Constructor from variables which are shared with another storage, no limits are set
+   * @param[in] v - variables
+   */
+  explicit var_storage_t(vars_map const& v);
+
+  var_storage_t(var_storage_t const&) = delete;
+  var_storage_t& operator=(var_storage_t const&) = delete;
+
+  /**
+   * Set limits, the storage which already exceeds them keeps its variables
+   * @param[in] limits - limits
+   */
+  void setLimits(limits_t const& limits) noexcept {
+    lim = limits;
+  }
+
+  /**
+   * Find variable, create it if it is absent
+   * @warning throws calc_exception_t if a new variable exceeds the limits even after collection
+   * @param[in] name - name of variable
+   * @param[in] pos - position of the name in expression for the error
+   * @return variable
+   */
+  std::shared_ptr<variable_t> const& obtain(std::string const& name, size_t pos = 0);
+
+  /**
+   * Find variable
+   * @param[in] name - name of variable
+   * @return iterator of variable or end()
+   */
+  vars_map::const_iterator find(std::string const& name) const {
+    return vars.find(name);
+  }
+
+  /**
+   * Returns iterators of variables by name
+   * @return iterator
+   */
+  vars_map::const_iterator begin() const noexcept {
+    return vars.begin();
+  }
+  vars_map::const_iterator end() const noexcept {
+    return vars.end();
+  }
+
+  /**
+   * Returns all variables
+   * @return variables by name
+   */
+  vars_map const& map() const noexcept {
+    return vars;
+  }
+
+  /**
+   * Open scope for the variables which will be created
+   * @return scope which removes them when it is closed or destroyed
+   */
+  scope_t scope() {
+    scopes.emplace_back();
+    return scope_t(this, scopes.size() - 1);
+  }
+
+  /**
+   * Remove uninitialized variables which no compiled program refers to, e.g. names of mistyped expressions
+   * @warning variables with values stay until their scope closes, as their values can't be restored
+   * @return number of removed variables
+   */
+  size_t collect();
+
+  /**
+   * Check if a new variable would exceed the limits
+   * @return true if the storage has reached its limits
+   */
+  bool full() const noexcept {
+    return st.live >= lim.variables || st.bytes >= lim.bytes;
+  }
+
+  /**
+   * Returns counters
+   * @return counters
+   */
+  var_stats_t const& stats() const noexcept {
+    return st;
+  }
+
+  /**
+   * Destructor
+   */
+  ~var_storage_t() = default;
+};
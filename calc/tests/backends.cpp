@@ -0,0 +1,140 @@
+#include "check.h"
+
+using backend_t = str_calc_t::backend_t;
+using precision_t = str_calc_t::precision_t;
+
+CHECK_CASE(valuesOnEveryBackend) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 3);
+  calc.setVariable("y", -0.5);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    for (precision_t pr : allPrecisions) {
+      double tol = tolerance(pr);
+
+      calc.setPrecision(pr);
+      CHECK_NEAR(calc, "1 + 2 * 3", 7, tol);
+      CHECK_NEAR(calc, "(1 + 2) * (3 - 4) / 2", -1.5, tol);
+      CHECK_NEAR(calc, "-x + 10", 7, tol);
+      CHECK_NEAR(calc, "x * x + 2 * x + 1", 16, tol);
+      CHECK_NEAR(calc, "2 ^ 10", 1024, tol);
+      CHECK_NEAR(calc, "x ^ -2", 1.0 / 9, tol);
+      CHECK_NEAR(calc, "x ^ 0.5", std::sqrt(3.0), tol);
+      CHECK_NEAR(calc, "sin(pi / 2) + cos(0)", 2, tol);
+      CHECK_NEAR(calc, "hypot(x, 4)", 5, tol);
+      CHECK_NEAR(calc, "max(1, x, y) + min(1, x, y) + mean(1, 2, 3) + sum(x, y)", 7, tol);
+      CHECK_NEAR(calc, "x > 2 ? 10 : 20", 10, tol);
+      CHECK_NEAR(calc, "y >= 0 ? x ^ y : -x", -3, tol);
+      CHECK_NEAR(calc, "msum(x, 3) + mavg(y, 2) + ema(x, 0.5)", 5.5, tol);
+    }
+  }
+}
+
+CHECK_CASE(errorsOnEveryBackend) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 3);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    for (precision_t pr : allPrecisions) {
+      calc.setPrecision(pr);
+      CHECK_ERROR(calc, "1 +", calc_error_t::UNEXPECTED_END, 2);
+      CHECK_ERROR(calc, "(1 + 2", calc_error_t::BRACKETS, 0);
+      CHECK_ERROR(calc, "1 + 2)", calc_error_t::BRACKETS, 5);
+      CHECK_ERROR(calc, "foo(1)", calc_error_t::UNKNOWN_OPERATION, 3);
+    }
+  }
+}
+
+CHECK_CASE(stringsStartWithoutHistory) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 2);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    for (int k = 0; k < 3; ++k)
+      CHECK_VALUE(calc, "msum(x, 3) + mmax(x, 2)", 4);
+  }
+}
+
+CHECK_CASE(programsContinueHistory) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 1);
+
+  program_t prog = calc.compile("msum(x, 3)");
+  double sums[] = { 1, 3, 6, 9, 12 };
+
+  for (int k = 0; k < 5; ++k) {
+    calc.setVariable("x", k + 1);
+    CHECK(calc.calculate(prog) == sums[k]);
+  }
+}
+
+CHECK_CASE(batchOnEveryPrecision) {
+  str_calc_t calc;
+  std::map<std::string, std::vector<double>> columns = { { "x", { 1, 2, 3, -1 } } };
+
+  calc.setVariable("y", 10);
+  for (precision_t pr : allPrecisions) {
+    double tol = tolerance(pr);
+    std::vector<double> results;
+    std::vector<uint64_t> validity;
+
+    calc.setPrecision(pr);
+
+    calc_result_t res = calc.calculateBatch("x * x + y", columns, 4, results, validity);
+    double squares[] = { 11, 14, 19, 11 };
+
+    CHECK(res && res.value == 4 && validity[0] == 15);
+    for (size_t r = 0; r < 4; ++r)
+      CHECK(agrees(results[r], squares[r], tol));
+
+    res = calc.calculateBatch(std::vector<std::string>{ "x + y", "x * y", "x / 2" }, columns, 4, results);
+    double merged[] = { 11, 12, 13, 9, 10, 20, 30, -10, 0.5, 1, 1.5, -0.5 };
+
+    CHECK(res && res.value == 3);
+    for (size_t r = 0; r < 12; ++r)
+      CHECK(agrees(results[r], merged[r], tol));
+
+    res = calc.calculateBatch("x + z", columns, 4, results, validity);
+    CHECK(res.error == calc_error_t::UNINITIALIZED_VARIABLE && res.position == 4);
+    res = calc.calculateBatch("x + y", columns, 5, results, validity);
+    CHECK(res.error == calc_error_t::BAD_INPUT);
+  }
+}
+
+CHECK_CASE(registerMachineLimits) {
+  str_calc_t calc;
+  std::string many = "sum(x";
+
+  // operands of the call exceed the fields of register machine instruction
+  for (int k = 1; k < 70000; ++k)
+    many += ", x";
+  many += ")";
+  calc.setVariable("x", 0.5);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    CHECK_VALUE(calc, many, 35000);
+  }
+}
+
+CHECK_CASE(registerProgramsFollowVariables) {
+  str_calc_t calc;
+
+  calc.setBackend(backend_t::BACKEND_REGISTER);
+  calc.setVariable("x", 2);
+  CHECK_VALUE(calc, "x * x + 1", 5);
+  calc.setVariable("x", 3);
+  CHECK_VALUE(calc, "x * x + 1", 10);
+  CHECK_VALUE(calc, "msum(x, 2)", 3);
+  {
+    var_storage_t::scope_t scope = calc.openScope();
+
+    calc.setVariable("w", 4);
+    CHECK_VALUE(calc, "w + x", 7);
+  }
+  // the name refers to a new variable after the scope is closed
+  CHECK_ERROR(calc, "w + x", calc_error_t::UNINITIALIZED_VARIABLE, 0);
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "../getResult.h"
+
+/**
+ * @brief Registry of regression cases, every case registers itself before main
+ */
+class check_registry_t {
+public:
+  /**
+   * @brief Regression case
+   */
+  struct case_t {
+    char const* name;  ///< name of case
+    void (*body)();    ///< checks of case
+  };
+
+  std::vector<case_t> cases;  ///< registered cases
+  size_t failures = 0;        ///< failed checks of all cases
+
+  /**
+   * Returns the only registry
+   * @return registry
+   */
+  static check_registry_t& instance() {
+    static check_registry_t reg;
+
+    return reg;
+  }
+
+  /**
+   * Report failed check
+   * @param[in] file - source file of check
+   * @param[in] line - line of check
+   * @param[in] what - description of failure
+   */
+  void fail(char const* file, int line, std::string const& what) {
+    ++failures;
+    std::cerr << file << "(" << line << "): " << what << std::endl;
+  }
+};
+
+/**
+ * @brief Registration of regression case
+ */
+struct check_case_t {
+  /**
+   * Constructor
+   * @param[in] name - name of case
+   * @param[in] body - checks of case
+   */
+  check_case_t(char const* name, void (*body)()) {
+    check_registry_t::instance().cases.push_back({ name, body });
+  }
+};
+
+/**
+ * Define regression case
+ * @param[in] name - name of case
+ */
+#define CHECK_CASE(name) \
+  static void name(); \
+  static check_case_t name##Case(#name, name); \
+  static void name()
+
+/**
+ * Check condition
+ * @param[in] cond - condition
+ */
+#define CHECK(cond) \
+  ((cond) ? (void)0 : check_registry_t::instance().fail(__FILE__, __LINE__, "failed " #cond))
+
+/**
+ * Check value of expression by calculate and tryCalculate
+ * @param[in] calc - calculator
+ * @param[in] expr - string with expression
+ * @param[in] value - expected value, NaN if the result must be NaN
+ */
+#define CHECK_VALUE(calc, expr, value) checkValue(calc, expr, value, 0, __FILE__, __LINE__)
+
+/**
+ * Check value of expression within relative tolerance
+ * @param[in] calc - calculator
+ * @param[in] expr - string with expression
+ * @param[in] value - expected value
+ * @param[in] tol - relative tolerance
+ */
+#define CHECK_NEAR(calc, expr, value, tol) checkValue(calc, expr, value, tol, __FILE__, __LINE__)
+
+/**
+ * Check error of expression by calculate and tryCalculate
+ * @param[in] calc - calculator
+ * @param[in] expr - string with expression
+ * @param[in] code - expected error
+ * @param[in] pos - expected position of error
+ */
+#define CHECK_ERROR(calc, expr, code, pos) checkError(calc, expr, code, pos, __FILE__, __LINE__)
+
+/**
+ * Compare numbers
+ * @param[in] res - calculated number
+ * @param[in] value - expected number, NaN if res must be NaN
+ * @param[in] tol - relative tolerance
+ * @return true if the numbers agree
+ */
+inline bool agrees(double res, double value, double tol) {
+  if (std::isnan(value))
+    return std::isnan(res);
+  if (std::isinf(value))
+    return res == value;
+  return std::fabs(res - value) <= tol * std::max(1.0, std::fabs(value));
+}
+
+/**
+ * Check value of expression by calculate and tryCalculate
+ * @param[in] calc - calculator
+ * @param[in] expr - string with expression
+ * @param[in] value - expected value, NaN if the result must be NaN
+ * @param[in] tol - relative tolerance
+ * @param[in] file - source file of check
+ * @param[in] line - line of check
+ */
+inline void checkValue(str_calc_t& calc, std::string const& expr, double value, double tol, char const* file, int line) {
+  check_registry_t& reg = check_registry_t::instance();
+
+  try {
+    double res = calc.calculate(expr);
+
+    if (!agrees(res, value, tol))
+      reg.fail(file, line, expr + " gives " + std::to_string(res) + " instead of " + std::to_string(value));
+  }
+  catch (std::exception& e) {
+    reg.fail(file, line, expr + " throws " + e.what());
+  }
+
+  calc_result_t res = calc.tryCalculate(expr);
+
+  if (!res)
+    reg.fail(file, line, expr + " fails with " + describe(res.error) + " in tryCalculate");
+  else if (!agrees(res.value, value, tol))
+    reg.fail(file, line, expr + " gives " + std::to_string(res.value) + " in tryCalculate instead of " +
+             std::to_string(value));
+}
+
+/**
+ * Check error of expression by calculate and tryCalculate
+ * @param[in] calc - calculator
+ * @param[in] expr - string with expression
+ * @param[in] code - expected error
+ * @param[in] pos - expected position of error
+ * @param[in] file - source file of check
+ * @param[in] line - line of check
+ */
+inline void checkError(str_calc_t& calc, std::string const& expr, calc_error_t code, size_t pos, char const* file, int line) {
+  check_registry_t& reg = check_registry_t::instance();
+  std::string expected = std::string(describe(code)) + " at " + std::to_string(pos);
+
+  try {
+    double res = calc.calculate(expr);
+
+    reg.fail(file, line, expr + " gives " + std::to_string(res) + " instead of " + expected);
+  }
+  catch (calc_exception_t& e) {
+    if (e.code != code || e.position != pos)
+      reg.fail(file, line, expr + " throws " + describe(e.code) + " at " + std::to_string(e.position) +
+               " instead of " + expected);
+  }
+  catch (std::exception& e) {
+    reg.fail(file, line, expr + " throws " + e.what() + " instead of " + expected);
+  }
+
+  calc_result_t res = calc.tryCalculate(expr);
+
+  if (res.error != code || res.position != pos)
+    reg.fail(file, line, expr + " fails with " + describe(res.error) + " at " + std::to_string(res.position) +
+             " in tryCalculate instead of " + expected);
+}
+
+/**
+ * Backends which evaluate expressions from strings
+ */
+static str_calc_t::backend_t const allBackends[] = {
+  str_calc_t::backend_t::BACKEND_TOKENS,
+  str_calc_t::backend_t::BACKEND_STACK,
+  str_calc_t::backend_t::BACKEND_REGISTER,
+  str_calc_t::backend_t::BACKEND_TIERED
+};
+
+/**
+ * Precisions of compiled program evaluation
+ */
+static str_calc_t::precision_t const allPrecisions[] = {
+  str_calc_t::precision_t::PRECISION_SINGLE,
+  str_calc_t::precision_t::PRECISION_DOUBLE,
+  str_calc_t::precision_t::PRECISION_COMPENSATED
+};
+
+/**
+ * Relative tolerance of precision
+ * @param[in] pr - precision
+ * @return tolerance which covers rounding of short expressions
+ */
+inline double tolerance(str_calc_t::precision_t pr) {
+  return pr == str_calc_t::precision_t::PRECISION_SINGLE ? 1e-6 : 1e-14;
+}
@@ -0,0 +1,102 @@
+#include <future>
+#include <exception>
+#include "check.h"
+#include "../async.h"
+
+#ifndef __cpp_impl_coroutine
+#error "CalcTests20 must be built with coroutine support"
+#endif
+
+/**
+ * @brief Coroutine which runs to completion on its own, nobody awaits it
+ */
+struct detached_t {
+  struct promise_type {
+    detached_t get_return_object() noexcept {
+      return {};
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    void return_void() noexcept {}
+
+    void unhandled_exception() {
+      std::terminate();
+    }
+  };
+};
+
+/**
+ * Await several evaluations one after another, they resume the coroutine on scheduler thread
+ * @param[in] async - scheduler
+ * @param[out] results - results of evaluations in order
+ * @param[out] done - set after the last evaluation
+ */
+static detached_t awaitInTurn(async_calculator_t& async, std::vector<calc_result_t>& results, std::promise<void>& done) {
+  // bindings are built before the awaits, braced lists of strings in co_await trip up some compilers
+  std::map<std::string, double> inside = { { "x", 2 }, { "y", 10 } };
+  std::map<std::string, double> outside = { { "x", -4 }, { "y", -1 } };
+  std::map<std::string, double> one = { { "x", 1 } };
+
+  results.push_back(co_await async.evaluateAsync("x ^ y", inside));
+  results.push_back(co_await async.evaluateAsync("x ^ y", outside));
+  results.push_back(co_await async.evaluateAsync("x * 2", {}));
+  results.push_back(co_await async.evaluateAsync("(x + 1", one));
+  done.set_value();
+}
+
+/**
+ * Await one evaluation
+ * @param[in] async - scheduler
+ * @param[in] x - value of variable
+ * @param[out] result - result of evaluation
+ */
+static detached_t awaitOne(async_calculator_t& async, double x, std::promise<calc_result_t>& result) {
+  std::map<std::string, double> bindings = { { "x", x } };
+
+  result.set_value(co_await async.evaluateAsync("x * x + 1", bindings));
+}
+
+CHECK_CASE(coroutineAwaitsEvaluation) {
+  str_calc_t calc;
+  async_calculator_t async(calc.loader());
+  std::vector<calc_result_t> results;
+  std::promise<void> done;
+
+  awaitInTurn(async, results, done);
+  done.get_future().get();
+
+  CHECK(results.size() == 4);
+  CHECK(results[0] && results[0].value == 1024);
+  CHECK(results[1].error == calc_error_t::DOMAIN && results[1].position == 2);
+  CHECK(results[2].error == calc_error_t::UNINITIALIZED_VARIABLE && results[2].position == 0);
+  CHECK(!results[3]);
+}
+
+CHECK_CASE(coroutinesShareBatches) {
+  str_calc_t calc;
+  async_calculator_t::options_t opts;
+
+  // a long budget lets the coroutines gather in batches
+  opts.budget = std::chrono::milliseconds(20);
+
+  async_calculator_t async(calc.loader(), opts);
+  std::vector<std::promise<calc_result_t>> results(64);
+
+  for (size_t i = 0; i < results.size(); ++i)
+    awaitOne(async, static_cast<double>(i), results[i]);
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    calc_result_t res = results[i].get_future().get();
+
+    CHECK(res && res.value == static_cast<double>(i * i + 1));
+  }
+  CHECK(async.stats().requests == results.size());
+  CHECK(async.stats().batches < results.size());
+}
@@ -0,0 +1,195 @@
+#include <limits>
+#include <future>
+#include <stdexcept>
+#include "check.h"
+#include "../async.h"
+
+using backend_t = str_calc_t::backend_t;
+using precision_t = str_calc_t::precision_t;
+
+static double const undefined = std::numeric_limits<double>::quiet_NaN();
+
+CHECK_CASE(nanIsOrdinaryResult) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 0);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    for (precision_t pr : allPrecisions) {
+      calc.setPrecision(pr);
+      CHECK_VALUE(calc, "0 / 0", undefined);
+      CHECK_VALUE(calc, "x / x + 1", undefined);
+      CHECK_VALUE(calc, "sin(1 / x)", undefined);
+      CHECK_VALUE(calc, "(-8) ^ (1 / 3)", undefined);
+      CHECK_VALUE(calc, "(x - 8) ^ (1 / 3)", undefined);
+      CHECK_VALUE(calc, "x / x > 1 ? 1 : 2", undefined);
+      CHECK_VALUE(calc, "msum(x / x, 2)", undefined);
+    }
+  }
+}
+
+CHECK_CASE(domainErrorsOnEveryBackend) {
+  str_calc_t calc;
+
+  calc.setVariable("x", -2);
+  calc.setVariable("y", -1);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    for (precision_t pr : allPrecisions) {
+      calc.setPrecision(pr);
+      CHECK_ERROR(calc, "msum(x, -1)", calc_error_t::DOMAIN, 0);
+      CHECK_ERROR(calc, "1 + ema(x, 2)", calc_error_t::DOMAIN, 4);
+      CHECK_ERROR(calc, "1 + x ^ y", calc_error_t::DOMAIN, 6);
+      CHECK_ERROR(calc, "1 + x ^ -3", calc_error_t::DOMAIN, 6);
+      CHECK_ERROR(calc, "0 / 0 + x ^ y", calc_error_t::DOMAIN, 10);
+      CHECK_VALUE(calc, "x < 0 ? 0 : x ^ y", 0);
+    }
+  }
+}
+
+CHECK_CASE(uninitializedOnEveryBackend) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 1);
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    CHECK_ERROR(calc, "x + z", calc_error_t::UNINITIALIZED_VARIABLE, 4);
+    CHECK_ERROR(calc, "z * 2 + x", calc_error_t::UNINITIALIZED_VARIABLE, 0);
+  }
+}
+
+CHECK_CASE(batchRowsWithDomainErrors) {
+  str_calc_t calc;
+  std::map<std::string, std::vector<double>> columns = { { "x", { 1, -2, 4, -1 } } };
+
+  calc.setVariable("y", -1);
+  for (precision_t pr : allPrecisions) {
+    double tol = tolerance(pr);
+    std::vector<double> results;
+    std::vector<uint64_t> validity;
+
+    calc.setPrecision(pr);
+
+    // rows outside the domain have no result, NaN of other rows is a result
+    calc_result_t res = calc.calculateBatch("x ^ y + (x - 1) / (x - 1)", columns, 4, results, validity);
+
+    CHECK(res && res.value == 2 && validity[0] == 5);
+    CHECK(std::isnan(results[0]) && std::isnan(results[1]) && agrees(results[2], 1.25, tol) && std::isnan(results[3]));
+
+    // untaken branches have no errors
+    res = calc.calculateBatch("x > 0 ? x ^ y : 0", columns, 4, results, validity);
+    double taken[] = { 1, 0, 0.25, 0 };
+
+    CHECK(res && res.value == 4 && validity[0] == 15);
+    for (size_t r = 0; r < 4; ++r)
+      CHECK(agrees(results[r], taken[r], tol));
+
+    // rows with an error take no sample
+    res = calc.calculateBatch("msum(x ^ y, 10)", columns, 4, results, validity);
+    CHECK(res && res.value == 2 && validity[0] == 5);
+    CHECK(agrees(results[0], 1, tol) && agrees(results[2], 1.25, tol));
+
+    // formulas without the error keep their results
+    res = calc.calculateBatch(std::vector<std::string>{ "x ^ y", "x + 1", "x ^ y * 2" }, columns, 4, results);
+    double merged[] = { 1, undefined, 0.25, undefined, 2, -1, 5, 0, 2, undefined, 0.5, undefined };
+
+    CHECK(res && res.value == 3);
+    for (size_t r = 0; r < 12; ++r)
+      CHECK(agrees(results[r], merged[r], tol));
+  }
+}
+
+/**
+ * @brief Function which throws for negative operand without declaring its domain
+ */
+class strict_t : public function_t {
+public:
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    if (args[0] < 0)
+      throw std::runtime_error("Negative operand");
+    return args[0];
+  }
+
+  void process(token_stack_t& stack) override {
+    double x = getNumber(stack);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(evaluate(&x))));
+  }
+};
+
+CHECK_CASE(batchBlocksWhichThrow) {
+  str_calc_t calc;
+  batch_calculator_t batch;
+  std::vector<double> results;
+  std::vector<uint64_t> validity;
+  std::vector<double> first = { 1, -2, 4 }, second = { 1 };
+
+  calc.loader()->update([](registry_t& r) {
+    r.loadedOps.funcs.insert(std::make_pair("strict", std::make_shared<strict_t>()));
+  });
+  calc.setVariable("x", 0);
+
+  // a pure program finds the failed rows anew
+  program_t pure = calc.compile("1 + strict(x)");
+  calc_result_t res = batch.calculate(pure, { first.data() }, 3, results, validity);
+
+  CHECK(res && res.value == 2 && validity[0] == 5 && results[2] == 5);
+  CHECK(batch.errors()[1] == 4);
+
+  // the stateful operation takes the rows of the failed block once
+  program_t stateful = calc.compile("msum(x, 10) + strict(x)");
+
+  res = batch.calculate(stateful, { first.data() }, 3, results, validity);
+  CHECK(res && res.value == 0 && validity[0] == 0 && std::isnan(results[0]));
+  CHECK(batch.errors()[0] == 14);
+  res = batch.calculate(stateful, { second.data() }, 1, results, validity);
+  CHECK(res && res.value == 1 && results[0] == 5);
+}
+
+CHECK_CASE(asyncRowsWithDomainErrors) {
+  str_calc_t calc;
+  std::promise<calc_result_t> inside, outside;
+  async_calculator_t async(calc.loader());
+
+  // the row outside the domain gets its error from the batch pass
+  async.submit("x ^ y", { { "x", 4 }, { "y", -1 } }, [&](calc_result_t const& res) { inside.set_value(res); });
+  async.submit("x ^ y", { { "x", -4 }, { "y", -1 } }, [&](calc_result_t const& res) { outside.set_value(res); });
+
+  calc_result_t res = inside.get_future().get();
+
+  CHECK(res && res.value == 0.25);
+  res = outside.get_future().get();
+  CHECK(res.error == calc_error_t::DOMAIN && res.position == 2);
+}
+
+CHECK_CASE(gradientDomainErrors) {
+  str_calc_t calc;
+  std::vector<double> grad;
+  std::map<std::string, double> all;
+  bool thrown = false;
+
+  calc.setVariable("x", 0);
+  calc.setVariable("y", -1);
+  CHECK(std::isnan(calc.gradient("x / x", { "x" }, grad)));
+  CHECK(std::isnan(calc.gradient("x / x", all)));
+  calc.setVariable("x", -2);
+  try {
+    calc.gradient("1 + x ^ y", { "x", "y" }, grad);
+  }
+  catch (calc_exception_t& e) {
+    thrown = e.code == calc_error_t::DOMAIN && e.position == 6;
+  }
+  CHECK(thrown);
+  thrown = false;
+  try {
+    calc.gradient("1 + x ^ y", all);
+  }
+  catch (calc_exception_t& e) {
+    thrown = e.code == calc_error_t::DOMAIN && e.position == 6;
+  }
+  CHECK(thrown);
+}
@@ -0,0 +1,15 @@
+#include "check.h"
+
+CHECK_CASE(pluginsOfOtherVersionAreRejected) {
+  str_calc_t calc;
+  registry_t stale(CALC_STALE_PLUGINS);
+
+  // the plugin without version of interface is freed, nothing of it is loaded
+  CHECK(!stale.abiMatches && !stale.checkLoadedElems());
+  CHECK(stale.dlls.empty() && stale.loadedOps.funcs.empty());
+
+  // the published plugins stay
+  CHECK(!calc.loader()->reload(CALC_STALE_PLUGINS));
+  CHECK_VALUE(calc, "1 + 2", 3);
+  CHECK_ERROR(calc, "stale(1)", calc_error_t::UNKNOWN_OPERATION, 5);
+}
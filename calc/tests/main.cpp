@@ -0,0 +1,25 @@
+#include "check.h"
+
+int main(int argc, char* argv[]) {
+  check_registry_t& reg = check_registry_t::instance();
+  size_t failed = 0;
+
+  for (auto& c : reg.cases) {
+    size_t before = reg.failures;
+
+    // a case which throws stops, the other cases still run
+    try {
+      c.body();
+    }
+    catch (std::exception& e) {
+      reg.fail(c.name, 0, std::string("unexpected exception ") + e.what());
+    }
+
+    if (reg.failures != before)
+      ++failed;
+    std::cout << (reg.failures == before ? "ok     " : "FAILED ") << c.name << std::endl;
+  }
+
+  std::cout << reg.cases.size() - failed << " of " << reg.cases.size() << " cases passed" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
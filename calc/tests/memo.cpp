@@ -0,0 +1,51 @@
+#include "check.h"
+
+using backend_t = str_calc_t::backend_t;
+
+/**
+ * @brief Square root which is not defined for negative operand and throws from process for it, as plugins do
+ */
+class root_t : public function_t {
+public:
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  bool hasDomain() const noexcept override {
+    return true;
+  }
+
+  bool inDomain(double const* args) const noexcept override {
+    return !(args[0] < 0);
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] < 0 ? domainError() : std::sqrt(args[0]);
+  }
+
+  void process(token_stack_t& stack) override {
+    double x = getNumber(stack);
+
+    checkDomain(&x);
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(std::sqrt(x))));
+  }
+};
+
+CHECK_CASE(memoizedFunctionKeepsErrors) {
+  str_calc_t calc;
+
+  calc.loader()->update([](registry_t& r) {
+    r.loadedOps.funcs.insert(std::make_pair("root", std::make_shared<root_t>()));
+  });
+  calc.setMemoization("root", true);
+  calc.setVariable("x", -4);
+  calc.setVariable("y", 4);
+
+  // the cached results never hide the domain error of the wrapped function
+  for (backend_t be : allBackends) {
+    calc.setBackend(be);
+    CHECK_VALUE(calc, "root(y) + 1", 3);
+    CHECK_ERROR(calc, "root(x) + 1", calc_error_t::DOMAIN, 0);
+  }
+  CHECK(calc.memoizationStats()["root"].hits > 0);
+}
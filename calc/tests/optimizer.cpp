@@ -0,0 +1,65 @@
+#include "check.h"
+
+using backend_t = str_calc_t::backend_t;
+
+/**
+ * @brief Impure function which returns the number of its calls
+ */
+class counter_t : public function_t {
+private:
+  double calls = 0;  ///< number of calls
+
+public:
+  double evaluate(double const* args) override {
+    return ++calls;
+  }
+
+  void process(token_stack_t& stack) override {
+    getNumber(stack);
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(++calls)));
+  }
+};
+
+CHECK_CASE(hornerKeepsImpureCoefficients) {
+  str_calc_t calc;
+  optimizer_t::options_t opts;
+
+  calc.loader()->update([](registry_t& r) {
+    r.loadedOps.funcs.insert(std::make_pair("next", std::make_shared<counter_t>()));
+  });
+  opts.horner = true;
+  calc.setOptimization(opts);
+  calc.setBackend(backend_t::BACKEND_STACK);
+  calc.setVariable("x", 1);
+  calc.setVariable("y", 0);
+
+  // the only call must be neither cloned into every power of x nor moved
+  CHECK(calc.calculate("(next(y) * x) ^ 3 + x") == 2);
+  CHECK(calc.optimizationReport().polynomials == 0);
+  CHECK(calc.calculate("(next(y) * x) ^ 3 + x") == 9);
+
+  // stateful coefficients keep their call sites
+  program_t prog = calc.compile("msum(y, 2) * x ^ 3 + msum(y, 2) * x ^ 2 + x");
+  double sums[] = { 3, 7, 11, 15 };
+
+  CHECK(calc.optimizationReport().polynomials == 0);
+  for (int k = 0; k < 4; ++k) {
+    calc.setVariable("y", k + 1);
+    CHECK(calc.calculate(prog) == sums[k]);
+  }
+}
+
+CHECK_CASE(hornerRewritesCoefficients) {
+  str_calc_t calc;
+  optimizer_t::options_t opts;
+
+  opts.horner = true;
+  calc.setOptimization(opts);
+  calc.setBackend(backend_t::BACKEND_STACK);
+  calc.setVariable("x", 2);
+  calc.setVariable("y", 3);
+
+  // the coefficient of x ^ 3 is a polynomial in y of its own
+  CHECK_NEAR(calc, "(y * y * y + y * y + y + 1) * x ^ 3 + x ^ 2 + x", 326, 1e-15);
+  CHECK(calc.optimizationReport().polynomials == 2);
+}
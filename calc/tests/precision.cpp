@@ -0,0 +1,73 @@
+#include <limits>
+#include "check.h"
+
+using precision_t = str_calc_t::precision_t;
+
+CHECK_CASE(compensatedArithmeticKeepsInfinity) {
+  double inf = std::numeric_limits<double>::infinity();
+  compensated_t big(1e308);
+  compensated_t one(1);
+  compensated_t zero(0);
+
+  CHECK(static_cast<double>(big + big) == inf);
+  CHECK(static_cast<double>(big * compensated_t(10)) == inf);
+  CHECK(static_cast<double>(-big * compensated_t(10)) == -inf);
+  CHECK(static_cast<double>(one / zero) == inf);
+  CHECK(static_cast<double>(-one / zero) == -inf);
+  CHECK(static_cast<double>(compensated_t(inf) + one) == inf);
+  CHECK(static_cast<double>(compensated_t(inf) * compensated_t(2)) == inf);
+  CHECK(static_cast<double>(one / compensated_t(inf)) == 0);
+  CHECK(static_cast<double>(compensated_t(inf) - compensated_t(1e300)) == inf);
+}
+
+CHECK_CASE(precisionsAgreeOnOverflow) {
+  str_calc_t calc;
+  double inf = std::numeric_limits<double>::infinity();
+
+  calc.setBackend(str_calc_t::backend_t::BACKEND_STACK);
+  calc.setVariable("x", 1e308);
+  calc.setVariable("y", 0);
+  for (precision_t pr : { precision_t::PRECISION_DOUBLE, precision_t::PRECISION_COMPENSATED }) {
+    calc.setPrecision(pr);
+    CHECK_VALUE(calc, "1 / y", inf);
+    CHECK_VALUE(calc, "-1 / y", -inf);
+    CHECK_VALUE(calc, "x * 10", inf);
+    CHECK_VALUE(calc, "x + x", inf);
+    CHECK_VALUE(calc, "1 / y + 1", inf);
+    CHECK_VALUE(calc, "(x * 10) * 2 - 1", inf);
+    CHECK_VALUE(calc, "1 / (x * 10)", 0);
+  }
+
+  std::map<std::string, std::vector<double>> columns = { { "x", { 1e308, -1e308, 0, 1 } } };
+
+  for (precision_t pr : { precision_t::PRECISION_DOUBLE, precision_t::PRECISION_COMPENSATED }) {
+    std::vector<double> results;
+    std::vector<uint64_t> validity;
+    double expected[] = { inf, -inf, 0, 20 };
+
+    calc.setPrecision(pr);
+    CHECK(calc.calculateBatch("x * 10 + x * 10", columns, 4, results, validity));
+    for (size_t r = 0; r < 4; ++r)
+      CHECK(results[r] == expected[r]);
+  }
+}
+
+CHECK_CASE(precisionOnEveryCompiledBackend) {
+  str_calc_t calc;
+
+  calc.setVariable("x", 1e16);
+  calc.setVariable("y", 1);
+  for (str_calc_t::backend_t be : allBackends) {
+    // the token interpreter has no compiled program, it calculates in double
+    if (be == str_calc_t::backend_t::BACKEND_TOKENS)
+      continue;
+    calc.setBackend(be);
+    calc.setPrecision(precision_t::PRECISION_SINGLE);
+    CHECK_VALUE(calc, "y + y / 1e10", 1);
+    calc.setPrecision(precision_t::PRECISION_DOUBLE);
+    CHECK_VALUE(calc, "y + y / 1e10", 1 + 1e-10);
+    CHECK_VALUE(calc, "x + y - x", 0);
+    calc.setPrecision(precision_t::PRECISION_COMPENSATED);
+    CHECK_VALUE(calc, "x + y - x", 1);
+  }
+}
@@ -0,0 +1,21 @@
+#include "../include/operation.h"
+
+/**
+ * @brief Function of a plugin built before the plugins exported the version of their interface
+ */
+class Stale : public function_t {
+public:
+  double evaluate(double const* args) override {
+    return args[0];
+  }
+
+  void process(token_stack_t& stack) override {
+    double x = getNumber(stack);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(x)));
+  }
+};
+
+extern "C" __declspec(dllexport) void __cdecl load(ops_maps& m, std::map<std::string, double const>& cv) {
+  m.funcs.insert(std::make_pair("stale", std::shared_ptr<function_t>(new Stale)));
+}
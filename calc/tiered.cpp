@@ -0,0 +1,308 @@
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "tiered.h"
+#include "scanner.h"
+#include "parser.h"
+#include "compiler.h"
+
+/**
+ * Returns seconds elapsed since the moment
+ * @param[in] start - moment
+ * @return seconds
+ */
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Compile promoted tier and hand it to the entry
+ * @param[in] job - promotion
+ */
+void tiered_calculator_t::promote(job_t const& job) const {
+  auto start = std::chrono::steady_clock::now();
+  program_t prog;
+  vm_program_t vmProg;
+  bool failed = false;
+
+  // the pipeline is private to the compilation, so it shares nothing with the owner thread but the registry
+  try {
+    epoch_t::guard_t guard = l->pin();
+    registry_t const& r = l->registry();
+    scanner_t s;
+    parser_t p;
+    optimizer_t o;
+    compiler_t k;
+    peephole_t f;
+    var_storage_t vars(job.vars);
+
+    if (!r.compatible)
+      throw calc_exception_t(calc_error_t::INCOMPATIBLE_PLUGINS, 0, "Incompatible plugins");
+    o.setOperations(r.loadedOps);
+    o.setOptions(job.opts.optimization);
+    f.setOptions(job.opts.fusion);
+    prog = k.compile(o.optimize(p.parse(s.scan(job.expression, r.loadedOps, r.cv, vars))));
+    f.fuse(prog);
+    if (job.tier == tier_t::TIER_REGISTER)
+      vmProg = vm_compiler_t().compile(prog);
+  }
+  catch (std::exception&) {
+    failed = true;
+  }
+
+  entry_t& e = *job.entry;
+  std::lock_guard<std::mutex> lock(e.lock);
+
+  e.failed = failed;
+  e.nextTier = job.tier;
+  e.nextProg = std::move(prog);
+  e.nextVm = std::move(vmProg);
+  e.nextTime = elapsed(start);
+  e.ready.store(true, std::memory_order_release);
+}
+
+/**
+ * Body of background compiler
+ */
+void tiered_calculator_t::work() {
+  std::unique_lock<std::mutex> lock(queueLock);
+
+  while (true) {
+    wake.wait(lock, [this]() { return stop || !jobs.empty(); });
+    if (stop)
+      return;
+
+    job_t job = std::move(jobs.front());
+    jobs.pop_front();
+    lock.unlock();
+    promote(job);
+    lock.lock();
+  }
+}
+
+/**
+ * Schedule promotion of expression to the next tier
+ * @param[in] expression - string with expression
+ * @param[in] entry - cached expression
+ * @param[in] vars - storage of variables
+ */
+void tiered_calculator_t::schedule(std::string const& expression, std::shared_ptr<entry_t> const& entry,
+                                   vars_map const& vars) {
+  // all variables of the expression were created by the baseline compilation, so the copy has them
+  job_t job = { entry, expression, vars, static_cast<tier_t>(static_cast<size_t>(entry->stats.tier) + 1), opts };
+
+  entry->pending = true;
+  if (!opts.background) {
+    promote(job);
+    adopt(*entry);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(queueLock);
+
+  if (!worker.joinable())
+    worker = std::thread(&tiered_calculator_t::work, this);
+  jobs.push_back(std::move(job));
+  wake.notify_one();
+}
+
+/**
+ * Swap the promoted tier in
+ * @param[in] e - cached expression
+ */
+void tiered_calculator_t::adopt(entry_t& e) {
+  std::lock_guard<std::mutex> lock(e.lock);
+  std::vector<size_t> order;
+
+  // the promotion is compiled from the string, so the slots of shared program are laid out anew
+  if (e.failed || (e.shared && !layout(e.nextProg, e.reference, order)))
+    e.limit = e.stats.tier;
+  else {
+    if (e.shared)
+      e.order = std::move(order);
+    e.prog = std::move(e.nextProg);
+    e.vm = std::move(e.nextVm);
+    e.stats.tier = e.nextTier;
+    e.stats.compileTime[static_cast<size_t>(e.nextTier)] = e.nextTime;
+  }
+  e.pending = false;
+  e.ready.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * Find canonical index of every variable of program
+ * @param[in] prog - program
+ * @param[in] reference - variables by canonical index
+ * @param[out] order - canonical index by slot
+ * @return false if the program has a variable which is not in the reference
+ */
+bool tiered_calculator_t::layout(program_t const& prog, std::vector<std::shared_ptr<variable_t>> const& reference,
+                                 std::vector<size_t>& order) {
+  order.clear();
+  for (auto& var : prog.vars) {
+    auto vi = std::find(reference.begin(), reference.end(), var);
+
+    if (vi == reference.end())
+      return false;
+    order.push_back(static_cast<size_t>(vi - reference.begin()));
+  }
+  return true;
+}
+
+/**
+ * Bind slots of shared program to variables of the expression being calculated
+ * @param[in] e - cached expression
+ * @param[in] vars - variables of the expression by canonical index
+ */
+void tiered_calculator_t::bind(entry_t& e, std::vector<std::shared_ptr<variable_t>> const& vars) {
+  for (size_t slot = 0; slot < e.order.size(); ++slot) {
+    std::shared_ptr<variable_t> const& var = vars[e.order[slot]];
+
+    e.prog.rebind(slot, var);
+    // registers of variables come first in the order of slots
+    if (e.stats.tier == tier_t::TIER_REGISTER && e.vm.vars[slot] != var)
+      e.vm.vars[slot] = var;
+  }
+}
+
+/**
+ * Find cached expression, compile the expression if it is not cached
+ * @warning throws calc_exception_t if string is incorrect
+ * @param[in] expression - string with expression
+ * @param[in] parse - rpn queue of the expression
+ * @return cached expression and its string
+ */
+std::map<std::string, tiered_calculator_t::alias_t>::iterator tiered_calculator_t::find(
+    std::string const& expression, std::function<token_queue_t&()> const& parse) {
+  auto ai = aliases.find(expression);
+
+  if (ai != aliases.end() && !ai->second.entry.expired())
+    return ai;
+
+  bool canonical = opts.canonicalize;
+  token_queue_t& rpn = canonical ? cn.canonicalize(parse()) : parse();
+  auto ei = entries.find(canonical ? cn.key() : expression);
+
+  // programs which are not shared are cached by string
+  if (ei == entries.end() && canonical)
+    ei = entries.find(expression);
+
+  if (ei != entries.end())
+    ++ei->second->stats.forms;
+  else {
+    if (!entries.empty() && entries.size() >= opts.capacity) {
+      auto coldest = entries.begin();
+      uint64_t least = UINT64_MAX;
+
+      for (auto i = entries.begin(); i != entries.end(); ++i) {
+        uint64_t runs = 0;
+
+        for (size_t t = 0; t < tiers; ++t)
+          runs += i->second->stats.runs[t];
+        if (runs < least) {
+          least = runs;
+          coldest = i;
+        }
+      }
+      // a compilation in progress keeps its entry alive until it finishes
+      entries.erase(coldest);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<entry_t> entry = std::make_shared<entry_t>();
+
+    entry->prog = k.compile(rpn);
+    entry->stats.compileTime[static_cast<size_t>(tier_t::TIER_BASELINE)] = elapsed(start);
+    // the register machine has neither jumps nor states
+    entry->limit = entry->prog.branches || !entry->prog.states.empty() ? tier_t::TIER_OPTIMIZED : tier_t::TIER_REGISTER;
+    entry->expression = expression;
+    // errors of shared program are located by calculating the expression anew, so impure programs are not shared
+    entry->shared = canonical && entry->prog.isPure() && layout(entry->prog, cn.variables(), entry->order);
+    if (entry->shared)
+      entry->reference = cn.variables();
+    ei = entries.insert(std::make_pair(entry->shared ? cn.key() : expression, std::move(entry))).first;
+  }
+
+  if (aliases.size() >= opts.aliases) {
+    for (auto i = aliases.begin(); i != aliases.end();)
+      i = i->second.entry.expired() ? aliases.erase(i) : std::next(i);
+    if (aliases.size() >= opts.aliases)
+      aliases.clear();
+  }
+
+  alias_t alias = { ei->second, ei->second->shared ? cn.variables() : std::vector<std::shared_ptr<variable_t>>() };
+
+  return aliases.insert_or_assign(expression, std::move(alias)).first;
+}
+
+/**
+ * Calculate expression on its current tier, the expression is promoted when it gets hot
+ * @warning throws calc_exception_t if string is incorrect
+ * @param[in] expression - string with expression
+ * @param[in] parse - rpn queue of the expression, it is compiled for the baseline tier unless a program is shared
+ * @param[in] vars - storage of variables, promotions are compiled with its copy
+ * @return result of calculation or error with its position
+ */
+calc_result_t tiered_calculator_t::calculate(std::string const& expression, std::function<token_queue_t&()> const& parse,
+                                             vars_map const& vars) {
+  auto ai = find(expression, parse);
+  std::shared_ptr<entry_t> entry = ai->second.entry.lock();
+  entry_t& e = *entry;
+  uint64_t runs = 0;
+  size_t slot;
+
+  if (e.ready.load(std::memory_order_acquire))
+    adopt(e);
+  for (size_t t = 0; t < tiers; ++t)
+    runs += e.stats.runs[t];
+  if (!e.pending && e.stats.tier < e.limit &&
+        runs >= (e.stats.tier == tier_t::TIER_BASELINE ? opts.optimizeAfter : opts.registerAfter))
+    schedule(e.expression, entry, vars);
+  if (e.shared)
+    bind(e, ai->second.vars);
+
+  // every string evaluation starts without history, as a new program does
+  e.prog.reset();
+  ++e.stats.runs[static_cast<size_t>(e.stats.tier)];
+
+  calc_result_t res;
+
+  if (e.stats.tier == tier_t::TIER_REGISTER && e.prog.tryBind(slot))
+    res = vm.run(e.vm);
+  else
+    res = c.tryCalculate(e.prog);
+  if (res || e.expression == expression)
+    return res;
+
+  // positions refer to the string which the shared program was compiled from, so the pure program
+  // is calculated anew to locate the error
+  program_t prog = k.compile(parse());
+
+  return c.tryCalculate(prog);
+}
+
+/**
+ * Returns statistics of cached expressions
+ * @return statistics by string with expression
+ */
+std::map<std::string, tiered_calculator_t::stats_t> tiered_calculator_t::stats() const {
+  std::map<std::string, stats_t> res;
+
+  for (auto& entry : entries)
+    res[entry.second->expression] = entry.second->stats;
+  return res;
+}
+
+/**
+ * Destructor, waits for the compilation in progress
+ */
+tiered_calculator_t::~tiered_calculator_t() {
+  {
+    std::lock_guard<std::mutex> lock(queueLock);
+
+    stop = true;
+    wake.notify_one();
+  }
+  if (worker.joinable())
+    worker.join();
+}
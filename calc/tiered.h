@@ -0,0 +1,220 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "loader.h"
+#include "optimizer.h"
+#include "peephole.h"
+#include "compiler.h"
+#include "canon.h"
+#include "calc.h"
+#include "vm.h"
+
+/**
+ * @brief Class which caches compiled expressions and promotes hot ones to faster tiers
+ * @warning only the owner thread may call the methods, promotions are compiled by the background thread
+ * of the instance and swapped in by the owner thread on the next execution of the expression.
+ * Expressions with the same canonical form share one program whose slots are bound to the variables
+ * of the expression being calculated.
+ */
+class tiered_calculator_t {
+public:
+  /**
+   * @brief Tiers of compiled expression from the cheapest to compile to the fastest to run
+   */
+  enum class tier_t {
+    TIER_BASELINE,   ///< program without rewrites on the stack machine
+    TIER_OPTIMIZED,  ///< program with folded constants and superinstructions on the stack machine
+    TIER_REGISTER    ///< optimized program on the register machine
+  };
+
+  static constexpr size_t tiers = 3;  ///< number of tiers
+
+  /**
+   * @brief Thresholds of promotion and rewrites of the optimized tier
+   */
+  struct options_t {
+    uint64_t optimizeAfter = 16;     ///< executions after which the expression is optimized
+    uint64_t registerAfter = 256;    ///< executions after which the expression moves to the register machine
+    size_t capacity = 1024;          ///< number of cached expressions, the least executed one is evicted
+    bool background = true;          ///< compile promotions in background, otherwise before the next execution
+    bool canonicalize = true;        ///< share programs of expressions with the same canonical form
+    size_t aliases = 4096;           ///< number of cached strings with expression which refer to programs
+    optimizer_t::options_t optimization = { false, false, true };  ///< rewrites of the optimized tier
+    peephole_t::options_t fusion;    ///< superinstructions of the optimized tier
+  };
+
+  /**
+   * @brief Statistics of cached expression
+   */
+  struct stats_t {
+    tier_t tier = tier_t::TIER_BASELINE;  ///< tier which runs the expression now
+    uint64_t runs[tiers] = {};            ///< executions on every tier
+    double compileTime[tiers] = {};       ///< seconds spent to compile every tier, 0 if it was not compiled
+    size_t forms = 1;                     ///< strings with expression which have found the program
+  };
+
+private:
+  /**
+   * @brief Cached expression
+   */
+  struct entry_t {
+    program_t prog;                  ///< program of stack machine tiers
+    vm_program_t vm;                 ///< program of register machine tier
+    stats_t stats;                   ///< statistics
+    tier_t limit;                    ///< highest tier which the program can reach
+    bool pending = false;            ///< promotion is being compiled
+    std::string expression;          ///< string with expression which the program was compiled from
+    bool shared = false;             ///< the program is found by canonical form, its slots are bound on every execution
+    std::vector<std::shared_ptr<variable_t>> reference;  ///< variables of the expression by canonical index
+    std::vector<size_t> order;       ///< canonical index of variable by slot
+
+    std::mutex lock;                 ///< protects the promoted tier
+    std::atomic<bool> ready{false};  ///< promoted tier is waiting to be swapped in
+    bool failed = false;             ///< promotion failed, the tier is the limit then
+    tier_t nextTier;                 ///< promoted tier
+    program_t nextProg;              ///< promoted program
+    vm_program_t nextVm;             ///< promoted program of register machine
+    double nextTime = 0;             ///< seconds spent to compile the promoted tier
+  };
+
+  /**
+   * @brief Compilation of promoted tier
+   */
+  struct job_t {
+    std::shared_ptr<entry_t> entry;  ///< expression being promoted
+    std::string expression;          ///< string with expression
+    vars_map vars;                   ///< variables of the expression
+    tier_t tier;                     ///< promoted tier
+    options_t opts;                  ///< rewrites at the time of scheduling
+  };
+
+  std::shared_ptr<loader_t> l;                                ///< loader of plugins
+  options_t opts;                                             ///< thresholds and rewrites
+  /**
+   * @brief String with expression which was calculated
+   */
+  struct alias_t {
+    std::weak_ptr<entry_t> entry;                  ///< cached expression, expired if it was evicted
+    std::vector<std::shared_ptr<variable_t>> vars; ///< variables of the string by canonical index
+  };
+
+  std::map<std::string, std::shared_ptr<entry_t>> entries;    ///< cached expressions by canonical key or by string
+  std::map<std::string, alias_t> aliases;                     ///< cached expressions by string
+  canonicalizer_t cn;                                         ///< canonical forms of expressions
+  compiler_t k;                                               ///< compiler of baseline tier
+  calculator_t c;                                             ///< stack machine
+  vm_calculator_t vm;                                         ///< register machine
+
+  std::thread worker;                                         ///< background compiler, started by the first job
+  std::mutex queueLock;                                       ///< protects jobs and stop
+  std::condition_variable wake;                               ///< signals new jobs and stop
+  std::deque<job_t> jobs;                                     ///< promotions waiting for compilation
+  bool stop = false;                                          ///< worker has to finish
+
+  /**
+   * Compile promoted tier and hand it to the entry
+   * @param[in] job - promotion
+   */
+  void promote(job_t const& job) const;
+
+  /**
+   * Body of background compiler
+   */
+  void work();
+
+  /**
+   * Schedule promotion of expression to the next tier
+   * @param[in] expression - string with expression
+   * @param[in] entry - cached expression
+   * @param[in] vars - storage of variables
+   */
+  void schedule(std::string const& expression, std::shared_ptr<entry_t> const& entry, vars_map const& vars);
+
+  /**
+   * Swap the promoted tier in
+   * @param[in] e - cached expression
+   */
+  static void adopt(entry_t& e);
+
+  /**
+   * Find canonical index of every variable of program
+   * @param[in] prog - program
+   * @param[in] reference - variables by canonical index
+   * @param[out] order - canonical index by slot
+   * @return false if the program has a variable which is not in the reference
+   */
+  static bool layout(program_t const& prog, std::vector<std::shared_ptr<variable_t>> const& reference,
+                     std::vector<size_t>& order);
+
+  /**
+   * Bind slots of shared program to variables of the expression being calculated
+   * @param[in] e - cached expression
+   * @param[in] vars - variables of the expression by canonical index
+   */
+  static void bind(entry_t& e, std::vector<std::shared_ptr<variable_t>> const& vars);
+
+  /**
+   * Find cached expression, compile the expression if it is not cached
+   * @warning throws calc_exception_t if string is incorrect
+   * @param[in] expression - string with expression
+   * @param[in] parse - rpn queue of the expression
+   * @return cached expression and its string
+   */
+  std::map<std::string, alias_t>::iterator find(std::string const& expression,
+                                                std::function<token_queue_t&()> const& parse);
+
+public:
+  /**
+   * Constructor
+   * @param[in] loader - loader of plugins which promotions are compiled with
+   */
+  tiered_calculator_t(std::shared_ptr<loader_t> loader) : l(std::move(loader)) {}
+
+  tiered_calculator_t(tiered_calculator_t const&) = delete;
+  tiered_calculator_t& operator=(tiered_calculator_t const&) = delete;
+
+  /**
+   * Set thresholds and rewrites, cached expressions keep their tier
+   * @param[in] options - thresholds and rewrites
+   */
+  void setOptions(options_t const& options) {
+    opts = options;
+  }
+
+  /**
+   * Calculate expression on its current tier, the expression is promoted when it gets hot
+   * @warning throws calc_exception_t if string is incorrect
+   * @param[in] expression - string with expression
+   * @param[in] parse - rpn queue of the expression, it is compiled for the baseline tier unless a program is shared
+   * @param[in] vars - storage of variables, promotions are compiled with its copy
+   * @return result of calculation or error with its position
+   */
+  calc_result_t calculate(std::string const& expression, std::function<token_queue_t&()> const& parse,
+                          vars_map const& vars);
+
+  /**
+   * Returns statistics of cached expressions
+   * @return statistics by string with expression which the program was compiled from
+   */
+  std::map<std::string, stats_t> stats() const;
+
+  /**
+   * Forget all cached expressions, e.g. after the plugins are reloaded
+   */
+  void clear() {
+    entries.clear();
+    aliases.clear();
+  }
+
+  /**
+   * Destructor, waits for the compilation in progress
+   */
+  ~tiered_calculator_t();
+};
@@ -0,0 +1,187 @@
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include "trace.h"
+
+/**
+ * Constructor
+ * @param[in] capacity - least number of events
+ * @param[in] id - number of the thread in trace
+ */
+tracer_t::ring_t::ring_t(size_t capacity, uint64_t id) : tid(id) {
+  size_t n = 2;
+
+  while (n < capacity)
+    n <<= 1;
+  slots.reset(new slot_t[n]);
+  mask = n - 1;
+}
+
+/**
+ * Write nanoseconds as microseconds with fraction, the unit of trace-event format
+ * @param[in] out - stream
+ * @param[in] ns - nanoseconds
+ */
+static void micros(std::ostream& out, uint64_t ns) {
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+}
+
+/**
+ * Returns the tracer
+ * @return tracer
+ */
+tracer_t& tracer_t::instance() {
+  static tracer_t tracer;
+
+  return tracer;
+}
+
+/**
+ * Returns spans of the calling thread
+ * @return spans
+ */
+tracer_t::local_t& tracer_t::local() noexcept {
+  static thread_local local_t spans;
+
+  return spans;
+}
+
+/**
+ * Start recording
+ * @param[in] options - options of recording
+ */
+void tracer_t::enable(options_t const& options) {
+  double rate = std::min(std::max(options.sampling, 1e-9), 1.0);
+
+  period.store(static_cast<uint64_t>(std::llround(1.0 / rate)), std::memory_order_relaxed);
+  slow.store(options.slowCall, std::memory_order_relaxed);
+  capacity.store(options.events, std::memory_order_relaxed);
+  on.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Open span of the calling thread
+ * @param[out] start - timestamp of the span if it is sampled
+ * @return true if the span is sampled
+ */
+bool tracer_t::begin(uint64_t& start) noexcept {
+  local_t& l = local();
+
+  // nested spans follow the decision of their top-level span
+  if (l.depth++ == 0)
+    l.sampled = l.counter++ % period.load(std::memory_order_relaxed) == 0;
+  if (l.sampled)
+    start = now();
+  return l.sampled;
+}
+
+/**
+ * Close span of the calling thread
+ * @param[in] name - name of span, static string
+ * @param[in] cat - category of span, static string
+ * @param[in] start - timestamp of the span
+ * @param[in] sampled - the span is recorded
+ * @param[in] arg - position in expression, UINT64_MAX if absent
+ */
+void tracer_t::end(char const* name, char const* cat, uint64_t start, bool sampled, uint64_t arg) {
+  if (sampled)
+    record(name, cat, start, now() - start, arg);
+  --local().depth;
+}
+
+/**
+ * Add event to the ring of the calling thread
+ * @param[in] name - name of span, static string
+ * @param[in] cat - category of span, static string
+ * @param[in] start - nanoseconds since the tracer was created
+ * @param[in] dur - duration in nanoseconds
+ * @param[in] arg - position in expression, UINT64_MAX if absent
+ */
+void tracer_t::record(char const* name, char const* cat, uint64_t start, uint64_t dur, uint64_t arg) {
+  local_t& l = local();
+
+  if (!l.ring) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    l.ring = std::make_shared<ring_t>(capacity.load(std::memory_order_relaxed), rings.size() + 1);
+    rings.push_back(l.ring);
+  }
+
+  ring_t& r = *l.ring;
+  uint64_t i = r.head.load(std::memory_order_relaxed);
+  ring_t::slot_t& s = r.slots[i & r.mask];
+
+  // the exporter skips the slot until its sequence number is even again
+  s.seq.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.name.store(name, std::memory_order_relaxed);
+  s.cat.store(cat, std::memory_order_relaxed);
+  s.start.store(start, std::memory_order_relaxed);
+  s.dur.store(dur, std::memory_order_relaxed);
+  s.arg.store(arg, std::memory_order_relaxed);
+  s.seq.store(2 * i + 2, std::memory_order_release);
+  r.head.store(i + 1, std::memory_order_release);
+}
+
+/**
+ * Write recorded events in Chrome trace-event JSON
+ * @param[in] out - stream
+ */
+void tracer_t::write(std::ostream& out) const {
+  std::vector<std::shared_ptr<ring_t>> all;
+  uint64_t first = since.load(std::memory_order_relaxed);
+  bool comma = false;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    all = rings;
+  }
+
+  out << "{\"traceEvents\":[";
+  for (auto& ring : all) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t size = ring->mask + 1;
+
+    for (uint64_t i = head > size ? head - size : 0; i < head; ++i) {
+      ring_t::slot_t const& s = ring->slots[i & ring->mask];
+      uint64_t seq = s.seq.load(std::memory_order_acquire);
+      char const* name = s.name.load(std::memory_order_relaxed);
+      char const* cat = s.cat.load(std::memory_order_relaxed);
+      uint64_t start = s.start.load(std::memory_order_relaxed);
+      uint64_t dur = s.dur.load(std::memory_order_relaxed);
+      uint64_t arg = s.arg.load(std::memory_order_relaxed);
+
+      // the event was overwritten while it was read
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq != 2 * i + 2 || s.seq.load(std::memory_order_relaxed) != seq || start < first)
+        continue;
+
+      out << (comma ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << cat
+          << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid << ",\"ts\":";
+      micros(out, start);
+      out << ",\"dur\":";
+      micros(out, dur);
+      if (arg != UINT64_MAX)
+        out << ",\"args\":{\"pos\":" << arg << '}';
+      out << '}';
+      comma = true;
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+/**
+ * Write recorded events in Chrome trace-event JSON to file
+ * @param[in] path - path to file
+ * @return false if the file can't be written
+ */
+bool tracer_t::save(std::string const& path) const {
+  std::ofstream out(path);
+
+  if (!out)
+    return false;
+  write(out);
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * @brief Class of the process-wide tracer which records spans of pipeline activity into per-thread rings
+ * and exports them in Chrome trace-event format
+ * @warning the tracer is global, so that scanner, loader and evaluators need no reference to it. While it is
+ * disabled a span costs one relaxed load. Only the owner thread writes its ring, the exporter reads it
+ * without locks and skips the events being overwritten.
+ */
+class tracer_t {
+public:
+  /**
+   * @brief Options of recording
+   */
+  struct options_t {
+    double sampling = 1.0;      ///< share of top-level spans which are recorded with their nested spans
+    uint64_t slowCall = 10000;  ///< nanoseconds, operation calls which take longer are recorded
+    size_t events = 16384;      ///< events kept by every thread, the oldest ones are overwritten
+  };
+
+private:
+  /**
+   * @brief Ring of events of one thread
+   */
+  struct ring_t {
+    /**
+     * @brief Event guarded by sequence number, odd while it is being written
+     */
+    struct slot_t {
+      std::atomic<uint64_t> seq{0};             ///< 2 * index + 2 when the event of index is written
+      std::atomic<char const*> name{nullptr};   ///< name of span
+      std::atomic<char const*> cat{nullptr};    ///< category of span
+      std::atomic<uint64_t> start{0};           ///< nanoseconds since the tracer was created
+      std::atomic<uint64_t> dur{0};             ///< nanoseconds
+      std::atomic<uint64_t> arg{0};             ///< position in expression, UINT64_MAX if absent
+    };
+
+    std::unique_ptr<slot_t[]> slots;  ///< events
+    size_t mask;                      ///< capacity - 1, capacity is a power of two
+    std::atomic<uint64_t> head{0};    ///< index of the next event
+    uint64_t tid;                     ///< number of the thread in trace
+
+    /**
+     * Constructor
+     * @param[in] capacity - least number of events
+     * @param[in] id - number of the thread in trace
+     */
+    ring_t(size_t capacity, uint64_t id);
+  };
+
+  /**
+   * @brief Spans of the thread being recorded
+   */
+  struct local_t {
+    std::shared_ptr<ring_t> ring;  ///< ring of the thread, made by its first event
+    size_t depth = 0;              ///< open spans
+    bool sampled = false;          ///< the top-level span is recorded
+    uint64_t counter = 0;          ///< top-level spans opened
+  };
+
+  std::chrono::steady_clock::time_point epoch;  ///< moment the timestamps start from
+  std::atomic<uint64_t> period{1};              ///< every period-th top-level span is recorded
+  std::atomic<uint64_t> slow{10000};            ///< nanoseconds of recorded operation calls
+  std::atomic<size_t> capacity{16384};          ///< events of new rings
+  std::atomic<uint64_t> since{0};               ///< events which started before are cleared
+
+  mutable std::mutex lock;                      ///< protects rings
+  std::vector<std::shared_ptr<ring_t>> rings;   ///< rings of all threads which have recorded events
+
+  /**
+   * Returns spans of the calling thread
+   * @return spans
+   */
+  static local_t& local() noexcept;
+
+  /**
+   * Add event to the ring of the calling thread
+   * @param[in] name - name of span, static string
+   * @param[in] cat - category of span, static string
+   * @param[in] start - nanoseconds since the tracer was created
+   * @param[in] dur - duration in nanoseconds
+   * @param[in] arg - position in expression, UINT64_MAX if absent
+   */
+  void record(char const* name, char const* cat, uint64_t start, uint64_t dur, uint64_t arg);
+
+  /**
+   * Constructor
+   */
+  tracer_t() : epoch(std::chrono::steady_clock::now()) {}
+
+public:
+  inline static std::atomic<bool> on{false};  ///< spans are recorded
+
+  /**
+   * Returns the tracer
+   * @return tracer
+   */
+  static tracer_t& instance();
+
+  tracer_t(tracer_t const&) = delete;
+  tracer_t& operator=(tracer_t const&) = delete;
+
+  /**
+   * Start recording
+   * @param[in] options - options of recording
+   */
+  void enable(options_t const& options);
+
+  /**
+   * Stop recording, the recorded events stay until clear()
+   */
+  void disable() noexcept {
+    on.store(false, std::memory_order_relaxed);
+  }
+
+  /**
+   * Forget recorded events
+   */
+  void clear() noexcept {
+    since.store(now(), std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns timestamp
+   * @return nanoseconds since the tracer was created
+   */
+  uint64_t now() const noexcept {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - epoch).count());
+  }
+
+  /**
+   * Open span of the calling thread
+   * @param[out] start - timestamp of the span if it is sampled
+   * @return true if the span is sampled
+   */
+  bool begin(uint64_t& start) noexcept;
+
+  /**
+   * Close span of the calling thread
+   * @param[in] name - name of span, static string
+   * @param[in] cat - category of span, static string
+   * @param[in] start - timestamp of the span
+   * @param[in] sampled - the span is recorded
+   * @param[in] arg - position in expression, UINT64_MAX if absent
+   */
+  void end(char const* name, char const* cat, uint64_t start, bool sampled, uint64_t arg);
+
+  /**
+   * Check if the calling thread records operation calls
+   * @return true if the tracer is enabled and the current top-level span is sampled
+   */
+  bool timed() noexcept {
+    if (!on.load(std::memory_order_relaxed))
+      return false;
+
+    local_t const& l = local();
+
+    return l.depth && l.sampled;
+  }
+
+  /**
+   * Record operation call if it was slow
+   * @param[in] name - name of span, static string
+   * @param[in] start - timestamp of the call
+   * @param[in] pos - position of the operation in expression
+   */
+  void call(char const* name, uint64_t start, uint64_t pos) {
+    uint64_t dur = now() - start;
+
+    if (dur >= slow.load(std::memory_order_relaxed))
+      record(name, "plugin", start, dur, pos);
+  }
+
+  /**
+   * Write recorded events in Chrome trace-event JSON
+   * @param[in] out - stream
+   */
+  void write(std::ostream& out) const;
+
+  /**
+   * Write recorded events in Chrome trace-event JSON to file
+   * @param[in] path - path to file
+   * @return false if the file can't be written
+   */
+  bool save(std::string const& path) const;
+};
+
+/**
+ * @brief Span of pipeline activity which lasts until destruction
+ */
+class trace_span_t {
+private:
+  char const* name;      ///< name of span, static string
+  char const* cat;       ///< category of span, static string
+  uint64_t arg;          ///< position in expression, UINT64_MAX if absent
+  uint64_t start = 0;    ///< timestamp
+  bool open = false;     ///< the span counts in the depth of its thread
+  bool sampled = false;  ///< the span is recorded
+
+public:
+  /**
+   * Constructor
+   * @param[in] n - name of span, static string
+   * @param[in] c - category of span, static string
+   * @param[in] a - position in expression, UINT64_MAX if absent
+   */
+  trace_span_t(char const* n, char const* c, uint64_t a = UINT64_MAX) noexcept : name(n), cat(c), arg(a) {
+    if (tracer_t::on.load(std::memory_order_relaxed)) {
+      open = true;
+      sampled = tracer_t::instance().begin(start);
+    }
+  }
+
+  trace_span_t(trace_span_t const&) = delete;
+  trace_span_t& operator=(trace_span_t const&) = delete;
+
+  /**
+   * Destructor, records the span
+   */
+  ~trace_span_t() {
+    if (open)
+      tracer_t::instance().end(name, cat, start, sampled, arg);
+  }
+};
@@ -0,0 +1,158 @@
+#include "tree.h"
+#include "error.h"
+
+/**
+ * Create number node
+ * @param[in] val - value of number
+ * @return created node
+ */
+expr_tree_t expr_node_t::makeNumber(double val) {
+  expr_tree_t node(new expr_node_t);
+
+  node->type = node_type_t::NODE_TYPE_NUMBER;
+  node->value = val;
+  return node;
+}
+
+/**
+ * Create variable node
+ * @param[in] varp - variable
+ * @return created node
+ */
+expr_tree_t expr_node_t::makeVariable(std::shared_ptr<variable_t> varp) {
+  expr_tree_t node(new expr_node_t);
+
+  node->type = node_type_t::NODE_TYPE_VARIABLE;
+  node->var = varp;
+  return node;
+}
+
+/**
+ * Create operation node
+ * @param[in] opp - operation
+ * @param[in] operands - operands from left to right
+ * @return created node
+ */
+expr_tree_t expr_node_t::makeOperation(std::shared_ptr<operation_t> opp, std::vector<expr_tree_t> operands) {
+  expr_tree_t node(new expr_node_t);
+
+  node->type = node_type_t::NODE_TYPE_OPERATION;
+  node->operation = opp;
+  node->args = std::move(operands);
+  return node;
+}
+
+/**
+ * Restore expression tree from rpn queue
+ * @warning throws calc_exception_t if the queue is not a single correct expression
+ * @warning brackets are dropped from the tree
+ * @param[in] rpnTokens - rpn queue
+ * @param[out] rpnTokens - empty queue
+ * @return root of the tree
+ */
+expr_tree_t expr_node_t::fromRpn(token_queue_t& rpnTokens) {
+  std::vector<expr_tree_t> operands;
+  size_t pos = 0;
+
+  while (!rpnTokens.empty()) {
+    std::unique_ptr<token_t> tok = std::move(rpnTokens.front());
+    rpnTokens.pop();
+    pos = tok->pos;
+
+    switch (tok->type) {
+      case token_t::token_type_t::TOKEN_TYPE_NUMBER:
+        operands.push_back(makeNumber(static_cast<token_number_t*>(tok.get())->value));
+        break;
+      case token_t::token_type_t::TOKEN_TYPE_VARIABLE:
+        operands.push_back(makeVariable(static_cast<token_variable_t*>(tok.get())->var));
+        break;
+      default:
+      {
+        std::shared_ptr<operation_t> op = static_cast<token_operation_t*>(tok.get())->operation;
+        size_t n = op->arity();
+
+        if (n == 0) // brackets do nothing
+          continue;
+        if (operands.size() < n)
+          throw calc_exception_t(calc_error_t::SYNTAX, pos, "Syntax error");
+
+        std::vector<expr_tree_t> args(std::make_move_iterator(operands.end() - n),
+                                      std::make_move_iterator(operands.end()));
+        operands.resize(operands.size() - n);
+        operands.push_back(makeOperation(op, std::move(args)));
+        break;
+      }
+    }
+    operands.back()->pos = pos;
+  }
+
+  if (operands.size() != 1)
+    throw calc_exception_t(calc_error_t::SYNTAX, pos, "Syntax error");
+
+  return std::move(operands.back());
+}
+
+/**
+ * Write the tree into rpn queue
+ * @param[out] rpnTokens - queue where tokens are appended
+ */
+void expr_node_t::toRpn(token_queue_t& rpnTokens) const {
+  switch (type) {
+    case node_type_t::NODE_TYPE_NUMBER:
+      rpnTokens.push(std::unique_ptr<token_t>(new token_number_t(value)));
+      break;
+    case node_type_t::NODE_TYPE_VARIABLE:
+      rpnTokens.push(std::unique_ptr<token_t>(new token_variable_t(var)));
+      break;
+    default:
+      for (auto& arg : args)
+        arg->toRpn(rpnTokens);
+      rpnTokens.push(std::unique_ptr<token_t>(new token_operation_t(operation)));
+      break;
+  }
+  rpnTokens.back()->pos = pos;
+}
+
+/**
+ * Make deep copy of the tree
+ * @return copy of the tree
+ */
+expr_tree_t expr_node_t::clone() const {
+  expr_tree_t node(new expr_node_t);
+
+  node->type = type;
+  node->value = value;
+  node->var = var;
+  node->operation = operation;
+  node->pos = pos;
+  for (auto& arg : args)
+    node->args.push_back(arg->clone());
+  return node;
+}
+
+/**
+ * Count operation nodes in the tree
+ * @return number of operations
+ */
+size_t expr_node_t::countOperations() const {
+  size_t res = type == node_type_t::NODE_TYPE_OPERATION ? 1 : 0;
+
+  for (auto& arg : args)
+    res += arg->countOperations();
+  return res;
+}
+
+/**
+ * Check if the tree refers to the variable
+ * @param[in] v - variable
+ * @return true if the variable is used in the tree
+ */
+bool expr_node_t::dependsOn(variable_t const* v) const {
+  if (type == node_type_t::NODE_TYPE_VARIABLE)
+    return var.get() == v;
+
+  for (auto& arg : args)
+    if (arg->dependsOn(v))
+      return true;
+  return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include "include/operation.h"
+#include "include/variable.h"
+
+/**
+ * @brief Node of the expression tree restored from rpn queue
+ */
+struct expr_node_t {
+  /**
+   * @brief Possible types of node
+   */
+  enum class node_type_t {
+    NODE_TYPE_NUMBER,
+    NODE_TYPE_VARIABLE,
+    NODE_TYPE_OPERATION
+  };
+
+  node_type_t type;                                ///< type of current node
+  double value = 0;                                ///< value of number node
+  std::shared_ptr<variable_t> var;                 ///< variable of variable node
+  std::shared_ptr<operation_t> operation;          ///< operation of operation node
+  std::vector<std::unique_ptr<expr_node_t>> args;  ///< operands of operation node from left to right
+  size_t pos = 0;                                  ///< position of the node in expression
+
+  /**
+   * Create number node
+   * @param[in] val - value of number
+   * @return created node
+   */
+  static std::unique_ptr<expr_node_t> makeNumber(double val);
+
+  /**
+   * Create variable node
+   * @param[in] varp - variable
+   * @return created node
+   */
+  static std::unique_ptr<expr_node_t> makeVariable(std::shared_ptr<variable_t> varp);
+
+  /**
+   * Create operation node
+   * @param[in] opp - operation
+   * @param[in] operands - operands from left to right
+   * @return created node
+   */
+  static std::unique_ptr<expr_node_t> makeOperation(std::shared_ptr<operation_t> opp,
+                                                    std::vector<std::unique_ptr<expr_node_t>> operands);
+
+  /**
+   * Restore expression tree from rpn queue
+   * @warning throws calc_exception_t if the queue is not a single correct expression
+   * @warning brackets are dropped from the tree
+   * @param[in] rpnTokens - rpn queue
+   * @param[out] rpnTokens - empty queue
+   * @return root of the tree
+   */
+  static std::unique_ptr<expr_node_t> fromRpn(token_queue_t& rpnTokens);
+
+  /**
+   * Write the tree into rpn queue
+   * @param[out] rpnTokens - queue where tokens are appended
+   */
+  void toRpn(token_queue_t& rpnTokens) const;
+
+  /**
+   * Make deep copy of the tree
+   * @return copy of the tree
+   */
+  std::unique_ptr<expr_node_t> clone() const;
+
+  /**
+   * Count operation nodes in the tree
+   * @return number of operations
+   */
+  size_t countOperations() const;
+
+  /**
+   * Check if the tree refers to the variable
+   * @param[in] v - variable
+   * @return true if the variable is used in the tree
+   */
+  bool dependsOn(variable_t const* v) const;
+
+  /**
+   * Check if the node is an operation of the given kind
+   * @param[in] k - kind of operation
+   * @return true if the node is operation of kind k
+   */
+  bool is(operation_t::operation_kind_t k) const noexcept {
+    return type == node_type_t::NODE_TYPE_OPERATION && operation->kind() == k;
+  }
+};
+
+/**
+ * @brief Owning pointer on the expression tree
+ */
+using expr_tree_t = std::unique_ptr<expr_node_t>;
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include "program.h"
+
+/**
+ * @brief Double precision number with compensation, the value is hi + lo where lo keeps the rounding error of hi
+ * @warning infinite and NaN values have zero lo, so overflow and division by zero give the same results as double
+ */
+struct compensated_t {
+  double hi = 0;  ///< rounded value
+  double lo = 0;  ///< rounding error of hi
+
+  /**
+   * Default constructor
+   */
+  compensated_t() = default;
+
+  /**
+   * Constructor
+   * @param[in] h - rounded value
+   * @param[in] l - rounding error
+   */
+  compensated_t(double h, double l = 0) : hi(h), lo(l) {}
+
+  /**
+   * Round to double precision
+   * @return hi + lo
+   */
+  explicit operator double() const noexcept {
+    return hi + lo;
+  }
+
+  /**
+   * Exact sum of two numbers
+   * @param[in] a - first term
+   * @param[in] b - second term
+   * @return rounded sum and its rounding error
+   */
+  static compensated_t twoSum(double a, double b) noexcept {
+    double s = a + b;
+
+    if (!std::isfinite(s))
+      return compensated_t(s);
+
+    double bb = s - a;
+
+    return compensated_t(s, (a - (s - bb)) + (b - bb));
+  }
+
+  /**
+   * Exact product of two numbers
+   * @param[in] a - first factor
+   * @param[in] b - second factor
+   * @return rounded product and its rounding error
+   */
+  static compensated_t twoProd(double a, double b) noexcept {
+    double p = a * b;
+
+    if (!std::isfinite(p))
+      return compensated_t(p);
+
+    return compensated_t(p, std::fma(a, b, -p));
+  }
+
+  /**
+   * Move error of the sum into lo
+   * @param[in] s - rounded value
+   * @param[in] e - error which may be as large as s
+   * @return normalized number
+   */
+  static compensated_t normalize(double s, double e) noexcept {
+    double h = s + e;
+
+    if (!std::isfinite(h))
+      return compensated_t(h);
+
+    return compensated_t(h, e - (h - s));
+  }
+
+  friend compensated_t operator-(compensated_t const& a) noexcept {
+    return compensated_t(-a.hi, -a.lo);
+  }
+
+  friend compensated_t operator+(compensated_t const& a, compensated_t const& b) noexcept {
+    compensated_t s = twoSum(a.hi, b.hi);
+
+    return normalize(s.hi, s.lo + a.lo + b.lo);
+  }
+
+  friend compensated_t operator-(compensated_t const& a, compensated_t const& b) noexcept {
+    return a + -b;
+  }
+
+  friend compensated_t operator*(compensated_t const& a, compensated_t const& b) noexcept {
+    compensated_t p = twoProd(a.hi, b.hi);
+
+    if (!std::isfinite(p.hi))
+      return p;
+
+    return normalize(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+  }
+
+  friend compensated_t operator/(compensated_t const& a, compensated_t const& b) noexcept {
+    double q = a.hi / b.hi;
+
+    if (!std::isfinite(q) || !std::isfinite(b.hi))
+      return compensated_t(q);
+
+    // remainder of the first quotient is corrected by the second one
+    compensated_t r = a - twoProd(q, b.hi) - compensated_t(q * b.lo);
+
+    return normalize(q, r.hi / b.hi);
+  }
+};
+
+/**
+ * @brief Evaluator of compiled program in the chosen precision: float, double or compensated_t
+ * @warning variables and numbers of the program are stored in double precision and converted on load,
+ * both branches of conditionals are evaluated and blended, stateful operations take only the rows of taken branches
+ */
+template <typename number_t>
+class typed_calculator_t {
+private:
+  static constexpr size_t blockSize = 256;   ///< number of rows calculated by one instruction
+  std::vector<number_t> stack;               ///< operand stack of blockSize rows per entry
+  std::vector<number_t const*> args;         ///< operand arrays of current operation
+  std::vector<double> wide;                  ///< operands and results in double for operations without compensated kernel
+  std::vector<double const*> wideArgs;       ///< operand arrays of wide
+  std::vector<number_t const*> none;         ///< columns of single row calculation
+  std::vector<number_t> one;                 ///< result of single row calculation
+  std::vector<size_t> oneFault;              ///< domain error of single row calculation
+  std::vector<double> operands;              ///< operands of a row being checked against the domain
+  std::vector<number_t> conds;               ///< conditions of the conditionals being evaluated, block per nesting level
+  std::vector<size_t> ends;                  ///< end indices of the conditionals being evaluated
+  std::vector<size_t> elses;                 ///< indices of the second branches of the conditionals being evaluated
+  std::vector<size_t> active;                ///< rows which take the branches of the operation being checked or updated
+
+  /**
+   * Perform operation on a block of operands
+   * @param[in] in - instruction with operation
+   * @param[in] top - first operand array, others follow with blockSize stride
+   * @param[out] top - results
+   * @param[in] n - number of rows
+   */
+  void apply(instr_t const& in, number_t* top, size_t n) {
+    for (size_t k = 0; k < in.arity; ++k)
+      args[k] = top + k * blockSize;
+
+    if constexpr (std::is_same_v<number_t, compensated_t>) {
+      using kind_t = operation_t::operation_kind_t;
+
+      switch (in.operation->kind()) {
+        case kind_t::ADD:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = args[0][i] + args[1][i];
+          return;
+        case kind_t::SUB:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = args[0][i] - args[1][i];
+          return;
+        case kind_t::MUL:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = args[0][i] * args[1][i];
+          return;
+        case kind_t::DIV:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = args[0][i] / args[1][i];
+          return;
+        case kind_t::NEG:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = -args[0][i];
+          return;
+        case kind_t::FMA:
+          for (size_t i = 0; i < n; ++i)
+            top[i] = args[0][i] * args[1][i] + args[2][i];
+          return;
+        default:
+          break;
+      }
+
+      // other operations are computed in double and their result is exact as far as compensation goes
+      wide.resize((in.arity + 1) * blockSize);
+      wideArgs.resize(in.arity);
+      for (size_t k = 0; k < in.arity; ++k) {
+        wideArgs[k] = wide.data() + k * blockSize;
+        for (size_t i = 0; i < n; ++i)
+          wide[k * blockSize + i] = static_cast<double>(args[k][i]);
+      }
+      double* res = wide.data() + in.arity * blockSize;
+      in.operation->evaluateBlock(wideArgs.data(), res, n);
+      for (size_t i = 0; i < n; ++i)
+        top[i] = compensated_t(res[i]);
+    }
+    else
+      in.operation->evaluateBlock(args.data(), top, n);
+  }
+
+  /**
+   * Perform stateful operation on a block of operands, the samples are taken in double precision
+   * and rows of branches which are not taken or rows with domain error are skipped
+   * @param[in] in - UPDATE instruction
+   * @param[in] st - state of the call site
+   * @param[in] i - index of instruction
+   * @param[in] top - first operand array, others follow with blockSize stride
+   * @param[out] top - results of the rows which take the branches
+   * @param[in] n - number of rows
+   * @param[in] faults - positions of domain errors of rows
+   */
+  void update(instr_t const& in, state_t& st, size_t i, number_t* top, size_t n, size_t const* faults) {
+    program_t::taken(conds.data(), elses, i, blockSize, n, active, faults);
+    wide.resize((in.arity + 1) * blockSize);
+    wideArgs.resize(in.arity);
+    for (size_t k = 0; k < in.arity; ++k) {
+      wideArgs[k] = wide.data() + k * blockSize;
+      for (size_t j = 0; j < active.size(); ++j)
+        wide[k * blockSize + j] = static_cast<double>(top[k * blockSize + active[j]]);
+    }
+    // the other rows keep their first operand, the conditionals drop it
+    double* res = wide.data() + in.arity * blockSize;
+    static_cast<stateful_t*>(in.operation)->updateBlock(st, wideArgs.data(), res, active.size());
+    for (size_t j = 0; j < active.size(); ++j)
+      top[active[j]] = static_cast<number_t>(res[j]);
+  }
+
+public:
+  /**
+   * Default constructor
+   */
+  typed_calculator_t() = default;
+
+  /**
+   * Calculate program for every row
+   * @warning throws calc_exception_t if a variable without column is uninitialized,
+   * operations which don't override evaluateBlock may throw std::exception
+   * @param[in] prog - compiled program
+   * @param[in] columns - values of variables by program slot, nullptr to use the current value of variable
+   * @param[in] rows - number of rows
+   * @param[out] results - results of rows, NaN for rows with domain error
+   * @param[out] faults - positions of domain errors by row, program_t::noFault for rows with result
+   */
+  void calculate(program_t& prog, std::vector<number_t const*> const& columns, size_t rows,
+                 std::vector<number_t>& results, std::vector<size_t>& faults) {
+    size_t maxArity = 0;
+    size_t branches = 0;
+
+    for (size_t slot = 0; slot < prog.vars.size(); ++slot)
+      if (!columns[slot] && !prog.vars[slot]->isInit())
+        throw calc_exception_t(calc_error_t::UNINITIALIZED_VARIABLE, prog.position(slot), "Uninitialized variable");
+    for (instr_t const& in : prog.code) {
+      maxArity = std::max(maxArity, in.arity);
+      branches += in.code == instr_t::opcode_t::JUMP_IF_FALSE ? 1 : 0;
+    }
+
+    stack.resize(prog.maxDepth * blockSize);
+    conds.resize(branches * blockSize);
+    args.resize(maxArity);
+    results.resize(rows);
+    faults.assign(rows, program_t::noFault);
+
+    for (size_t first = 0; first < rows; first += blockSize) {
+      size_t n = std::min(blockSize, rows - first);
+      size_t depth = 0;
+      size_t* fault = faults.data() + first;
+      bool faulty = false;
+
+      ends.clear();
+      elses.clear();
+      for (size_t i = 0; i <= prog.code.size(); ++i) {
+        // both branches have been evaluated, the rows choose between them
+        for (; !ends.empty() && ends.back() == i; ends.pop_back(), elses.pop_back(), --depth)
+          program_t::select(conds.data() + (ends.size() - 1) * blockSize, stack.data() + (depth - 2) * blockSize,
+                            stack.data() + (depth - 1) * blockSize, n);
+        if (i == prog.code.size())
+          break;
+
+        instr_t const& in = prog.code[i];
+        number_t* top = stack.data() + depth * blockSize;
+
+        switch (in.code) {
+          case instr_t::opcode_t::PUSH_NUMBER:
+            std::fill(top, top + n, static_cast<number_t>(in.value));
+            ++depth;
+            break;
+          case instr_t::opcode_t::PUSH_VARIABLE:
+            if (columns[in.slot])
+              std::copy(columns[in.slot] + first, columns[in.slot] + first + n, top);
+            else
+              std::fill(top, top + n, static_cast<number_t>(prog.vars[in.slot]->getValue()));
+            ++depth;
+            break;
+          case instr_t::opcode_t::JUMP_IF_FALSE:
+            --depth;
+            std::copy(top - blockSize, top - blockSize + n, conds.data() + ends.size() * blockSize);
+            ends.push_back(i + in.slot2);
+            elses.push_back(i + in.slot);
+            break;
+          case instr_t::opcode_t::JUMP:
+            break;
+          case instr_t::opcode_t::UPDATE:
+            depth -= in.arity;
+            top = stack.data() + depth * blockSize;
+            // rows outside the domain take no sample, as a single row evaluation stops before the call
+            if (in.checked) {
+              program_t::taken(conds.data(), elses, i, blockSize, n, active, fault);
+              faulty = program_t::check(in, top, blockSize, active, operands, fault) || faulty;
+            }
+            update(in, *prog.states[in.slot], i, top, n, fault);
+            ++depth;
+            break;
+          default:
+            depth -= in.arity;
+            top = stack.data() + depth * blockSize;
+            if (in.checked) {
+              program_t::taken(conds.data(), elses, i, blockSize, n, active, fault);
+              faulty = program_t::check(in, top, blockSize, active, operands, fault) || faulty;
+            }
+            apply(in, top, n);
+            ++depth;
+            break;
+        }
+      }
+      std::copy(stack.begin(), stack.begin() + n, results.begin() + first);
+      for (size_t r = 0; faulty && r < n; ++r)
+        if (fault[r] != program_t::noFault)
+          results[first + r] = static_cast<number_t>(operation_t::domainError());
+    }
+  }
+
+  /**
+   * Calculate program with current values of variables
+   * @warning throws calc_exception_t if the program has uninitialized variables or domain error
+   * @param[in] prog - compiled program
+   * @return result of calculation
+   */
+  number_t calculate(program_t& prog) {
+    none.assign(prog.vars.size(), nullptr);
+    calculate(prog, none, 1, one, oneFault);
+    if (oneFault[0] != program_t::noFault)
+      throw calc_exception_t(calc_error_t::DOMAIN, oneFault[0], "Domain error");
+    return one[0];
+  }
+
+  /**
+   * Calculate program with current values of variables without throwing
+   * @param[in] prog - compiled program
+   * @return result of calculation rounded to double or error with its position
+   */
+  calc_result_t tryCalculate(program_t& prog) noexcept {
+    calc_result_t res;
+    size_t slot;
+
+    if (!prog.tryBind(slot)) {
+      res.error = calc_error_t::UNINITIALIZED_VARIABLE;
+      res.position = prog.position(slot);
+      return res;
+    }
+    none.assign(prog.vars.size(), nullptr);
+
+    // operations may still throw from process if they don't override evaluateBlock
+    try {
+      calculate(prog, none, 1, one, oneFault);
+    }
+    catch (std::exception&) {
+      res.error = calc_error_t::DOMAIN;
+      return res;
+    }
+    if (oneFault[0] != program_t::noFault) {
+      res.error = calc_error_t::DOMAIN;
+      res.position = oneFault[0];
+      return res;
+    }
+    res.value = static_cast<double>(one[0]);
+    return res;
+  }
+
+  /**
+   * Destructor
+   */
+  ~typed_calculator_t() = default;
+};
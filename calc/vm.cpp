@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "vm.h"
+#include "trace.h"
+
+using kind_t = operation_t::operation_kind_t;
+
+/**
+ * Take free temporary register
+ * @return register index
+ */
+uint16_t vm_compiler_t::allocate() {
+  if (!freeRegs.empty()) {
+    uint16_t reg = freeRegs.back();
+    freeRegs.pop_back();
+    return reg;
+  }
+  if (firstTemp + temps > std::numeric_limits<uint16_t>::max())
+    throw calc_exception_t(calc_error_t::INTERNAL, 0, "Too many registers");
+  return static_cast<uint16_t>(firstTemp + temps++);
+}
+
+/**
+ * Emit code of the subtree in Sethi-Ullman order
+ * @param[in] prog - source stack program
+ * @param[in] n - index of node
+ * @param[out] res - register machine program
+ */
+void vm_compiler_t::emit(program_t const& prog, size_t n, vm_program_t& res) {
+  instr_t const& in = prog.code[nodes[n].instr];
+
+  if (in.code != instr_t::opcode_t::CALL) // leaves live in fixed registers
+    return;
+
+  // the most demanding operands first, so their temporaries are free for the rest
+  std::vector<size_t> order(nodes[n].kids.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+    return nodes[nodes[n].kids[i]].need > nodes[nodes[n].kids[j]].need;
+  });
+  for (size_t i : order)
+    emit(prog, nodes[n].kids[i], res);
+
+  std::vector<uint16_t> regs;
+  for (size_t kid : nodes[n].kids) {
+    regs.push_back(nodes[kid].reg);
+    if (nodes[kid].reg >= firstTemp)
+      freeRegs.push_back(nodes[kid].reg);
+  }
+
+  vm_instr_t out;
+  out.dst = nodes[n].reg = allocate();
+  out.operation = in.operation;
+
+  switch (in.operation->kind()) {
+    case kind_t::ADD:
+      out.code = vm_instr_t::opcode_t::ADD;
+      break;
+    case kind_t::SUB:
+      out.code = vm_instr_t::opcode_t::SUB;
+      break;
+    case kind_t::MUL:
+      out.code = vm_instr_t::opcode_t::MUL;
+      break;
+    case kind_t::DIV:
+      out.code = vm_instr_t::opcode_t::DIV;
+      break;
+    case kind_t::NEG:
+      out.code = vm_instr_t::opcode_t::NEG;
+      break;
+    case kind_t::FMA:
+      out.code = vm_instr_t::opcode_t::FMA;
+      break;
+    default:
+      if (in.arity == 1)
+        out.code = vm_instr_t::opcode_t::CALL1;
+      else if (in.arity == 2)
+        out.code = vm_instr_t::opcode_t::CALL2;
+      else if (in.arity == 3)
+        out.code = vm_instr_t::opcode_t::CALL3;
+      else {
+        out.code = vm_instr_t::opcode_t::CALLN;
+        // the first operand slot and the number of operands must fit the fields of instruction
+        if (res.args.size() > std::numeric_limits<uint16_t>::max() || regs.size() > std::numeric_limits<uint16_t>::max())
+          throw calc_exception_t(calc_error_t::INTERNAL, 0, "Too many operands");
+        out.a = static_cast<uint16_t>(res.args.size());
+        out.b = static_cast<uint16_t>(regs.size());
+        res.args.insert(res.args.end(), regs.begin(), regs.end());
+        regs.clear();
+      }
+      break;
+  }
+
+  if (regs.size() > 0)
+    out.a = regs[0];
+  if (regs.size() > 1)
+    out.b = regs[1];
+  if (regs.size() > 2)
+    out.c = regs[2];
+  if (in.checked) {
+    // the check reads the operands as the call does, its destination refers to the position of the call
+    vm_instr_t check = out;
+
+    if (res.positions.size() > std::numeric_limits<uint16_t>::max())
+      throw calc_exception_t(calc_error_t::INTERNAL, 0, "Too many checked calls");
+    check.code = vm_instr_t::opcode_t::CHECK;
+    check.dst = static_cast<uint16_t>(res.positions.size());
+    res.positions.push_back(in.pos);
+    res.code.push_back(check);
+  }
+  res.code.push_back(out);
+}
+
+/**
+ * Translate stack program
+ * @warning throws calc_exception_t if the program needs more than 65536 registers, operand slots of CALLN
+ * or checked calls, has conditionals or stateful functions
+ * @param[in] prog - verified stack program
+ * @return register machine program
+ */
+vm_program_t vm_compiler_t::compile(program_t const& prog) {
+  vm_program_t res;
+  std::vector<size_t> stack;
+
+  if (prog.branches || !prog.states.empty())
+    throw calc_exception_t(calc_error_t::INTERNAL, 0,
+                           "Conditionals and stateful functions are not supported by register machine");
+
+  nodes.clear();
+  freeRegs.clear();
+  temps = 0;
+  res.vars = prog.vars;
+  res.ops = prog.ops;
+
+  // restore the tree and place leaves into variable and constant registers
+  for (size_t i = 0; i < prog.code.size(); ++i) {
+    instr_t const& in = prog.code[i];
+    node_t node;
+
+    node.instr = i;
+    switch (in.code) {
+      case instr_t::opcode_t::PUSH_NUMBER:
+      {
+        auto ci = std::find_if(res.constants.begin(), res.constants.end(), [&](double c) {
+          return std::memcmp(&c, &in.value, sizeof(double)) == 0;
+        });
+
+        node.reg = static_cast<uint16_t>(prog.vars.size() + (ci - res.constants.begin()));
+        if (ci == res.constants.end())
+          res.constants.push_back(in.value);
+        break;
+      }
+      case instr_t::opcode_t::PUSH_VARIABLE:
+        node.reg = static_cast<uint16_t>(in.slot);
+        break;
+      default:
+      {
+        std::vector<size_t> needs;
+        size_t held = 0;
+
+        node.kids.assign(stack.end() - in.arity, stack.end());
+        stack.resize(stack.size() - in.arity);
+
+        // Sethi-Ullman number: every operand evaluated earlier holds a temporary
+        for (size_t kid : node.kids)
+          needs.push_back(nodes[kid].need);
+        std::sort(needs.rbegin(), needs.rend());
+        node.need = 1;
+        for (size_t need : needs) {
+          node.need = std::max(node.need, need + held);
+          if (need > 0)
+            ++held;
+        }
+        break;
+      }
+    }
+    stack.push_back(nodes.size());
+    nodes.push_back(node);
+  }
+
+  firstTemp = prog.vars.size() + res.constants.size();
+  if (firstTemp > std::numeric_limits<uint16_t>::max())
+    throw calc_exception_t(calc_error_t::INTERNAL, 0, "Too many registers");
+
+  emit(prog, stack.back(), res);
+
+  vm_instr_t ret;
+  ret.code = vm_instr_t::opcode_t::RET;
+  res.code.push_back(ret);
+  res.result = nodes[stack.back()].reg;
+  res.registers = firstTemp + temps;
+  return res;
+}
+
+/**
+ * Run program, operands are checked only for operations with restricted domain
+ * @warning variables of the program must be initialized
+ * @param[in] prog - register machine program
+ * @return result of calculation or domain error at the first operation outside its domain
+ */
+calc_result_t vm_calculator_t::run(vm_program_t const& prog) {
+  trace_span_t span("evaluate registers", "evaluation");
+  calc_result_t res;
+
+  if (regs.size() < prog.registers)
+    regs.resize(prog.registers);
+  if (args.size() < std::max<size_t>(prog.args.size(), 3))
+    args.resize(std::max<size_t>(prog.args.size(), 3));
+
+  double* r = regs.data();
+  for (size_t i = 0; i < prog.vars.size(); ++i)
+    r[i] = prog.vars[i]->getValue();
+  std::copy(prog.constants.begin(), prog.constants.end(), r + prog.vars.size());
+
+  vm_instr_t const* ip = prog.code.data();
+
+  // threaded dispatch where labels as values are available, switch dispatch otherwise
+#if defined(__GNUC__) && !defined(CALC_VM_SWITCH_DISPATCH)
+  static void* const labels[] = {
+    &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_NEG, &&op_FMA,
+    &&op_CALL1, &&op_CALL2, &&op_CALL3, &&op_CALLN, &&op_CHECK, &&op_RET
+  };
+#define VM_DISPATCH() goto *labels[static_cast<size_t>(ip->code)];
+#define VM_OP(name) op_##name:
+#define VM_NEXT() ++ip; VM_DISPATCH()
+#else
+#define VM_DISPATCH() switch (ip->code)
+#define VM_OP(name) case vm_instr_t::opcode_t::name:
+#define VM_NEXT() ++ip; goto dispatch
+dispatch:
+#endif
+
+  VM_DISPATCH() {
+    VM_OP(ADD)
+      r[ip->dst] = r[ip->a] + r[ip->b];
+      VM_NEXT();
+    VM_OP(SUB)
+      r[ip->dst] = r[ip->a] - r[ip->b];
+      VM_NEXT();
+    VM_OP(MUL)
+      r[ip->dst] = r[ip->a] * r[ip->b];
+      VM_NEXT();
+    VM_OP(DIV)
+      r[ip->dst] = r[ip->a] / r[ip->b];
+      VM_NEXT();
+    VM_OP(NEG)
+      r[ip->dst] = -r[ip->a];
+      VM_NEXT();
+    VM_OP(FMA)
+      r[ip->dst] = std::fma(r[ip->a], r[ip->b], r[ip->c]);
+      VM_NEXT();
+    VM_OP(CALL1)
+      r[ip->dst] = ip->operation->evaluate(r + ip->a);
+      VM_NEXT();
+    VM_OP(CALL2)
+    {
+      double a[2] = { r[ip->a], r[ip->b] };
+
+      r[ip->dst] = ip->operation->evaluate(a);
+      VM_NEXT();
+    }
+    VM_OP(CALL3)
+    {
+      double a[3] = { r[ip->a], r[ip->b], r[ip->c] };
+
+      r[ip->dst] = ip->operation->evaluate(a);
+      VM_NEXT();
+    }
+    VM_OP(CALLN)
+      for (uint16_t k = 0; k < ip->b; ++k)
+        args[k] = r[prog.args[ip->a + k]];
+      r[ip->dst] = ip->operation->evaluate(args.data());
+      VM_NEXT();
+    VM_OP(CHECK)
+      if (ip->operation->arity() > 3) {
+        for (uint16_t k = 0; k < ip->b; ++k)
+          args[k] = r[prog.args[ip->a + k]];
+      }
+      else {
+        args[0] = r[ip->a];
+        args[1] = r[ip->b];
+        args[2] = r[ip->c];
+      }
+      if (!ip->operation->inDomain(args.data())) {
+        res.error = calc_error_t::DOMAIN;
+        res.position = prog.positions[ip->dst];
+        return res;
+      }
+      VM_NEXT();
+    VM_OP(RET)
+      res.value = r[prog.result];
+      return res;
+  }
+
+#undef VM_DISPATCH
+#undef VM_OP
+#undef VM_NEXT
+  res.value = r[prog.result];
+  return res;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include "program.h"
+
+/**
+ * @brief Instruction of the register machine: dst = code(a, b, c)
+ */
+struct vm_instr_t {
+  /**
+   * @brief Possible instructions
+   */
+  enum class opcode_t : uint8_t {
+    ADD,    ///< dst = a + b
+    SUB,    ///< dst = a - b
+    MUL,    ///< dst = a * b
+    DIV,    ///< dst = a / b
+    NEG,    ///< dst = -a
+    FMA,    ///< dst = a * b + c
+    CALL1,  ///< dst = operation(a)
+    CALL2,  ///< dst = operation(a, b)
+    CALL3,  ///< dst = operation(a, b, c)
+    CALLN,  ///< dst = operation(registers args[a], ..., args[a + b - 1])
+    CHECK,  ///< return domain error at positions[dst] if the operands of the next call are outside its domain
+    RET     ///< return result register
+  };
+
+  opcode_t code;                     ///< instruction
+  uint16_t dst = 0;                  ///< destination register
+  uint16_t a = 0;                    ///< first operand register
+  uint16_t b = 0;                    ///< second operand register
+  uint16_t c = 0;                    ///< third operand register
+  operation_t* operation = nullptr;  ///< operation for CALL instructions
+};
+
+/**
+ * @brief Program of the register machine
+ * @warning registers are laid out as variables, then constants, then temporaries
+ */
+struct vm_program_t {
+  std::vector<vm_instr_t> code;                   ///< instructions ending with RET
+  std::vector<double> constants;                  ///< values of constant registers
+  std::vector<uint16_t> args;                     ///< operand registers of CALLN instructions
+  std::vector<size_t> positions;                  ///< positions in expression of the calls which CHECK instructions guard
+  std::vector<std::shared_ptr<variable_t>> vars;  ///< variables by register
+  std::vector<std::shared_ptr<operation_t>> ops;  ///< operations kept alive while program exists
+  size_t registers = 0;                           ///< total number of registers
+  uint16_t result = 0;                            ///< register with result
+};
+
+/**
+ * @brief Class which translates stack program into register machine program
+ */
+class vm_compiler_t {
+private:
+  /**
+   * @brief Node of the expression tree restored from stack program
+   */
+  struct node_t {
+    size_t instr;               ///< index of instruction in stack program
+    std::vector<size_t> kids;   ///< operand nodes from left to right
+    size_t need = 0;            ///< number of temporaries needed to evaluate the node (Sethi-Ullman number)
+    uint16_t reg = 0;           ///< register with the value of node
+  };
+
+  std::vector<node_t> nodes;      ///< nodes of the tree
+  std::vector<uint16_t> freeRegs; ///< temporaries available for reuse
+  size_t temps = 0;               ///< number of allocated temporaries
+  size_t firstTemp = 0;           ///< index of the first temporary register
+
+  /**
+   * Take free temporary register
+   * @return register index
+   */
+  uint16_t allocate();
+
+  /**
+   * Emit code of the subtree in Sethi-Ullman order
+   * @param[in] prog - source stack program
+   * @param[in] n - index of node
+   * @param[out] res - register machine program
+   */
+  void emit(program_t const& prog, size_t n, vm_program_t& res);
+
+public:
+  /**
+   * Default constructor
+   */
+  vm_compiler_t() = default;
+
+  /**
+   * Translate stack program
+   * @warning throws calc_exception_t if the program needs more than 65536 registers, operand slots of CALLN
+   * or checked calls, has conditionals or stateful functions
+   * @param[in] prog - verified stack program
+   * @return register machine program
+   */
+  vm_program_t compile(program_t const& prog);
+
+  /**
+   * Destructor
+   */
+  ~vm_compiler_t() = default;
+};
+
+/**
+ * @brief Register machine with threaded dispatch
+ */
+class vm_calculator_t {
+private:
+  std::vector<double> regs;  ///< preallocated register file
+  std::vector<double> args;  ///< operands of CALLN and CHECK instructions
+
+public:
+  /**
+   * Default constructor
+   */
+  vm_calculator_t() = default;
+
+  /**
+   * Run program, operands are checked only for operations with restricted domain
+   * @warning variables of the program must be initialized
+   * @param[in] prog - register machine program
+   * @return result of calculation or domain error at the first operation outside its domain
+   */
+  calc_result_t run(vm_program_t const& prog);
+
+  /**
+   * Destructor
+   */
+  ~vm_calculator_t() = default;
+};
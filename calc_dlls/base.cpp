@@ -7,6 +7,38 @@ public:
 
   ~Plus() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::ADD;
+  }
+
+  bool isCommutative() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] + args[1];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = args[0][i] + args[1][i];
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = 1;
+    partials[1] = 1;
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double b = getNumber(stack);
     double a = getNumber(stack);
@@ -21,6 +53,34 @@ public:
 
   ~Minus() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::SUB;
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] - args[1];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = args[0][i] - args[1][i];
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = 1;
+    partials[1] = -1;
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double b = getNumber(stack);
     double a = getNumber(stack);
@@ -35,6 +95,38 @@ public:
 
   ~Mul() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::MUL;
+  }
+
+  bool isCommutative() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] * args[1];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = args[0][i] * args[1][i];
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = args[1];
+    partials[1] = args[0];
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double b = getNumber(stack);
     double a = getNumber(stack);
@@ -49,6 +141,34 @@ public:
 
   ~Div() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::DIV;
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] / args[1];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = args[0][i] / args[1][i];
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = 1 / args[1];
+    partials[1] = -args[0] / (args[1] * args[1]);
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double b = getNumber(stack);
     double a = getNumber(stack);
@@ -63,6 +183,33 @@ public:
 
   ~UnarMinus() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::NEG;
+  }
+
+  double evaluate(double const* args) override {
+    return -args[0];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = -args[0][i];
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = -1;
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double a = getNumber(stack);
 
@@ -86,6 +233,10 @@ public:
   void process(token_stack_t& stack) override {}
 };
 
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
 extern "C" __declspec(dllexport) void __cdecl load(ops_maps & m, std::map<std::string, double const>&cv) {
   m.inf.insert(std::make_pair("+", std::shared_ptr<infix_t>(new Plus)));
   m.inf.insert(std::make_pair("-", std::shared_ptr<infix_t>(new Minus)));
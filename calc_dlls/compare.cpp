@@ -0,0 +1,150 @@
+#include "include/operation.h"
+#include <cmath>
+
+/**
+ * Predicates of comparisons, the result is 1 or 0 and NaN operand is kept
+ */
+struct LessRule {
+  static bool const symmetric = false;
+  static bool test(double a, double b) { return a < b; }
+};
+
+struct GreaterRule {
+  static bool const symmetric = false;
+  static bool test(double a, double b) { return a > b; }
+};
+
+struct LessEqualRule {
+  static bool const symmetric = false;
+  static bool test(double a, double b) { return a <= b; }
+};
+
+struct GreaterEqualRule {
+  static bool const symmetric = false;
+  static bool test(double a, double b) { return a >= b; }
+};
+
+struct EqualRule {
+  static bool const symmetric = true;
+  static bool test(double a, double b) { return a == b; }
+};
+
+struct NotEqualRule {
+  static bool const symmetric = true;
+  static bool test(double a, double b) { return a != b; }
+};
+
+template <typename Rule>
+class Comparison : public infix_t {
+public:
+  Comparison() : infix_t(0.5, infix_t::operation_assoc_t::TO_RIGHT) {}
+
+  ~Comparison() = default;
+
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  bool isCommutative() const noexcept override {
+    return Rule::symmetric;
+  }
+
+  double evaluate(double const* args) override {
+    if (args[0] != args[0] || args[1] != args[1])
+      return args[0] + args[1];
+    return Rule::test(args[0], args[1]) ? 1 : 0;
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      T a = args[0][i];
+      T b = args[1][i];
+
+      res[i] = a != a || b != b ? a + b : Rule::test(a, b) ? T(1) : T(0);
+    }
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  // piecewise constant
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = 0;
+    partials[1] = 0;
+    return true;
+  }
+
+  void process(token_stack_t& stack) override {
+    double args[2];
+
+    args[1] = getNumber(stack);
+    args[0] = getNumber(stack);
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(evaluate(args))));
+  }
+};
+
+/**
+ * c ? a, the compiler lowers it with the following : into jumps so that only one branch is evaluated
+ */
+class Question : public infix_t {
+public:
+  Question() : infix_t(0.2, infix_t::operation_assoc_t::TO_LEFT) {}
+
+  ~Question() = default;
+
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::COND;
+  }
+
+  double evaluate(double const* args) override {
+    return domainError();
+  }
+
+  // c and a stay on the stack for :
+  void process(token_stack_t& stack) override {
+  }
+};
+
+class Colon : public infix_t {
+public:
+  Colon() : infix_t(0.1, infix_t::operation_assoc_t::TO_LEFT) {}
+
+  ~Colon() = default;
+
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::SELECT;
+  }
+
+  double evaluate(double const* args) override {
+    return domainError();
+  }
+
+  void process(token_stack_t& stack) override {
+    double b = getNumber(stack);
+    double a = getNumber(stack);
+    double c = getNumber(stack);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(c != c ? c : c != 0 ? a : b)));
+  }
+};
+
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
+extern "C" __declspec(dllexport) void __cdecl load(ops_maps& m, std::map<std::string, double const>& cv) {
+  m.inf.insert(std::make_pair("<", std::shared_ptr<infix_t>(new Comparison<LessRule>)));
+  m.inf.insert(std::make_pair(">", std::shared_ptr<infix_t>(new Comparison<GreaterRule>)));
+  m.inf.insert(std::make_pair("<=", std::shared_ptr<infix_t>(new Comparison<LessEqualRule>)));
+  m.inf.insert(std::make_pair(">=", std::shared_ptr<infix_t>(new Comparison<GreaterEqualRule>)));
+  m.inf.insert(std::make_pair("==", std::shared_ptr<infix_t>(new Comparison<EqualRule>)));
+  m.inf.insert(std::make_pair("!=", std::shared_ptr<infix_t>(new Comparison<NotEqualRule>)));
+  m.inf.insert(std::make_pair("?", std::shared_ptr<infix_t>(new Question)));
+  m.inf.insert(std::make_pair(":", std::shared_ptr<infix_t>(new Colon)));
+}
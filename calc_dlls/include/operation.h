@@ -2,9 +2,22 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <limits>
 #include "token.h"
 #include "variable.h"
 
+/**
+ * @brief Exception which process throws for operands outside the domain of operation
+ */
+class domain_error_t : public std::exception {
+public:
+  /**
+   * Default constructor
+   */
+  domain_error_t() : std::exception("Domain error") {}
+};
+
 /**
  * @brief Base class of operation
  * @warning Among themselves, prefix operations are performed from left to right regardless of priority
@@ -22,6 +35,22 @@ public:
     POSTFIX_OP
   };
 
+  /**
+   * @brief Well known semantics of operation which the optimizer can rely on
+   */
+  enum class operation_kind_t {
+    GENERIC,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    NEG,
+    POW,
+    FMA,
+    COND,   ///< c ? a, the condition and the taken branch of conditional
+    SELECT  ///< (c ? a) : b, the compiler lowers the pair into jumps
+  };
+
   operation_type_t const type;  ///< type of operation
   float const prior;            ///< operation priority
 
@@ -43,7 +72,149 @@ public:
    */
   virtual void process(token_stack_t& stack) = 0;
 
+  /**
+   * Performs computation on already extracted operands
+   * @warning default implementation goes through process, override it for speed
+   * param[in] args - arity() operands from left to right
+   * @return result of operation
+   */
+  virtual double evaluate(double const* args) {
+    token_stack_t stack;
+
+    for (size_t i = 0, n = arity(); i < n; ++i)
+      stack.push(std::unique_ptr<token_number_t>(new token_number_t(args[i])));
+    process(stack);
+    return getNumber(stack);
+  }
+
+  /**
+   * Performs computation on blocks of operands
+   * @warning default implementation calls evaluate for every element, override it for vectorization
+   * param[in] args - arity() arrays of n operands
+   * param[out] res - n results, may coincide with args[0]
+   * param[in] n - number of elements in each array
+   */
+  virtual void evaluateBlock(double const* const* args, double* res, size_t n) {
+    std::vector<double> a(arity());
+
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < a.size(); ++k)
+        a[k] = args[k][i];
+      res[i] = evaluate(a.data());
+    }
+  }
+
+  /**
+   * Performs computation on blocks of single precision operands
+   * @warning default implementation calls evaluate in double precision for every element, override it for vectorization
+   * param[in] args - arity() arrays of n operands
+   * param[out] res - n results, may coincide with args[0]
+   * param[in] n - number of elements in each array
+   */
+  virtual void evaluateBlock(float const* const* args, float* res, size_t n) {
+    std::vector<double> a(arity());
+
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < a.size(); ++k)
+        a[k] = args[k][i];
+      res[i] = static_cast<float>(evaluate(a.data()));
+    }
+  }
+
+  /**
+   * Value which evaluate returns for operands outside the domain
+   * @warning evaluators tell domain errors by inDomain, NaN is an ordinary result otherwise, e.g. of 0 / 0
+   * @return quiet NaN
+   */
+  static double domainError() noexcept {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  /**
+   * Returns true if the operation is not defined for some operands, so evaluators check them by inDomain
+   * @return false unless the operation restricts its domain
+   */
+  virtual bool hasDomain() const noexcept {
+    return false;
+  }
+
+  /**
+   * Check operands against the domain of operation, evaluators call it before evaluate if hasDomain is true
+   * @warning NaN operands are in the domain unless the operation says otherwise, they give NaN result
+   * param[in] args - arity() operands from left to right
+   * @return false if the operation is not defined for the operands
+   */
+  virtual bool inDomain(double const* args) const noexcept {
+    return true;
+  }
+
+  /**
+   * Returns the number of operands taken by process
+   * @return number of operands
+   */
+  virtual size_t arity() const noexcept {
+    return type == operation_type_t::INFIX_OP ? 2 : 1;
+  }
+
+  /**
+   * Returns the semantics of operation
+   * @return GENERIC unless the operation is one of the well known arithmetic operations
+   */
+  virtual operation_kind_t kind() const noexcept {
+    return operation_kind_t::GENERIC;
+  }
+
+  /**
+   * Returns true if the result depends only on operands and the operation has no side effects
+   * @warning only pure functions may be memoized
+   * @return false unless the operation declares itself pure
+   */
+  virtual bool isPure() const noexcept {
+    return false;
+  }
+
+  /**
+   * Returns operation which computes the same with the last operand fixed, e.g. power with a constant exponent
+   * @warning the compiler calls it when the last operand is a number, the returned operation takes arity() - 1
+   * operands and must give the same results
+   * param[in] value - value of the last operand
+   * @return specialized operation or nullptr if there is none
+   */
+  virtual std::shared_ptr<operation_t> specialize(double value) const {
+    return nullptr;
+  }
+
+  /**
+   * Returns true if the operands of infix operation may be swapped without changing the result
+   * @warning canonical forms of expressions sort operands of such operations, so programs are shared among them
+   * @return false unless the operation declares itself commutative
+   */
+  virtual bool isCommutative() const noexcept {
+    return false;
+  }
+
+  /**
+   * Computes partial derivatives of the result by each operand
+   * @warning default implementation has no rule, override it to support automatic differentiation
+   * param[in] args - arity() operands from left to right
+   * param[out] partials - arity() derivatives of the result by operands
+   * @return false if the operation has no derivative rule
+   */
+  virtual bool derivative(double const* args, double* partials) {
+    return false;
+  }
+
 protected:
+  /**
+   * Check operands of process against the domain of operation
+   * @warning throws domain_error_t if the operation is not defined for the operands
+   * param[in] args - arity() operands from left to right
+   */
+  void checkDomain(double const* args) const {
+    if (!inDomain(args))
+      throw domain_error_t();
+  }
+
   /**
    * Extract a number from the operand stack
    * @warning throws std::exception in case of failure
@@ -51,6 +222,9 @@ protected:
    * @return extracted value
    */
   double getNumber(token_stack_t& stack) {
+    if (stack.empty())
+      throw std::exception("Syntax error");
+
     std::unique_ptr<token_t> tok = std::move(stack.top());
     stack.pop();
 
@@ -63,8 +237,8 @@ protected:
     }
 
     token_variable_t* var = static_cast<token_variable_t*>(tok.get());
-    if (var->var.get()->isInit())
-      return var->var.get()->getValue();
+    if (var->var->isInit())
+      return var->var->getValue();
     else
       throw std::exception("Uninitialized variable");
   }
@@ -81,6 +255,120 @@ public:
   function_t() : operation_t(operation_type_t::FUNCTION, -1.0) {}
 };
 
+/**
+ * @brief Base class of function which takes any number of operands separated by commas
+ * @warning the parser replaces it with the operation made by bind at every call site
+ */
+class variadic_t : public function_t {
+public:
+  /**
+   * Default constructor
+   */
+  variadic_t() = default;
+
+  /**
+   * Make operation for the call site
+   * param[in] n - number of operands at the call site
+   * @return operation which takes n operands
+   */
+  virtual std::shared_ptr<operation_t> bind(size_t n) = 0;
+
+  /**
+   * Performs operand processing as a call site with one operand
+   * param[in] stack - stack of operands
+   */
+  void process(token_stack_t& stack) override {
+    bind(1)->process(stack);
+  }
+};
+
+/**
+ * @brief State of stateful function in one evaluation context
+ */
+class state_t {
+public:
+  double result = std::numeric_limits<double>::quiet_NaN();  ///< result of the last update
+
+  /**
+   * Forget all samples
+   */
+  virtual void reset() = 0;
+
+  /**
+   * Virtual destructor for the correct destruction of heirs
+   */
+  virtual ~state_t() {};
+};
+
+/**
+ * @brief Base class of function whose result depends on the operands of previous evaluations
+ * @warning every call site of a compiled program has its own state, process and evaluate take a single sample
+ * into an empty state, so evaluation outside of compiled programs has no history and shares nothing between threads
+ */
+class stateful_t : public function_t {
+public:
+  /**
+   * Default constructor
+   */
+  stateful_t() = default;
+
+  /**
+   * Make empty state for a new evaluation context
+   * @return state
+   */
+  virtual std::unique_ptr<state_t> makeState() const = 0;
+
+  /**
+   * Take the operands of the next sample, in amortized O(1) regardless of the history
+   * param[in] state - state of the evaluation context
+   * param[in] args - arity() operands from left to right
+   * @return result of function
+   */
+  virtual double update(state_t& state, double const* args) = 0;
+
+  /**
+   * Take the operands of n consecutive samples
+   * @warning default implementation calls update for every element
+   * param[in] state - state of the evaluation context
+   * param[in] args - arity() arrays of n operands
+   * param[out] res - n results, may coincide with args[0]
+   * param[in] n - number of samples
+   */
+  virtual void updateBlock(state_t& state, double const* const* args, double* res, size_t n) {
+    std::vector<double> a(arity());
+
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < a.size(); ++k)
+        a[k] = args[k][i];
+      res[i] = state.result = update(state, a.data());
+    }
+  }
+
+  /**
+   * Take a single sample into an empty state
+   * param[in] args - arity() operands from left to right
+   * @return result of function for the only sample
+   */
+  double evaluate(double const* args) override {
+    std::unique_ptr<state_t> st = makeState();
+
+    return update(*st, args);
+  }
+
+  /**
+   * Performs operand processing
+   * param[in] stack - stack of operands
+   */
+  void process(token_stack_t& stack) override {
+    std::vector<double> args(arity());
+
+    for (size_t k = args.size(); k-- > 0;)
+      args[k] = getNumber(stack);
+    checkDomain(args.data());
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(evaluate(args.data()))));
+  }
+};
+
 /**
  * @brief Type of function storage
  */
@@ -168,6 +456,13 @@ public:
    */
   open_bracket_t(int id) : prefix_op_t(prefix_type_t::OPEN_BRACKET, -1.0), pairID(id) {}
 
+  /**
+   * Brackets take no operands
+   */
+  size_t arity() const noexcept override final {
+    return 0;
+  }
+
   /**
    * Does nothing
    */
@@ -227,6 +522,13 @@ public:
    * param[in] id - id of the bracket pair
    */
   close_bracket_t(int id) : postfix_op_t(postfix_type_t::CLOSE_BRACKET, -1.0), pairID(id) {}
+
+  /**
+   * Brackets take no operands
+   */
+  size_t arity() const noexcept override final {
+    return 0;
+  }
 };
 
 /**
@@ -237,4 +539,11 @@ struct ops_maps {
   inf_map inf;
   pref_map pref;
   postf_map postf;
-};
\ No newline at end of file
+};
+
+/**
+ * Version of the plugin interface, every plugin exports it by abiVersion and the calculator loads only plugins
+ * of its own version
+ * @warning increase it on every change of the classes of these headers, plugins built with other headers corrupt them
+ */
+constexpr unsigned pluginAbiVersion = 2;
\ No newline at end of file
@@ -19,6 +19,7 @@ struct token_t {
   };
 
   token_type_t type;      ///< type of current token
+  size_t pos = 0;         ///< position of current token in expression
 };
 
 /**
@@ -1,23 +1,300 @@
 #include "include/operation.h"
 #include <cmath>
+#include <array>
+#include <vector>
+#include <utility>
+
+/**
+ * Raise to a power known at compile time by a chain of multiplications
+ * @warning relative error is below |N| ulp (plus 1 ulp for negative N), pow is below 1 ulp
+ * param[in] x - operand
+ * @return x ^ N
+ */
+template <int N>
+inline double powConst(double x) {
+  if constexpr (N < 0) {
+    double res = powConst<-N>(x);
+
+    // the reciprocal of overflowed or subnormal power would lose a result which is representable
+    return std::isnormal(res) ? 1.0 / res : std::pow(x, static_cast<double>(N));
+  }
+  else if constexpr (N == 0)
+    return 1.0;
+  else if constexpr (N == 1)
+    return x;
+  else if constexpr (N % 2 == 0) {
+    double half = powConst<N / 2>(x);
+    return half * half;
+  }
+  else
+    return x * powConst<N - 1>(x);
+}
+
+/**
+ * Raise to an integer power known only at runtime by exponentiation by squaring
+ * @warning relative error is below |n| ulp (plus 1 ulp for negative n), pow is below 1 ulp
+ * param[in] x - operand
+ * param[in] n - integer power
+ * @return x ^ n
+ */
+inline double powInt(double x, long long n) {
+  double const x0 = x;
+  unsigned long long e = n < 0 ? 0ULL - static_cast<unsigned long long>(n) : n;
+  double res = 1.0;
+
+  while (e != 0) {
+    if (e & 1)
+      res *= x;
+    x *= x;
+    e >>= 1;
+  }
+
+  if (n >= 0)
+    return res;
+  // the reciprocal of overflowed or subnormal power would lose a result which is representable
+  return std::isnormal(res) ? 1.0 / res : std::pow(x0, static_cast<double>(n));
+}
+
+/**
+ * Smallest and largest powers which have a specialized multiplication chain
+ */
+constexpr int minConstPower = -4;
+constexpr int maxConstPower = 8;
+
+/**
+ * Largest integer power which is computed by squaring instead of pow,
+ * keeps the relative difference from pow below 64 ulp (~1.5e-14)
+ */
+constexpr int maxIntPower = 64;
+
+/**
+ * Build table of specialized multiplication chains for powers [minConstPower, maxConstPower]
+ */
+template <int... I>
+constexpr std::array<double (*)(double), sizeof...(I)> makeConstPowers(std::integer_sequence<int, I...>) {
+  return { &powConst<I + minConstPower>... };
+}
+
+static constexpr auto constPowers =
+  makeConstPowers(std::make_integer_sequence<int, maxConstPower - minConstPower + 1>());
+
+/**
+ * Choose the cheapest way to raise to the power
+ * @warning agrees with pow within the tolerance stated for powConst and powInt
+ * param[in] operand - operand
+ * param[in] power - power
+ * @return operand ^ power
+ */
+inline double fastPow(double operand, double power) {
+  if (power == std::trunc(power)) {
+    if (power >= minConstPower && power <= maxConstPower)
+      return constPowers[static_cast<int>(power) - minConstPower](operand);
+    if (std::fabs(power) <= maxIntPower)
+      return powInt(operand, static_cast<long long>(power));
+  }
+  else if (operand > 0) { // sqrt differs from pow for -0 and -inf
+    if (power == 0.5)
+      return std::sqrt(operand);
+    if (power == -0.5)
+      return 1.0 / std::sqrt(operand);
+    if (power == 1.5)
+      return operand * std::sqrt(operand);
+  }
+
+  return pow(operand, power);
+}
+
+/**
+ * Raise to the power without throwing
+ * param[in] operand - operand
+ * param[in] power - power
+ * @return operand ^ power or domain error if both are negative
+ */
+inline double checkedPow(double operand, double power) {
+  if (operand < 0 && power < 0)
+    return operation_t::domainError();
+
+  return fastPow(operand, power);
+}
+
+/**
+ * Power with a specialized multiplication chain, the exponent is a template argument
+ */
+template <int N>
+struct ConstPower {
+  static constexpr long long power = N;
+
+  double operator()(double x) const {
+    return powConst<N>(x);
+  }
+};
+
+/**
+ * Power computed by squaring, the exponent is fixed at construction
+ */
+struct IntPower {
+  long long power;
+
+  double operator()(double x) const {
+    return powInt(x, power);
+  }
+};
+
+/**
+ * Raising to the integer power which was a constant of the compiled expression,
+ * it takes the same path as fastPow without testing the exponent on every evaluation
+ */
+template <typename Raise>
+class PowFixed : public function_t {
+private:
+  Raise raise;
+
+public:
+  explicit PowFixed(Raise r) : raise(r) {}
+
+  ~PowFixed() = default;
+
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  bool hasDomain() const noexcept override {
+    return raise.power < 0;
+  }
+
+  bool inDomain(double const* args) const noexcept override {
+    return !(args[0] < 0 && raise.power < 0);
+  }
+
+  double evaluate(double const* args) override {
+    return args[0] < 0 && raise.power < 0 ? domainError() : raise(args[0]);
+  }
+
+  template <typename T>
+  void kernel(T const* const* args, T* res, size_t n) const {
+    for (size_t i = 0; i < n; ++i) {
+      double x = args[0][i];
+
+      res[i] = static_cast<T>(x < 0 && raise.power < 0 ? domainError() : raise(x));
+    }
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    double b = static_cast<double>(raise.power);
+
+    partials[0] = b == 0 ? 0 : b * std::pow(args[0], b - 1);
+    return true;
+  }
+
+  void process(token_stack_t& stack) override {
+    double operand = getNumber(stack);
+
+    checkDomain(&operand);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(raise(operand))));
+  }
+};
+
+/**
+ * Make specialized operations for the powers with multiplication chains
+ * param[out] fixed - operations by power + maxIntPower
+ */
+template <int... I>
+void addConstPowers(std::vector<std::shared_ptr<operation_t>>& fixed, std::integer_sequence<int, I...>) {
+  ((fixed[I + minConstPower + maxIntPower] =
+    std::make_shared<PowFixed<ConstPower<I + minConstPower>>>(ConstPower<I + minConstPower>())), ...);
+}
 
 class Pow : public infix_t {
+private:
+  // made in advance, so registries shared by threads are never modified
+  std::vector<std::shared_ptr<operation_t>> fixed;
+
 public:
-  Pow() : infix_t(5.0, infix_t::operation_assoc_t::TO_LEFT) {}
+  Pow() : infix_t(5.0, infix_t::operation_assoc_t::TO_LEFT), fixed(2 * maxIntPower + 1) {
+    for (int n = -maxIntPower; n <= maxIntPower; ++n)
+      fixed[n + maxIntPower] = std::make_shared<PowFixed<IntPower>>(IntPower{ n });
+    addConstPowers(fixed, std::make_integer_sequence<int, maxConstPower - minConstPower + 1>());
+  }
 
   ~Pow() = default;
 
+  operation_kind_t kind() const noexcept override {
+    return operation_kind_t::POW;
+  }
+
+  // a negative base has no negative powers, other NaN results such as (-8) ^ (1/3) are ordinary values
+  bool hasDomain() const noexcept override {
+    return true;
+  }
+
+  bool inDomain(double const* args) const noexcept override {
+    return !(args[0] < 0 && args[1] < 0);
+  }
+
+  double evaluate(double const* args) override {
+    return checkedPow(args[0], args[1]);
+  }
+
+  std::shared_ptr<operation_t> specialize(double value) const override {
+    if (value != std::trunc(value) || std::fabs(value) > maxIntPower)
+      return nullptr;
+    return fixed[static_cast<int>(value) + maxIntPower];
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = static_cast<T>(checkedPow(args[0][i], args[1][i]));
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    double a = args[0];
+    double b = args[1];
+
+    partials[0] = b == 0 ? 0 : b * std::pow(a, b - 1);
+    // the derivative by exponent exists only for positive base
+    if (a > 0)
+      partials[1] = std::pow(a, b) * std::log(a);
+    else if (a == 0 && b > 0)
+      partials[1] = 0;
+    else
+      partials[1] = domainError();
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
-    double power = getNumber(stack);
-    double operand = getNumber(stack);
+    double args[2];
 
-    if (operand < 0 && power < 0)
-      throw std::exception("Incorrect operand in ^");
+    args[1] = getNumber(stack);
+    args[0] = getNumber(stack);
 
-    stack.push(std::unique_ptr<token_number_t>(new token_number_t(pow(operand, power))));
+    checkDomain(args);
+
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(evaluate(args))));
   }
 };
 
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
 extern "C" __declspec(dllexport) void __cdecl load(ops_maps & m, std::map<std::string, double const>&cv) {
   m.inf.insert(std::make_pair("^", std::shared_ptr<infix_t>(new Pow)));
-}
\ No newline at end of file
+}
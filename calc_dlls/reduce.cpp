@@ -0,0 +1,193 @@
+#include "include/operation.h"
+#include <cmath>
+#include <type_traits>
+
+/**
+ * Reductions over the operands of a call site, every one is a loop over the operand arrays
+ * which the compiler can vectorize, rows of a block are independent
+ */
+struct SumRule {
+  static double init(double x) { return x; }
+  static double step(double acc, double x) { return acc + x; }
+  static double finish(double acc, size_t n) { return acc; }
+};
+
+struct MeanRule {
+  static double init(double x) { return x; }
+  static double step(double acc, double x) { return acc + x; }
+  static double finish(double acc, size_t n) { return acc / static_cast<double>(n); }
+};
+
+struct MinRule {
+  static double init(double x) { return x; }
+  // NaN is kept whichever operand it comes from
+  static double step(double acc, double x) { return acc < x || acc != acc ? acc : x; }
+  static double finish(double acc, size_t n) { return acc; }
+};
+
+struct MaxRule {
+  static double init(double x) { return x; }
+  static double step(double acc, double x) { return acc > x || acc != acc ? acc : x; }
+  static double finish(double acc, size_t n) { return acc; }
+};
+
+struct HypotRule {
+  static double init(double x) { return x * x; }
+  static double step(double acc, double x) { return acc + x * x; }
+  static double finish(double acc, size_t n) { return std::sqrt(acc); }
+};
+
+/**
+ * Euclidean norm with scaling, for the rare rows where the sum of squares overflows or underflows
+ * param[in] args - operands
+ * param[in] n - number of operands
+ * @return sqrt of sum of squares
+ */
+inline double scaledHypot(double const* args, size_t n) {
+  double m = 0;
+
+  for (size_t k = 0; k < n; ++k)
+    m = std::fmax(m, std::fabs(args[k]));
+  if (m == 0 || std::isinf(m))
+    return m;
+
+  double s = 0;
+  for (size_t k = 0; k < n; ++k)
+    s += (args[k] / m) * (args[k] / m);
+  return m * std::sqrt(s);
+}
+
+/**
+ * Check if the sum of squares has lost precision
+ * param[in] res - unscaled norm
+ * @return true if the norm has to be recomputed with scaling
+ */
+template <typename T>
+inline bool needsScaling(T res) {
+  return std::isinf(res) || res < std::sqrt(std::numeric_limits<T>::min());
+}
+
+template <typename Rule>
+class Reduction : public function_t {
+private:
+  size_t n;
+
+  double fix(double const* args, double res) const {
+    if constexpr (std::is_same_v<Rule, HypotRule>)
+      if (needsScaling(res))
+        return scaledHypot(args, n);
+    return res;
+  }
+
+public:
+  Reduction(size_t count) : n(count) {}
+
+  ~Reduction() = default;
+
+  size_t arity() const noexcept override {
+    return n;
+  }
+
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    double acc = Rule::init(args[0]);
+
+    for (size_t k = 1; k < n; ++k)
+      acc = Rule::step(acc, args[k]);
+    return fix(args, Rule::finish(acc, n));
+  }
+
+  template <typename T>
+  void kernel(T const* const* args, T* res, size_t rows) {
+    for (size_t i = 0; i < rows; ++i)
+      res[i] = static_cast<T>(Rule::init(args[0][i]));
+    for (size_t k = 1; k < n; ++k)
+      for (size_t i = 0; i < rows; ++i)
+        res[i] = static_cast<T>(Rule::step(res[i], args[k][i]));
+    for (size_t i = 0; i < rows; ++i)
+      res[i] = static_cast<T>(Rule::finish(res[i], n));
+
+    if constexpr (std::is_same_v<Rule, HypotRule>) {
+      std::vector<double> a;
+
+      for (size_t i = 0; i < rows; ++i) {
+        if (needsScaling(res[i])) {
+          a.resize(n);
+          for (size_t k = 0; k < n; ++k)
+            a[k] = args[k][i];
+          res[i] = static_cast<T>(scaledHypot(a.data(), n));
+        }
+      }
+    }
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t rows) override {
+    kernel(args, res, rows);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t rows) override {
+    kernel(args, res, rows);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    double res = evaluate(args);
+
+    for (size_t k = 0; k < n; ++k) {
+      if constexpr (std::is_same_v<Rule, SumRule>)
+        partials[k] = 1;
+      else if constexpr (std::is_same_v<Rule, MeanRule>)
+        partials[k] = 1 / static_cast<double>(n);
+      else if constexpr (std::is_same_v<Rule, HypotRule>)
+        partials[k] = res == 0 ? 0 : args[k] / res;
+      else
+        partials[k] = 0;
+    }
+    // min and max follow the first operand which they have chosen
+    if constexpr (std::is_same_v<Rule, MinRule> || std::is_same_v<Rule, MaxRule>)
+      for (size_t k = 0; k < n; ++k)
+        if (args[k] == res) {
+          partials[k] = 1;
+          break;
+        }
+    return true;
+  }
+
+  void process(token_stack_t& stack) override {
+    std::vector<double> args(n);
+
+    for (size_t k = n; k-- > 0;)
+      args[k] = getNumber(stack);
+    stack.push(std::unique_ptr<token_number_t>(new token_number_t(evaluate(args.data()))));
+  }
+};
+
+template <typename Rule>
+class Variadic : public variadic_t {
+public:
+  Variadic() = default;
+
+  ~Variadic() = default;
+
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  std::shared_ptr<operation_t> bind(size_t n) override {
+    return std::shared_ptr<operation_t>(new Reduction<Rule>(n));
+  }
+};
+
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
+extern "C" __declspec(dllexport) void __cdecl load(ops_maps& m, std::map<std::string, double const>& cv) {
+  m.funcs.insert(std::make_pair("sum", std::shared_ptr<function_t>(new Variadic<SumRule>)));
+  m.funcs.insert(std::make_pair("mean", std::shared_ptr<function_t>(new Variadic<MeanRule>)));
+  m.funcs.insert(std::make_pair("min", std::shared_ptr<function_t>(new Variadic<MinRule>)));
+  m.funcs.insert(std::make_pair("max", std::shared_ptr<function_t>(new Variadic<MaxRule>)));
+  m.funcs.insert(std::make_pair("hypot", std::shared_ptr<function_t>(new Variadic<HypotRule>)));
+}
@@ -0,0 +1,231 @@
+#include "include/operation.h"
+#include <cmath>
+#include <deque>
+
+/**
+ * Largest window of moving functions
+ */
+constexpr double maxWindow = 1 << 24;
+
+/**
+ * Check window operand of moving function
+ * param[in] arg - operand
+ * param[out] w - number of samples in the window
+ * @return true if the window is a positive integer not above maxWindow
+ */
+inline bool toWindow(double arg, size_t& w) {
+  if (!(arg >= 1 && arg <= maxWindow) || arg != std::floor(arg))
+    return false;
+  w = static_cast<size_t>(arg);
+  return true;
+}
+
+/**
+ * Ring buffer of the last samples with their running sum
+ */
+class SumState : public state_t {
+public:
+  std::vector<double> ring;
+  size_t head = 0;
+  size_t count = 0;
+  size_t updates = 0;
+  double sum = 0;
+
+  void reset() override {
+    ring.clear();
+    head = count = updates = 0;
+    sum = 0;
+  }
+};
+
+/**
+ * Moving sum or average of the last w samples, the first samples are averaged over what there is
+ */
+template <bool Mean>
+class MovingSum : public stateful_t {
+public:
+  MovingSum() = default;
+
+  ~MovingSum() = default;
+
+  size_t arity() const noexcept override {
+    return 2;
+  }
+
+  std::unique_ptr<state_t> makeState() const override {
+    return std::unique_ptr<state_t>(new SumState);
+  }
+
+  bool hasDomain() const noexcept override {
+    return true;
+  }
+
+  // NaN window gives NaN, as any NaN operand does
+  bool inDomain(double const* args) const noexcept override {
+    size_t w;
+
+    return args[1] != args[1] || toWindow(args[1], w);
+  }
+
+  double update(state_t& state, double const* args) override {
+    SumState& s = static_cast<SumState&>(state);
+    size_t w;
+
+    if (!toWindow(args[1], w))
+      return domainError();
+    if (args[0] != args[0])
+      return args[0]; // the sample is skipped
+    if (s.ring.size() != w) {
+      s.reset();
+      s.ring.resize(w);
+    }
+
+    if (s.count == w)
+      s.sum -= s.ring[s.head];
+    else
+      ++s.count;
+    s.ring[s.head] = args[0];
+    s.head = s.head + 1 == w ? 0 : s.head + 1;
+    s.sum += args[0];
+
+    // rounding errors of subtraction are dropped once per window, infinities as soon as they leave it
+    if (++s.updates >= w || !std::isfinite(s.sum)) {
+      s.updates = 0;
+      s.sum = 0;
+      for (size_t k = 0; k < s.count; ++k)
+        s.sum += s.ring[k];
+    }
+    return Mean ? s.sum / static_cast<double>(s.count) : s.sum;
+  }
+};
+
+/**
+ * Monotonic deque of the samples which may still become the extremum of the window
+ */
+class ExtremumState : public state_t {
+public:
+  std::deque<std::pair<uint64_t, double>> candidates;
+  uint64_t tick = 0;
+  size_t window = 0;
+
+  void reset() override {
+    candidates.clear();
+    tick = 0;
+    window = 0;
+  }
+};
+
+/**
+ * Moving minimum or maximum of the last w samples
+ */
+template <bool Max>
+class MovingExtremum : public stateful_t {
+public:
+  MovingExtremum() = default;
+
+  ~MovingExtremum() = default;
+
+  size_t arity() const noexcept override {
+    return 2;
+  }
+
+  std::unique_ptr<state_t> makeState() const override {
+    return std::unique_ptr<state_t>(new ExtremumState);
+  }
+
+  bool hasDomain() const noexcept override {
+    return true;
+  }
+
+  bool inDomain(double const* args) const noexcept override {
+    size_t w;
+
+    return args[1] != args[1] || toWindow(args[1], w);
+  }
+
+  double update(state_t& state, double const* args) override {
+    ExtremumState& s = static_cast<ExtremumState&>(state);
+    double x = args[0];
+    size_t w;
+
+    if (!toWindow(args[1], w))
+      return domainError();
+    if (x != x)
+      return x;
+    if (s.window != w) {
+      s.reset();
+      s.window = w;
+    }
+
+    // every sample is pushed and popped once
+    while (!s.candidates.empty() && (Max ? s.candidates.back().second <= x : s.candidates.back().second >= x))
+      s.candidates.pop_back();
+    s.candidates.emplace_back(s.tick, x);
+    while (s.candidates.front().first + w <= s.tick)
+      s.candidates.pop_front();
+    ++s.tick;
+    return s.candidates.front().second;
+  }
+};
+
+class EmaState : public state_t {
+public:
+  double value = 0;
+  bool init = false;
+
+  void reset() override {
+    value = 0;
+    init = false;
+  }
+};
+
+/**
+ * Exponential moving average with smoothing factor in (0, 1], starts from the first sample
+ */
+class Ema : public stateful_t {
+public:
+  Ema() = default;
+
+  ~Ema() = default;
+
+  size_t arity() const noexcept override {
+    return 2;
+  }
+
+  std::unique_ptr<state_t> makeState() const override {
+    return std::unique_ptr<state_t>(new EmaState);
+  }
+
+  bool hasDomain() const noexcept override {
+    return true;
+  }
+
+  bool inDomain(double const* args) const noexcept override {
+    return args[1] != args[1] || (args[1] > 0 && args[1] <= 1);
+  }
+
+  double update(state_t& state, double const* args) override {
+    EmaState& s = static_cast<EmaState&>(state);
+    double alpha = args[1];
+
+    if (!(alpha > 0 && alpha <= 1))
+      return domainError();
+    if (args[0] != args[0])
+      return args[0];
+    s.value = s.init ? s.value + alpha * (args[0] - s.value) : args[0];
+    s.init = true;
+    return s.value;
+  }
+};
+
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
+extern "C" __declspec(dllexport) void __cdecl load(ops_maps& m, std::map<std::string, double const>& cv) {
+  m.funcs.insert(std::make_pair("msum", std::shared_ptr<function_t>(new MovingSum<false>)));
+  m.funcs.insert(std::make_pair("mavg", std::shared_ptr<function_t>(new MovingSum<true>)));
+  m.funcs.insert(std::make_pair("mmin", std::shared_ptr<function_t>(new MovingExtremum<false>)));
+  m.funcs.insert(std::make_pair("mmax", std::shared_ptr<function_t>(new MovingExtremum<true>)));
+  m.funcs.insert(std::make_pair("ema", std::shared_ptr<function_t>(new Ema)));
+}
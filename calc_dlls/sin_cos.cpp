@@ -7,6 +7,33 @@ public:
 
   ~Cosinus() = default;
 
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    return cos(args[0]);
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = std::cos(args[0][i]);
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = -sin(args[0]);
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double operand = getNumber(stack);
 
@@ -20,6 +47,33 @@ public:
 
   ~Sinus() = default;
 
+  bool isPure() const noexcept override {
+    return true;
+  }
+
+  double evaluate(double const* args) override {
+    return sin(args[0]);
+  }
+
+  template <typename T>
+  static void kernel(T const* const* args, T* res, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      res[i] = std::sin(args[0][i]);
+  }
+
+  void evaluateBlock(double const* const* args, double* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  void evaluateBlock(float const* const* args, float* res, size_t n) override {
+    kernel(args, res, n);
+  }
+
+  bool derivative(double const* args, double* partials) override {
+    partials[0] = cos(args[0]);
+    return true;
+  }
+
   void process(token_stack_t& stack) override {
     double operand = getNumber(stack);
 
@@ -27,6 +81,10 @@ public:
   }
 };
 
+extern "C" __declspec(dllexport) unsigned __cdecl abiVersion() {
+  return pluginAbiVersion;
+}
+
 extern "C" __declspec(dllexport) void __cdecl load(ops_maps& m, std::map<std::string, double const>& cv) {
   m.funcs.insert(std::make_pair("cos", std::shared_ptr<function_t>(new Cosinus)));
   m.funcs.insert(std::make_pair("sin", std::shared_ptr<function_t>(new Sinus)));